@@ -0,0 +1,672 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+// Compares hmap and smap with std::unordered_map and a reference
+// open addressing map.
+//
+// Usage: hmap_bench [--min-size N] [--max-size N] [--filter TEXT]
+//
+// Sizes grow by factor 10 from min size (default 1000) to max size
+// (default 1000000). Each line of output reports the time per
+// operation and the memory per entry after all keys are inserted.
+//
+// Memory is counted by allocator hooks. Heap storage of std::string
+// keys (beyond small string optimization) is not included for
+// std::unordered_map and the reference map, whereas smap copies keys
+// into its own memory.
+
+#include "hmap/hmap.h"
+#include "hmap/smap.h"
+#include "hmap/imap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// ---------------------------------------------------------------------
+// memory accounting
+
+size_t allocated_bytes = 0;
+
+void * counting_alloc(size_t size, void * context)
+{
+    (void) context;
+    allocated_bytes += size;
+    return malloc(size);
+}
+
+void counting_free(void * ptr, size_t size, void * context)
+{
+    (void) context;
+    allocated_bytes -= size;
+    free(ptr);
+}
+
+template <typename T>
+struct counting_allocator
+{
+    using value_type = T;
+
+    counting_allocator() = default;
+
+    template <typename U>
+    counting_allocator(counting_allocator<U> const &) { }
+
+    T * allocate(size_t n)
+    {
+        allocated_bytes += n * sizeof(T);
+        return static_cast<T *>(malloc(n * sizeof(T)));
+    }
+
+    void deallocate(T * ptr, size_t n)
+    {
+        allocated_bytes -= n * sizeof(T);
+        free(ptr);
+    }
+
+    template <typename U>
+    bool operator==(counting_allocator<U> const &) const { return true; }
+
+    template <typename U>
+    bool operator!=(counting_allocator<U> const &) const { return false; }
+};
+
+// ---------------------------------------------------------------------
+// hash functions
+
+size_t mix(size_t value)
+{
+    uint64_t x = value;
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+}
+
+size_t int_hash(void const * key, size_t seed)
+{
+    return mix(reinterpret_cast<size_t>(key) ^ seed);
+}
+
+int int_equals(void const * key, void const * other)
+{
+    return (key == other) ? 0 : 1;
+}
+
+struct int_hasher
+{
+    size_t operator()(size_t key) const { return mix(key); }
+};
+
+// ---------------------------------------------------------------------
+// reference map: linear probing with backward shift deletion
+
+template <typename Key, typename Hash>
+class reference_map
+{
+public:
+    reference_map(): slots(16), used(16, false), count(0) { }
+
+    void add(Key const & key, void * value)
+    {
+        if ((count + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+
+        size_t id = find_slot(key);
+        if (!used[id])
+        {
+            used[id] = true;
+            slots[id].first = key;
+            count++;
+        }
+        slots[id].second = value;
+    }
+
+    void * get(Key const & key) const
+    {
+        size_t id = find_slot(key);
+        return used[id] ? slots[id].second : nullptr;
+    }
+
+    void remove(Key const & key)
+    {
+        size_t id = find_slot(key);
+        if (!used[id])
+        {
+            return;
+        }
+
+        size_t mask = slots.size() - 1;
+        size_t hole = id;
+        size_t next = (hole + 1) & mask;
+        while (used[next])
+        {
+            size_t home = Hash()(slots[next].first) & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask))
+            {
+                slots[hole] = std::move(slots[next]);
+                used[hole] = true;
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        used[hole] = false;
+        slots[hole] = std::pair<Key, void *>();
+        count--;
+    }
+
+    template <typename Fn>
+    void for_each(Fn fn) const
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (used[i])
+            {
+                fn(slots[i].first, slots[i].second);
+            }
+        }
+    }
+
+    void reserve(size_t capacity)
+    {
+        while (capacity * 2 > slots.size())
+        {
+            grow();
+        }
+    }
+
+    size_t memory() const
+    {
+        return (slots.capacity() * sizeof(std::pair<Key, void *>)) + (used.capacity() / 8);
+    }
+
+private:
+    size_t find_slot(Key const & key) const
+    {
+        size_t mask = slots.size() - 1;
+        size_t id = Hash()(key) & mask;
+        while (used[id] && !(slots[id].first == key))
+        {
+            id = (id + 1) & mask;
+        }
+        return id;
+    }
+
+    void grow()
+    {
+        std::vector<std::pair<Key, void *>> old_slots(slots.size() * 2);
+        std::vector<bool> old_used(slots.size() * 2, false);
+        old_slots.swap(slots);
+        old_used.swap(used);
+        count = 0;
+
+        for (size_t i = 0; i < old_slots.size(); i++)
+        {
+            if (old_used[i])
+            {
+                add(old_slots[i].first, old_slots[i].second);
+            }
+        }
+    }
+
+    std::vector<std::pair<Key, void *>> slots;
+    std::vector<bool> used;
+    size_t count;
+};
+
+// ---------------------------------------------------------------------
+// maps under test
+//
+// Each adapter provides add, get, remove, iterate, reserve and memory.
+
+class hmap_adapter
+{
+public:
+    explicit hmap_adapter(enum hmap_engine engine)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &int_hash;
+        options.equals = &int_equals;
+        options.engine = engine;
+        options.allocator.alloc = &counting_alloc;
+        options.allocator.free = &counting_free;
+        map = hmap_create_ex(&options);
+    }
+
+    ~hmap_adapter() { hmap_release(map); }
+
+    void add(size_t key) { hmap_add(map, reinterpret_cast<void *>(key), reinterpret_cast<void *>(key)); }
+    bool get(size_t key) { return (nullptr != hmap_get(map, reinterpret_cast<void *>(key))); }
+    void remove(size_t key) { hmap_remove(map, reinterpret_cast<void *>(key)); }
+    void reserve(size_t capacity) { hmap_reserve(map, capacity); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        struct hmap_iter iter;
+        hmap_iter_init(&iter, map);
+        while (hmap_iter_next(&iter))
+        {
+            sum += reinterpret_cast<size_t>(hmap_iter_value(&iter));
+        }
+        return sum;
+    }
+
+private:
+    struct hmap * map;
+};
+
+class imap_adapter
+{
+public:
+    imap_adapter()
+    {
+        struct imap_options options;
+        imap_options_init(&options);
+        options.allocator.alloc = &counting_alloc;
+        options.allocator.free = &counting_free;
+        map = imap_create_ex(&options);
+    }
+
+    ~imap_adapter() { imap_release(map); }
+
+    void add(size_t key) { imap_add(map, key, reinterpret_cast<void *>(key)); }
+    bool get(size_t key) { return imap_contains(map, key); }
+    void remove(size_t key) { imap_remove(map, key); }
+    void reserve(size_t capacity) { imap_reserve(map, capacity); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        struct imap_iter iter;
+        imap_iter_init(&iter, map);
+        while (imap_iter_next(&iter))
+        {
+            sum += reinterpret_cast<size_t>(imap_iter_value(&iter));
+        }
+        return sum;
+    }
+
+private:
+    struct imap * map;
+};
+
+class smap_adapter
+{
+public:
+    explicit smap_adapter(enum smap_engine engine)
+    {
+        struct smap_options options;
+        smap_options_init(&options);
+        options.engine = engine;
+        options.allocator.alloc = &counting_alloc;
+        options.allocator.free = &counting_free;
+        map = smap_create_ex(&options);
+    }
+
+    ~smap_adapter() { smap_release(map); }
+
+    void add(std::string const & key) { smap_add_n(map, key.data(), key.size(), map); }
+    bool get(std::string const & key) { return (nullptr != smap_get_n(map, key.data(), key.size())); }
+    void remove(std::string const & key) { smap_remove_n(map, key.data(), key.size()); }
+    void reserve(size_t capacity) { smap_reserve(map, capacity); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        struct smap_iter iter;
+        smap_iter_init(&iter, map);
+        while (smap_iter_next(&iter))
+        {
+            sum += reinterpret_cast<size_t>(smap_iter_value(&iter)) & 1;
+        }
+        return sum;
+    }
+
+private:
+    struct smap * map;
+};
+
+template <typename Key, typename Hash>
+class unordered_adapter
+{
+public:
+    void add(Key const & key) { map[key] = &map; }
+    bool get(Key const & key) { return (map.end() != map.find(key)); }
+    void remove(Key const & key) { map.erase(key); }
+    void reserve(size_t capacity) { map.reserve(capacity); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        for (auto const & item: map)
+        {
+            sum += reinterpret_cast<size_t>(item.second) & 1;
+        }
+        return sum;
+    }
+
+private:
+    std::unordered_map<Key, void *, Hash, std::equal_to<Key>, counting_allocator<std::pair<Key const, void *>>> map;
+};
+
+template <typename Key, typename Hash>
+class reference_adapter
+{
+public:
+    ~reference_adapter() { allocated_bytes -= accounted; }
+
+    void add(Key const & key) { map.add(key, &map); account(); }
+    bool get(Key const & key) { return (nullptr != map.get(key)); }
+    void remove(Key const & key) { map.remove(key); }
+    void reserve(size_t capacity) { map.reserve(capacity); account(); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        map.for_each([&sum](Key const &, void * value) { sum += reinterpret_cast<size_t>(value) & 1; });
+        return sum;
+    }
+
+private:
+    void account()
+    {
+        allocated_bytes -= accounted;
+        accounted = map.memory();
+        allocated_bytes += accounted;
+    }
+
+    reference_map<Key, Hash> map;
+    size_t accounted = 0;
+};
+
+struct string_hasher
+{
+    size_t operator()(std::string const & key) const { return std::hash<std::string>()(key); }
+};
+
+// ---------------------------------------------------------------------
+// key distributions
+
+std::vector<size_t> sequential_ints(size_t count, size_t offset)
+{
+    std::vector<size_t> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = offset + i + 1;
+    }
+    return keys;
+}
+
+std::vector<std::string> random_strings(size_t count, unsigned int seed)
+{
+    static char const alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> length(8, 24);
+    std::uniform_int_distribution<size_t> character(0, sizeof(alphabet) - 2);
+
+    std::vector<std::string> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t key_length = length(random);
+        keys[i].reserve(key_length + 8);
+        for (size_t j = 0; j < key_length; j++)
+        {
+            keys[i] += alphabet[character(random)];
+        }
+        // make keys unique; '-' is not part of the alphabet
+        keys[i] += "-" + std::to_string(seed) + "-" + std::to_string(i);
+    }
+    return keys;
+}
+
+std::vector<std::string> url_strings(size_t count, unsigned int seed)
+{
+    static char const * const hosts[] = { "example.com", "www.example.org", "api.example.net", "cdn.example.io" };
+    static char const * const paths[] = { "users", "orders", "products", "static/img", "v2/search", "docs/latest" };
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> host(0, 3);
+    std::uniform_int_distribution<size_t> path(0, 5);
+
+    std::vector<std::string> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = std::string("https://") + hosts[host(random)] + "/" + paths[path(random)]
+            + "/" + std::to_string(random() % 100000) + "?id=" + std::to_string(seed) + "-" + std::to_string(i);
+    }
+    return keys;
+}
+
+// ---------------------------------------------------------------------
+// measurements
+
+struct config
+{
+    size_t min_size;
+    size_t max_size;
+    char const * filter;
+};
+
+double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(char const * map_name, char const * key_name, size_t size, char const * operation, double ns, size_t ops, double bytes)
+{
+    printf("%-18s %-12s %10zu %-12s %10.2f ns/op %8.1f bytes/entry\n",
+        map_name, key_name, size, operation, ns / static_cast<double>(ops), bytes);
+    fflush(stdout);
+}
+
+size_t volatile sink = 0;
+
+template <typename Adapter, typename Key>
+void run(char const * map_name, char const * key_name, std::function<Adapter *()> create,
+    std::vector<Key> const & keys, std::vector<Key> const & misses)
+{
+    size_t const size = keys.size();
+    size_t const base = allocated_bytes;
+    std::unique_ptr<Adapter> map(create());
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto const & key: keys)
+    {
+        map->add(key);
+    }
+    double ns = elapsed_ns(start);
+    double bytes = static_cast<double>(allocated_bytes - base) / static_cast<double>(size);
+    report(map_name, key_name, size, "insert", ns, size, bytes);
+
+    size_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto const & key: keys)
+    {
+        found += map->get(key) ? 1 : 0;
+    }
+    report(map_name, key_name, size, "hit", elapsed_ns(start), size, bytes);
+    if (found != size)
+    {
+        fprintf(stderr, "error: %s: %zu of %zu keys found\n", map_name, found, size);
+        exit(EXIT_FAILURE);
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (auto const & key: misses)
+    {
+        found += map->get(key) ? 1 : 0;
+    }
+    report(map_name, key_name, size, "miss", elapsed_ns(start), misses.size(), bytes);
+    sink = sink + found;
+
+    start = std::chrono::steady_clock::now();
+    sink = sink + map->iterate();
+    report(map_name, key_name, size, "iterate", elapsed_ns(start), size, bytes);
+
+    start = std::chrono::steady_clock::now();
+    map->reserve(size * 2);
+    report(map_name, key_name, size, "rehash", elapsed_ns(start), size, bytes);
+
+    start = std::chrono::steady_clock::now();
+    for (auto const & key: keys)
+    {
+        map->remove(key);
+    }
+    report(map_name, key_name, size, "remove", elapsed_ns(start), size, bytes);
+}
+
+bool is_selected(config const & cfg, char const * map_name, char const * key_name)
+{
+    return (nullptr == cfg.filter) || (nullptr != strstr(map_name, cfg.filter)) || (nullptr != strstr(key_name, cfg.filter));
+}
+
+bool is_string_selected(config const & cfg, char const * key_name)
+{
+    return is_selected(cfg, "smap-chained", key_name) || is_selected(cfg, "smap-open", key_name)
+        || is_selected(cfg, "unordered_map", key_name) || is_selected(cfg, "reference", key_name);
+}
+
+void run_int_benchmarks(config const & cfg, size_t size)
+{
+    char const * key_name = "seq-int";
+    std::vector<size_t> keys = sequential_ints(size, 0);
+    std::vector<size_t> misses = sequential_ints(size, size);
+
+    if (is_selected(cfg, "hmap-chained", key_name))
+    {
+        run<hmap_adapter>("hmap-chained", key_name, []() { return new hmap_adapter(HMAP_ENGINE_CHAINED); }, keys, misses);
+    }
+    if (is_selected(cfg, "hmap-open", key_name))
+    {
+        run<hmap_adapter>("hmap-open", key_name, []() { return new hmap_adapter(HMAP_ENGINE_OPEN); }, keys, misses);
+    }
+    if (is_selected(cfg, "hmap-dense", key_name))
+    {
+        run<hmap_adapter>("hmap-dense", key_name, []() { return new hmap_adapter(HMAP_ENGINE_DENSE); }, keys, misses);
+    }
+    if (is_selected(cfg, "imap", key_name))
+    {
+        run<imap_adapter>("imap", key_name, []() { return new imap_adapter(); }, keys, misses);
+    }
+    if (is_selected(cfg, "unordered_map", key_name))
+    {
+        using adapter = unordered_adapter<size_t, int_hasher>;
+        run<adapter>("unordered_map", key_name, []() { return new adapter(); }, keys, misses);
+    }
+    if (is_selected(cfg, "reference", key_name))
+    {
+        using adapter = reference_adapter<size_t, int_hasher>;
+        run<adapter>("reference", key_name, []() { return new adapter(); }, keys, misses);
+    }
+}
+
+void run_string_benchmarks(config const & cfg, char const * key_name, std::vector<std::string> const & keys,
+    std::vector<std::string> const & misses)
+{
+    if (is_selected(cfg, "smap-chained", key_name))
+    {
+        run<smap_adapter>("smap-chained", key_name, []() { return new smap_adapter(SMAP_ENGINE_CHAINED); }, keys, misses);
+    }
+    if (is_selected(cfg, "smap-open", key_name))
+    {
+        run<smap_adapter>("smap-open", key_name, []() { return new smap_adapter(SMAP_ENGINE_OPEN); }, keys, misses);
+    }
+    if (is_selected(cfg, "smap-dense", key_name))
+    {
+        run<smap_adapter>("smap-dense", key_name, []() { return new smap_adapter(SMAP_ENGINE_DENSE); }, keys, misses);
+    }
+    if (is_selected(cfg, "unordered_map", key_name))
+    {
+        using adapter = unordered_adapter<std::string, string_hasher>;
+        run<adapter>("unordered_map", key_name, []() { return new adapter(); }, keys, misses);
+    }
+    if (is_selected(cfg, "reference", key_name))
+    {
+        using adapter = reference_adapter<std::string, string_hasher>;
+        run<adapter>("reference", key_name, []() { return new adapter(); }, keys, misses);
+    }
+}
+
+void print_usage()
+{
+    printf("hmap_bench, Copyright (c) 2022 Falk Werner\n"
+        "Compares hash map implementations\n"
+        "\n"
+        "Usage:\n"
+        "\thmap_bench [--min-size N] [--max-size N] [--filter TEXT]\n"
+        "\n"
+        "Options:\n"
+        "\t--min-size N   - smallest number of entries (default: 1000)\n"
+        "\t--max-size N   - largest number of entries (default: 1000000)\n"
+        "\t--filter TEXT  - only run maps or key distributions containing TEXT\n"
+        "\n"
+        "Key distributions: seq-int, random-str, url\n"
+        "Maps: hmap-chained, hmap-open, imap, smap-chained, smap-open, unordered_map, reference\n");
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    config cfg = { 1000, 1000000, nullptr };
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = (i + 1) < argc;
+        if ((0 == strcmp("--min-size", argv[i])) && (has_value))
+        {
+            cfg.min_size = strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((0 == strcmp("--max-size", argv[i])) && (has_value))
+        {
+            cfg.max_size = strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((0 == strcmp("--filter", argv[i])) && (has_value))
+        {
+            cfg.filter = argv[++i];
+        }
+        else
+        {
+            print_usage();
+            return (0 == strcmp("--help", argv[i])) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (0 == cfg.min_size)
+    {
+        cfg.min_size = 1;
+    }
+
+    for (size_t size = cfg.min_size; size <= cfg.max_size; size *= 10)
+    {
+        run_int_benchmarks(cfg, size);
+
+        if (is_string_selected(cfg, "random-str"))
+        {
+            run_string_benchmarks(cfg, "random-str", random_strings(size, 1), random_strings(size, 2));
+        }
+
+        if (is_string_selected(cfg, "url"))
+        {
+            run_string_benchmarks(cfg, "url", url_strings(size, 1), url_strings(size, 2));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef CHMAP_H
+#define CHMAP_H
+
+#include "hmap/hmap.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct chmap;
+
+/// Options used to create a concurrent Hashmap.
+///
+/// \note Use \see chmap_options_init to initialize the options
+///       with default values before setting individual fields.
+struct chmap_options
+{
+    struct hmap_options map;            ///< Options of the Hashmap; capacity is divided among the shards.
+    size_t shard_count;                 ///< Number of independently locked shards; rounded up to
+                                        ///< a power of two (defaults to 64).
+    bool lock_free_reads;               ///< Lookups take no locks; removed and replaced items are released
+                                        ///< once no reader can access them anymore. Storage engine and
+                                        ///< incremental rehashing options are ignored (defaults to false).
+};
+
+/// Initializes concurrent Hashmap options with default values.
+///
+/// \note Hash and equals functions must be set before the
+///       options are used to create a Hashmap.
+///
+/// \param options Pointer to the options to initialize.
+extern void chmap_options_init(
+    struct chmap_options * options);
+
+/// Creates a new empty concurrent Hashmap.
+///
+/// Keys are partitioned across shards by their hash. Each shard is
+/// protected by its own reader-writer lock, so lookups never block
+/// each other and modifications only block accesses to the same shard.
+///
+/// \param seed          Seed of the hash function.
+/// \param hash          Hash function.
+/// \param equals        Determines, whether two keys are equal.
+/// \param release_key   Used to release keys.
+/// \param release_value User to release values.
+/// \return Newly created Hashmap.
+extern struct chmap * chmap_create(
+    size_t seed,
+    hmap_hash_fn * hash,
+    hmap_equals_fn * equals,
+    hmap_release_fn * release_key,
+    hmap_release_fn * release_value);
+
+/// Creates a new empty concurrent Hashmap using the given options.
+///
+/// \note The allocator is shared by all shards and must be thread-safe.
+///
+/// \param options Options of the Hashmap.
+/// \return Newly created Hashmap.
+extern struct chmap * chmap_create_ex(
+    struct chmap_options const * options);
+
+/// Releases a concurrent Hashmap.
+///
+/// \note The Hashmap must not be used by other threads anymore.
+///
+/// \param map Pointer to the Hashmap.
+extern void chmap_release(
+    struct chmap * map);
+
+/// Adds a new item to the Hashmap or updates an existing one.
+///
+/// \note The Hashmaps takes ownership of both, \arg key and
+///       \arg value. This is also true for updates of
+///       existing values.
+///
+/// \param map   Pointer to the Hashmap.
+/// \param key   Key of the item to add.
+/// \param value Value to add.
+extern void chmap_add(
+    struct chmap * map,
+    void * key,
+    void * value);
+
+/// Returns a value from the Hashmap.
+///
+/// \note The value is returned after the shard is unlocked (or, if
+///       \arg lock_free_reads is set, after leaving the read epoch).
+///       If values are released by the Hashmap, the caller must make
+///       sure that the item is not updated or removed concurrently
+///       while the value is in use.
+///
+/// \param map Pointer to the Hashmap.
+/// \param key Key of the item to get.
+/// \return Value of the item or NULL, if the item was not found.
+extern void const * chmap_get(
+    struct chmap * map,
+    void const * key);
+
+/// Returns true, if the Hashmap contains an item for \arg key.
+///
+/// \param map Pointer to the Hashmap.
+/// \param key Key of the item to find.
+extern bool chmap_contains(
+    struct chmap * map,
+    void const * key);
+
+/// Removes an item from the Hashmap.
+///
+/// \param map Pointer to the Hashmap.
+/// \param key Key of the item to remove.
+extern void chmap_remove(
+    struct chmap * map,
+    void const * key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_DETAIL_PROBE_H
+#define HMAP_DETAIL_PROBE_H
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#if !defined(HMAP_WITHOUT_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define HMAP_GROUP_SSE2
+#include <emmintrin.h>
+#endif
+
+// Probing primitives of open addressing.
+//
+// This header is an implementation detail; it is installed only since
+// the header-only hmap.hpp shares it with the table engines and imap.
+// It is not part of the API and may change without notice.
+//
+// Slots are addressed by home slots and probed linearly. Each slot has
+// a control byte, which is either HMAP_CTRL_EMPTY or holds a 7-bit
+// fragment of the hash of the stored entry. Control bytes are probed in
+// groups of HMAP_GROUP_WIDTH, so that the entries themselves are only
+// touched when their fragment matches. The first HMAP_GROUP_WIDTH
+// control bytes are mirrored behind the last one, so that a group can
+// be loaded at any slot. Removals use backward-shift deletion, so no
+// tombstones are needed and a lookup stops at the first empty slot.
+
+#define HMAP_GROUP_WIDTH 16
+#define HMAP_CTRL_EMPTY ((unsigned char) 0x80)
+
+/// 2^64 divided by the golden ratio (Fibonacci hashing).
+#define HMAP_TABLE_FIBONACCI UINT64_C(0x9e3779b97f4a7c15)
+
+/// Returns a bit mask of the control bytes in a group equal to \arg fragment.
+static inline uint32_t hmap_group_match(unsigned char const * group, unsigned char fragment)
+{
+#ifdef HMAP_GROUP_SSE2
+    __m128i ctrl = _mm_loadu_si128((__m128i const *) group);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) fragment)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HMAP_GROUP_WIDTH; i++)
+    {
+        mask |= ((uint32_t) (fragment == group[i])) << i;
+    }
+    return mask;
+#endif
+}
+
+/// Returns a bit mask of the empty control bytes in a group.
+static inline uint32_t hmap_group_empty(unsigned char const * group)
+{
+    return hmap_group_match(group, HMAP_CTRL_EMPTY);
+}
+
+/// Returns a bit mask of the used control bytes in a group.
+static inline uint32_t hmap_group_used(unsigned char const * group)
+{
+#ifdef HMAP_GROUP_SSE2
+    __m128i ctrl = _mm_loadu_si128((__m128i const *) group);
+    return ((uint32_t) _mm_movemask_epi8(ctrl)) ^ 0xffff;
+#else
+    return hmap_group_empty(group) ^ 0xffff;
+#endif
+}
+
+/// Returns the index of the lowest bit set in a non-zero \arg mask.
+static inline size_t hmap_group_lowest(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t) __builtin_ctz(mask);
+#else
+    size_t index = 0;
+    while (0 == (mask & 1))
+    {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/// Returns the number of bits needed to address \arg bucket_count buckets.
+///
+/// \param bucket_count Number of buckets; a power of two.
+/// \return Binary logarithm of \arg bucket_count.
+static inline unsigned int hmap_table_log2(size_t bucket_count)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_ctzll((unsigned long long) bucket_count);
+#else
+    unsigned int bits = 0;
+    while (1 < bucket_count)
+    {
+        bucket_count >>= 1;
+        bits++;
+    }
+    return bits;
+#endif
+}
+
+/// Returns the home bucket of \arg hash.
+///
+/// The hash is multiplied by \see HMAP_TABLE_FIBONACCI and the bucket
+/// is taken from the top bits of the product, so that all bits of the
+/// hash contribute and weak hash functions (e.g. the identity) still
+/// spread across all buckets. No division is needed.
+///
+/// \note Buckets sharing their top bits are contiguous: when the bucket
+///       count doubles, the entries of bucket i move to bucket 2i or 2i+1.
+///
+/// \param hash Hash value.
+/// \param bucket_count Number of buckets; a power of two of at least 2.
+/// \return Id of the home bucket.
+static inline size_t hmap_table_gethome(size_t hash, size_t bucket_count)
+{
+    unsigned int shift = 64 - hmap_table_log2(bucket_count);
+    return (size_t) ((((uint64_t) hash) * HMAP_TABLE_FIBONACCI) >> shift);
+}
+
+/// Returns the control byte fragment of \arg hash.
+///
+/// The fragment is taken from the 7 bits of the product right below the
+/// bits of the home bucket (see \see hmap_table_gethome), so it does not
+/// repeat the home bucket and weak hash functions still yield distinct
+/// fragments. Fragments depend on the bucket count; they are recomputed
+/// when a table is resized.
+///
+/// \param hash Hash value.
+/// \param bucket_count Number of buckets; a power of two of at least 2.
+/// \return Fragment stored in the control byte of the entry.
+static inline unsigned char hmap_table_getfragment(size_t hash, size_t bucket_count)
+{
+    unsigned int shift = 64 - 7 - hmap_table_log2(bucket_count);
+    return (unsigned char) (((((uint64_t) hash) * HMAP_TABLE_FIBONACCI) >> shift) & 0x7f);
+}
+
+/// Sets the control byte of slot \arg id, including its mirror.
+///
+/// \param ctrl Control bytes of \arg slot_count slots.
+/// \param slot_count Number of slots.
+/// \param id Id of the slot.
+/// \param value Fragment or \see HMAP_CTRL_EMPTY.
+static inline void hmap_probe_setctrl(unsigned char * ctrl, size_t slot_count, size_t id, unsigned char value)
+{
+    ctrl[id] = value;
+    if (id < HMAP_GROUP_WIDTH)
+    {
+        ctrl[slot_count + id] = value;
+    }
+}
+
+/// State of a lookup, see \see hmap_probe_next.
+struct hmap_probe
+{
+    size_t mask;
+    size_t group;
+    unsigned char fragment;
+    uint32_t candidates;
+    uint32_t empty;
+};
+
+/// Loads the group of control bytes at the current position of \arg probe.
+static inline void hmap_probe_load(struct hmap_probe * probe, unsigned char const * ctrl)
+{
+    unsigned char const * group = &(ctrl[probe->group]);
+    probe->empty = hmap_group_empty(group);
+
+    // only candidates in front of the first empty slot are part of the probe sequence
+    probe->candidates = hmap_group_match(group, probe->fragment);
+    if (0 != probe->empty)
+    {
+        probe->candidates &= (probe->empty & (~(probe->empty) + 1)) - 1;
+    }
+}
+
+/// Starts a lookup of \arg hash at its home slot.
+///
+/// \param probe Probe to initialize.
+/// \param ctrl Control bytes of \arg slot_count slots.
+/// \param slot_count Number of slots; a power of two of at least 2.
+/// \param hash Hash value to look up.
+static inline void hmap_probe_start(struct hmap_probe * probe, unsigned char const * ctrl, size_t slot_count, size_t hash)
+{
+    probe->mask = slot_count - 1;
+    probe->group = hmap_table_gethome(hash, slot_count);
+    probe->fragment = hmap_table_getfragment(hash, slot_count);
+    hmap_probe_load(probe, ctrl);
+}
+
+/// Returns the next slot, whose fragment matches the hash of the lookup.
+///
+/// \note There must be at least one empty slot.
+///
+/// \param probe Probe started by \see hmap_probe_start.
+/// \param ctrl Control bytes of the slots.
+/// \param id Set to the id of the next candidate or, if there are no more
+///        candidates, to the id of the first empty slot of the probe sequence.
+/// \return true, if \arg id is a candidate; false, if it is the empty slot.
+static inline bool hmap_probe_next(struct hmap_probe * probe, unsigned char const * ctrl, size_t * id)
+{
+    while (0 == probe->candidates)
+    {
+        if (0 != probe->empty)
+        {
+            *id = (probe->group + hmap_group_lowest(probe->empty)) & probe->mask;
+            return false;
+        }
+
+        probe->group = (probe->group + HMAP_GROUP_WIDTH) & probe->mask;
+        hmap_probe_load(probe, ctrl);
+    }
+
+    *id = (probe->group + hmap_group_lowest(probe->candidates)) & probe->mask;
+    probe->candidates &= probe->candidates - 1;
+    return true;
+}
+
+/// Returns the first empty slot at or behind \arg home.
+///
+/// Used to place entries without looking them up, e.g. while rehashing.
+///
+/// \param ctrl Control bytes of \arg slot_count slots.
+/// \param slot_count Number of slots; a power of two.
+/// \param home Home slot of the entry to place.
+/// \return Id of the empty slot.
+static inline size_t hmap_probe_findempty(unsigned char const * ctrl, size_t slot_count, size_t home)
+{
+    size_t mask = slot_count - 1;
+    size_t id = home;
+    while (HMAP_CTRL_EMPTY != ctrl[id])
+    {
+        id = (id + 1) & mask;
+    }
+
+    return id;
+}
+
+/// Returns true, if the entry of slot \arg id is shifted back into \arg hole.
+///
+/// An entry is shifted back, unless it is already placed at (or wrapped
+/// around to) its home slot, i.e. unless the hole lies in front of its
+/// home slot.
+///
+/// \param id Slot of the entry.
+/// \param home Home slot of the entry.
+/// \param hole Empty slot in front of \arg id.
+/// \param mask Number of slots minus 1.
+/// \return true, if the entry is moved into \arg hole.
+static inline bool hmap_probe_canshift(size_t id, size_t home, size_t hole, size_t mask)
+{
+    return ((id - home) & mask) >= ((id - hole) & mask);
+}
+
+/// Returns the offset of the first used slot at or behind \arg offset.
+///
+/// Slots are visited in order starting at slot \arg start and wrapping
+/// around at the end; empty slots are skipped a group at a time.
+///
+/// \param ctrl Control bytes of \arg slot_count slots.
+/// \param slot_count Number of slots; a power of two.
+/// \param start Slot to start at.
+/// \param offset Offset relative to \arg start to continue at.
+/// \return Offset of the used slot relative to \arg start or \arg slot_count,
+///         if there are no more used slots.
+static inline size_t hmap_probe_nextused(unsigned char const * ctrl, size_t slot_count, size_t start, size_t offset)
+{
+    size_t mask = slot_count - 1;
+
+    // the mirrored control bytes behind the last slot allow to load a
+    // group at any slot; slots behind the end are masked out
+    while (offset < slot_count)
+    {
+        uint32_t used = hmap_group_used(&(ctrl[(start + offset) & mask]));
+        size_t remaining = slot_count - offset;
+        if (remaining < HMAP_GROUP_WIDTH)
+        {
+            used &= (((uint32_t) 1) << remaining) - 1;
+        }
+
+        if (0 != used)
+        {
+            return offset + hmap_group_lowest(used);
+        }
+
+        offset += HMAP_GROUP_WIDTH;
+    }
+
+    return slot_count;
+}
+
+#endif
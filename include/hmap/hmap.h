@@ -35,9 +35,105 @@ typedef size_t hmap_hash_fn(void const * key, size_t seed);
 /// \return 0, if keys are equal.
 typedef int hmap_equals_fn(void const * key, void const * other_key);
 
+/// Decides, whether an item is kept by \see hmap_retain.
+///
+/// \param key Key of the item.
+/// \param value Value of the item (or a pointer to the inline value, if
+///              \arg value_size is set).
+/// \param context User defined context.
+/// \return true, if the item is kept; false, if it is removed.
+typedef bool hmap_predicate_fn(void const * key, void const * value, void * context);
+
+/// Allocates memory.
+///
+/// \param size Number of bytes to allocate.
+/// \param context User defined context of the allocator.
+/// \return Pointer to the allocated memory.
+typedef void * hmap_alloc_fn(size_t size, void * context);
+
+/// Frees memory allocated by \see hmap_alloc_fn.
+///
+/// \param ptr Pointer to the memory to free.
+/// \param size Number of bytes allocated.
+/// \param context User defined context of the allocator.
+typedef void hmap_free_fn(void * ptr, size_t size, void * context);
+
+/// Allocator used for the internal memory of a Hashmap.
+struct hmap_allocator
+{
+    hmap_alloc_fn * alloc;      ///< Allocates memory; NULL to use malloc.
+    hmap_free_fn * free;        ///< Frees memory; NULL if memory is not freed individually (e.g. arenas).
+    void * context;             ///< Passed to \arg alloc and \arg free.
+};
+
 struct hmap;
-struct hmap_bucket;
 struct hmap_entry;
+struct hmap_frozen;
+
+/// Storage engine of a Hashmap.
+enum hmap_engine
+{
+    HMAP_ENGINE_CHAINED,            ///< Separate chaining; one heap node per entry (default)
+    HMAP_ENGINE_OPEN,               ///< Open addressing; entries are stored in a contiguous slot array
+    HMAP_ENGINE_DENSE               ///< Entries are stored in insertion order in a dense array referenced
+                                    ///< by a compact index; iteration visits entries in insertion order
+};
+
+/// Options used to create a Hashmap.
+///
+/// \note Use \see hmap_options_init to initialize the options
+///       with default values before setting individual fields.
+struct hmap_options
+{
+    size_t seed;                        ///< Seed of the hash function.
+    hmap_hash_fn * hash;                ///< Hash function.
+    hmap_equals_fn * equals;            ///< Determines, whether two keys are equal.
+    hmap_release_fn * release_key;      ///< Used to release keys; NULL if keys are not released.
+    hmap_release_fn * release_value;    ///< Used to release values; NULL if values are not released.
+    size_t value_size;                  ///< Size of values stored inline in bytes; 0 to store value
+                                        ///< pointers (default). Inline values are aligned to pointers;
+                                        ///< not supported by chmap.
+    enum hmap_engine engine;            ///< Storage engine (defaults to \see HMAP_ENGINE_CHAINED).
+    bool incremental_rehash;            ///< Grow in small steps on add and remove instead of all at once;
+                                        ///< only supported by \see HMAP_ENGINE_CHAINED (defaults to false).
+    size_t rehash_threads;              ///< Number of threads moving entries when the Hashmap grows at once;
+                                        ///< 0 for one thread per processor; only supported by
+                                        ///< \see HMAP_ENGINE_CHAINED (defaults to 1).
+    size_t capacity;                    ///< Number of items to reserve space for (defaults to 0).
+    double max_load_factor;             ///< Average number of items per bucket that triggers growth (defaults to 0.7);
+                                        ///< limited below 1 for \see HMAP_ENGINE_OPEN and \see HMAP_ENGINE_DENSE.
+    struct hmap_allocator allocator;    ///< Allocator of internal memory (defaults to malloc and free).
+};
+
+/// Number of buckets of the probe length histogram.
+#define HMAP_STATS_HISTOGRAM_SIZE 16
+
+/// Statistics of a Hashmap.
+///
+/// The probe length of an item is the number of items compared
+/// when the item is looked up, i.e. its position within its chain
+/// (\see HMAP_ENGINE_CHAINED) or its distance to its home slot
+/// plus one (\see HMAP_ENGINE_OPEN and \see HMAP_ENGINE_DENSE).
+///
+/// \note The counters of lookups, misses and comparisons are only
+///       maintained, if the library is built with the CMake option
+///       WITH_STATS_COUNTERS; otherwise they are always 0.
+struct hmap_stats
+{
+    size_t size;                        ///< Number of items.
+    size_t bucket_count;                ///< Number of buckets or slots.
+    size_t capacity;                    ///< Number of items that can be stored before the Hashmap grows.
+    double load_factor;                 ///< Number of items per bucket.
+    size_t bytes_allocated;             ///< Memory allocated by the Hashmap in bytes.
+    size_t rehash_count;                ///< Number of times the Hashmap was resized.
+    size_t max_probe_length;            ///< Maximum probe length of all items.
+    double mean_probe_length;           ///< Mean probe length of all items.
+    size_t probe_histogram[HMAP_STATS_HISTOGRAM_SIZE];  ///< Number of items per probe length, starting at 1;
+                                        ///< the last bucket also counts all longer probes.
+    size_t lookups;                     ///< Number of lookups including adds and removes.
+    size_t misses;                      ///< Number of lookups of keys that were not found.
+    size_t comparisons;                 ///< Number of key comparisons.
+};
 
 /// Hashmap iterator.
 ///
@@ -45,11 +141,21 @@ struct hmap_entry;
 struct hmap_iter
 {
     struct hmap * map;              ///< Pointer to Hashmap; do not use
-    size_t bucket_id;               ///< Id of the current bucket; do not use
+    size_t bucket_id;               ///< Id of the current bucket or slot; do not use
+    size_t start;                   ///< Position the iteration started at; do not use
+    void * position;                ///< Position within the current bucket; do not use
     struct hmap_entry * entry;      ///< Pointer to current Hashmap entry; do not use
-    struct hmap_entry * end;        ///< Pointer to the last entry in the Hashmap; do not use
 };
 
+/// Initializes Hashmap options with default values.
+///
+/// \note Hash and equals functions must be set before the
+///       options are used to create a Hashmap.
+///
+/// \param options Pointer to the options to initialize.
+extern void hmap_options_init(
+    struct hmap_options * options);
+
 /// Creates a new empty Hashmap.
 ///
 /// \param seed          Seed of the hash function.
@@ -65,6 +171,41 @@ extern struct hmap * hmap_create(
     hmap_release_fn * release_value
 );
 
+/// Creates a new empty Hashmap using the given options.
+///
+/// \param options Options of the Hashmap.
+/// \return Newly created Hashmap.
+extern struct hmap * hmap_create_ex(
+    struct hmap_options const * options);
+
+/// Creates a new Hashmap from arrays of keys and values using multiple threads.
+///
+/// The Hashmap is sized to store all items before they are inserted,
+/// keys are hashed in parallel and the items are inserted in parallel
+/// into disjoint ranges of buckets.
+///
+/// Items with equal keys are handled as if they were added in order
+/// using \see hmap_add: the last value is stored and the keys and
+/// values of the previous items are released.
+///
+/// \note The hash and equals functions are called concurrently by
+///       multiple threads; release functions are only called by the
+///       calling thread.
+///
+/// \param options      Options of the Hashmap.
+/// \param keys         Keys of the items; owned by the Hashmap afterwards.
+/// \param values       Values of the items (or pointers to the inline values, if
+///                     \arg value_size is set); NULL to store NULL values.
+/// \param count        Number of items.
+/// \param thread_count Number of threads to use; 0 to use one thread per processor.
+/// \return Newly created Hashmap.
+extern struct hmap * hmap_build_bulk(
+    struct hmap_options const * options,
+    void * const * keys,
+    void * const * values,
+    size_t count,
+    size_t thread_count);
+
 /// Releases a Hashmap.
 ///
 /// \param map Pointer to the Hashmap.
@@ -76,6 +217,8 @@ extern void hmap_release(
 /// \note The Hashmaps takes ownership of both, \arg key and 
 ///       \arg value. This is also true for updates of 
 ///       existing values.
+/// \note If \arg value_size is set, \arg value points to the bytes
+///       to copy into the Hashmap; NULL sets all bytes to 0.
 ///
 /// \param map   Pointer to the Hashmap.
 /// \param key   Key of the item to add.
@@ -85,8 +228,61 @@ extern void hmap_add(
     void * key,
     void * value);
 
+/// Returns the value slot of an item, inserting the item if it does not exist.
+///
+/// The key is hashed and looked up only once. If the item was newly
+/// created, its value is set to NULL and the Hashmap takes ownership of
+/// \arg key. If an item with an equal key exists, the stored key is kept
+/// and \arg key is neither stored nor released: it remains owned by the
+/// caller, who must release it.
+///
+/// A value written through the returned pointer is owned by the Hashmap.
+/// Overwriting an existing value does not release it; the caller must
+/// release it before, unlike \see hmap_add.
+///
+/// \note The returned pointer is invalidated by any later modification
+///       of the Hashmap.
+/// \note If \arg value_size is set, the returned pointer points to the
+///       inline value, which is set to 0 for newly created items.
+///
+/// \param map     Pointer to the Hashmap.
+/// \param key     Key of the item.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value of the item.
+extern void ** hmap_get_or_insert(
+    struct hmap * map,
+    void * key,
+    bool * created);
+
+/// Adds a new item to the Hashmap, unless an item with \arg key exists.
+///
+/// The key is hashed and looked up only once. If the item was newly
+/// created, the Hashmap takes ownership of \arg key and \arg value.
+/// In contrast to \see hmap_add an existing item is neither updated
+/// nor released: its stored key and value are kept, while \arg key and
+/// \arg value remain owned by the caller, who must release them.
+///
+/// \note The returned pointer is invalidated by any later modification
+///       of the Hashmap.
+/// \note If \arg value_size is set, \arg value points to the bytes to
+///       copy into a newly created item and always remains owned by the
+///       caller; the returned pointer points to the inline value.
+///
+/// \param map     Pointer to the Hashmap.
+/// \param key     Key of the item.
+/// \param value   Value of the item, if it is newly created.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value of the item.
+extern void ** hmap_emplace(
+    struct hmap * map,
+    void * key,
+    void * value,
+    bool * created);
+
 /// Returns a value from the Hashmap.
 ///
+/// \note If \arg value_size is set, a pointer to the inline value is returned.
+///
 /// \param map Pointer to the Hashmap.
 /// \param key Key of the item to get.
 /// \return Value of the item or NULL, if the item was not found.
@@ -94,6 +290,22 @@ extern void const * hmap_get(
     struct hmap * map,
     void const * key);
 
+/// Returns the values of multiple keys.
+///
+/// Keys are hashed and their buckets are prefetched in small batches
+/// before they are looked up, so that cache misses of different keys
+/// overlap. This is faster than calling \see hmap_get for each key.
+///
+/// \param map    Pointer to the Hashmap.
+/// \param keys   Keys of the items to get.
+/// \param count  Number of keys.
+/// \param values Receives the value of each key or NULL, if the key was not found.
+extern void hmap_get_batch(
+    struct hmap * map,
+    void const * const * keys,
+    size_t count,
+    void const * * values);
+
 /// Returns true, if the Hashmap contains an item for \arg key.
 ///
 /// \param map Pointer to the Hashmap.
@@ -110,12 +322,53 @@ extern void hmap_remove(
     struct hmap * map,
     void const * key);
 
+/// Removes all items for which \arg predicate returns false.
+///
+/// The items are visited in a single pass and removed in place,
+/// so the Hashmap does not grow or shrink.
+///
+/// \param map       Pointer to the Hashmap.
+/// \param predicate Returns true for each item to keep.
+/// \param context   Passed to \arg predicate.
+extern void hmap_retain(
+    struct hmap * map,
+    hmap_predicate_fn * predicate,
+    void * context);
+
+/// Reserves space for at least \arg capacity items.
+///
+/// \note Adding up to \arg capacity items does not cause the
+///       Hashmap to grow.
+///
+/// \param map      Pointer to the Hashmap.
+/// \param capacity Number of items to reserve space for.
+extern void hmap_reserve(
+    struct hmap * map,
+    size_t capacity);
+
+/// Shrinks the Hashmap to the smallest size able to store its items.
+///
+/// \param map Pointer to the Hashmap.
+extern void hmap_shrink_to_fit(
+    struct hmap * map);
+
+/// Returns statistics of a Hashmap.
+///
+/// \note The probe lengths are determined by visiting all items.
+///
+/// \param map   Pointer to the Hashmap.
+/// \param stats Receives the statistics.
+extern void hmap_get_stats(
+    struct hmap * map,
+    struct hmap_stats * stats);
+
 /// Initializes an iterator for a Hashmap.
 ///
 /// \note The iterator is positioned before the fist element.
 ///       Thefore, a call to \see hmap_iter_next is needed to
 ///       retrieve the first key-value-pair.
-/// \note The Hashmap must not be changed during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see hmap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \param map Pointer to the map.
@@ -125,7 +378,8 @@ extern void hmap_iter_init(
 
 /// Retrieves the next key-value-pair
 ///
-/// \note The Hashmap must not be changed during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see hmap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \return true, if there is a next key-value-pair
@@ -135,22 +389,89 @@ extern bool hmap_iter_next(
 
 /// Return the currently fetched value.
 ///
-/// \note The Hashmap must not be changed during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see hmap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
-/// \return Currently fetched value or NULL, if no value is fetched.
+/// \return Currently fetched value (or a pointer to the inline value, if
+///         \arg value_size is set) or NULL, if no value is fetched.
 extern void const * hmap_iter_value(
     struct hmap_iter * iter);
 
 /// Return the currently fetched key.
 ///
-/// \note The Hashmap must not be changed during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see hmap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \return Currently fetched key or NULL, if no key is fetched.
 extern void const * hmap_iter_key(
     struct hmap_iter * iter);
 
+/// Removes the currently fetched item.
+///
+/// The iteration continues with the next item; all remaining items
+/// are still fetched exactly once. No item is fetched until the next
+/// call of \see hmap_iter_next.
+///
+/// \note This is the only way to change the Hashmap during iteration.
+///
+/// \param iter Pointer to the iterator.
+extern void hmap_iter_remove(
+    struct hmap_iter * iter);
+
+/// Converts a Hashmap into an immutable Hashmap using a minimal perfect hash.
+///
+/// Each lookup of a frozen Hashmap reads exactly one slot and compares
+/// exactly one key; there are as many slots as items.
+///
+/// \note On success, \arg map is consumed and must not be used anymore;
+///       its keys and values are owned by the frozen Hashmap.
+/// \note If the hash values of two keys are equal, all keys are hashed
+///       again using a few other seeds. Freezing fails, if keys collide
+///       for each of these seeds, e.g. if the hash function ignores its
+///       seed. In this case, \arg map is left unchanged.
+///
+/// \param map Pointer to the Hashmap to freeze.
+/// \return Pointer to the frozen Hashmap or NULL, if freezing failed.
+extern struct hmap_frozen * hmap_freeze(
+    struct hmap * map);
+
+/// Releases a frozen Hashmap.
+///
+/// \note Keys and values are released using the release functions
+///       of the Hashmap it was created from.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+extern void hmap_frozen_release(
+    struct hmap_frozen * frozen);
+
+/// Returns the number of items of a frozen Hashmap.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \return Number of items.
+extern size_t hmap_frozen_size(
+    struct hmap_frozen const * frozen);
+
+/// Returns the value associated with a key.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \param key Key of the value.
+/// \return Value (or a pointer to the inline value, if \arg value_size
+///         is set) or NULL, if the key is not present.
+extern void const * hmap_frozen_get(
+    struct hmap_frozen const * frozen,
+    void const * key);
+
+/// Returns true, if a key is present.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \param key Key to check.
+/// \return true, if the key is present.
+extern bool hmap_frozen_contains(
+    struct hmap_frozen const * frozen,
+    void const * key);
+
 #ifdef __cplusplus
 }
 #endif
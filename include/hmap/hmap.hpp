@@ -0,0 +1,539 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_HPP
+#define HMAP_HPP
+
+#include "hmap/detail/probe.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hmap_cpp
+{
+
+// Open addressing with linear probing, resolved at compile time.
+//
+// The layout is the one of the open addressing engine of hmap: slots
+// store the hash of their entry, control bytes are probed a group at a
+// time and removals use backward shift deletion. The probing primitives
+// are shared with the C engines (see hmap/detail/probe.h). Since the C
+// engine calls its match function through a pointer, slots are
+// instantiated here for the key, value, hash and equality types, so
+// that hashing and comparison can be inlined.
+
+/// Hashmap with keys and values stored inline.
+///
+/// Keys and values are owned by the map. Both only need to be
+/// move constructible, so move-only types are supported.
+///
+/// \note Home slots and control byte fragments are taken from the
+///       top bits of the Fibonacci product of the result of \arg Hash,
+///       so weak hash functions like the identity are fine.
+/// \note Pointers to values and iterators are invalidated by
+///       subsequent inserts and removals.
+/// \note If growing the map throws, the map is left unchanged, unless
+///       keys or values are move-only types whose move constructor
+///       may throw.
+///
+/// \tparam Key Type of the keys.
+/// \tparam Value Type of the values.
+/// \tparam Hash Function object used to hash keys.
+/// \tparam Eq Function object used to compare keys.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Eq = std::equal_to<Key>>
+class map
+{
+    struct slot
+    {
+        size_t hash;
+        Key key;
+        Value value;
+    };
+
+    static constexpr size_t initial_slots = 16;
+
+    /// Entries are moved into a grown map only, if this cannot throw
+    /// or they cannot be copied; otherwise they are copied.
+    static constexpr bool move_on_rehash =
+        (std::is_nothrow_move_constructible<Key>::value && std::is_nothrow_move_constructible<Value>::value) ||
+        (!std::is_copy_constructible<Key>::value) || (!std::is_copy_constructible<Value>::value);
+
+    /// Iterates over the entries of a map.
+    ///
+    /// Dereferencing yields a pair of references to the key and the
+    /// value of the current entry.
+    ///
+    /// \note The order of the entries is unspecified.
+    template <bool Const>
+    class basic_iterator
+    {
+        friend class map;
+        using owner_type = typename std::conditional<Const, map const, map>::type;
+        using mapped_type = typename std::conditional<Const, Value const, Value>::type;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::pair<Key const, Value>;
+        using reference = std::pair<Key const &, mapped_type &>;
+
+        /// Result of operator->, which holds the pair of references.
+        class pointer
+        {
+            friend class basic_iterator;
+
+        public:
+            reference const * operator->() const { return &entry_; }
+
+        private:
+            explicit pointer(reference entry): entry_(entry) { }
+
+            reference entry_;
+        };
+
+        reference operator*() const
+        {
+            slot & current = map_->slots_[id_];
+            return reference(current.key, current.value);
+        }
+
+        pointer operator->() const { return pointer(**this); }
+
+        basic_iterator & operator++() { id_ = map_->next(id_ + 1); return *this; }
+        basic_iterator operator++(int) { basic_iterator previous = *this; ++(*this); return previous; }
+        bool operator==(basic_iterator const & other) const { return id_ == other.id_; }
+        bool operator!=(basic_iterator const & other) const { return id_ != other.id_; }
+
+    private:
+        basic_iterator(owner_type * owner, size_t id): map_(owner), id_(id) { }
+
+        owner_type * map_;
+        size_t id_;
+    };
+
+public:
+    /// Iterator whose values may be modified.
+    using iterator = basic_iterator<false>;
+
+    /// Iterator of a const map.
+    using const_iterator = basic_iterator<true>;
+
+    /// Creates a new map.
+    ///
+    /// \param capacity Number of entries to reserve space for.
+    /// \param hash Function object used to hash keys.
+    /// \param eq Function object used to compare keys.
+    explicit map(size_t capacity = 0, Hash const & hash = Hash(), Eq const & eq = Eq())
+    : map(slot_count_tag(), slot_count_for(capacity, default_load_factor), hash, eq, default_load_factor)
+    {
+    }
+
+    ~map()
+    {
+        release();
+    }
+
+    map(map const &) = delete;
+    map & operator=(map const &) = delete;
+
+    map(map && other) noexcept
+    : hash_(std::move(other.hash_))
+    , eq_(std::move(other.eq_))
+    , max_load_factor_(other.max_load_factor_)
+    , size_(other.size_)
+    , slot_count_(other.slot_count_)
+    , threshold_(other.threshold_)
+    , slots_(other.slots_)
+    , ctrl_(other.ctrl_)
+    {
+        other.size_ = 0;
+        other.slot_count_ = 0;
+        other.threshold_ = 0;
+        other.slots_ = nullptr;
+        other.ctrl_ = nullptr;
+    }
+
+    map & operator=(map && other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            hash_ = std::move(other.hash_);
+            eq_ = std::move(other.eq_);
+            max_load_factor_ = other.max_load_factor_;
+            size_ = other.size_;
+            slot_count_ = other.slot_count_;
+            threshold_ = other.threshold_;
+            slots_ = other.slots_;
+            ctrl_ = other.ctrl_;
+
+            other.size_ = 0;
+            other.slot_count_ = 0;
+            other.threshold_ = 0;
+            other.slots_ = nullptr;
+            other.ctrl_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    /// Returns the number of entries.
+    size_t size() const { return size_; }
+
+    /// Returns true, if the map contains no entries.
+    bool empty() const { return 0 == size_; }
+
+    /// Adds or replaces a value.
+    ///
+    /// \param key Key of the value.
+    /// \param value Value to add.
+    /// \return true, if the key was newly added.
+    template <typename K, typename V>
+    bool add(K && key, V && value)
+    {
+        size_t hash = hash_of(key);
+        bool created = false;
+        size_t id = insert(hash, key, created);
+        if (created)
+        {
+            construct(id, hash, std::forward<K>(key), std::forward<V>(value));
+        }
+        else
+        {
+            slots_[id].value = std::forward<V>(value);
+        }
+
+        return created;
+    }
+
+    /// Returns the value of a key and creates it if needed.
+    ///
+    /// \note A newly created value is value-initialized.
+    ///
+    /// \param key Key of the value.
+    /// \return Reference to the value stored in the map.
+    template <typename K>
+    Value & get_or_insert(K && key)
+    {
+        return *emplace(std::forward<K>(key)).first;
+    }
+
+    /// Constructs a value in place, unless the key is already present.
+    ///
+    /// \param key Key of the value.
+    /// \param args Arguments passed to the constructor of the value.
+    /// \return Pointer to the value stored in the map and true,
+    ///         if the value was newly constructed.
+    template <typename K, typename... Args>
+    std::pair<Value *, bool> emplace(K && key, Args &&... args)
+    {
+        size_t hash = hash_of(key);
+        bool created = false;
+        size_t id = insert(hash, key, created);
+        if (created)
+        {
+            construct(id, hash, std::forward<K>(key), std::forward<Args>(args)...);
+        }
+
+        return std::pair<Value *, bool>(&(slots_[id].value), created);
+    }
+
+    /// Returns the value of a key.
+    ///
+    /// \param key Key of the value.
+    /// \return Pointer to the value or nullptr, if the key is not present.
+    Value * get(Key const & key)
+    {
+        if (0 == size_)
+        {
+            return nullptr;
+        }
+
+        bool found = false;
+        size_t id = probe(hash_of(key), key, found);
+        return found ? &(slots_[id].value) : nullptr;
+    }
+
+    /// Returns the value of a key.
+    ///
+    /// \param key Key of the value.
+    /// \return Pointer to the value or nullptr, if the key is not present.
+    Value const * get(Key const & key) const
+    {
+        if (0 == size_)
+        {
+            return nullptr;
+        }
+
+        bool found = false;
+        size_t id = probe(hash_of(key), key, found);
+        return found ? &(slots_[id].value) : nullptr;
+    }
+
+    /// Returns true, if the key is present.
+    bool contains(Key const & key) const
+    {
+        return nullptr != get(key);
+    }
+
+    /// Removes a key and destroys its value.
+    ///
+    /// \param key Key to remove.
+    /// \return true, if the key was removed.
+    bool remove(Key const & key)
+    {
+        bool found = false;
+        size_t hole = (0 < size_) ? probe(hash_of(key), key, found) : 0;
+        if (!found)
+        {
+            return false;
+        }
+
+        size_t mask = slot_count_ - 1;
+        destroy(hole);
+        size_--;
+
+        // shift following entries back
+        size_t id = (hole + 1) & mask;
+        while (HMAP_CTRL_EMPTY != ctrl_[id])
+        {
+            if (hmap_probe_canshift(id, home_of(slots_[id].hash), hole, mask))
+            {
+                move(hole, slots_[id]);
+                destroy(id);
+                hole = id;
+            }
+            id = (id + 1) & mask;
+        }
+
+        return true;
+    }
+
+    /// Reserves space for \arg capacity entries.
+    void reserve(size_t capacity)
+    {
+        size_t slot_count = slot_count_for(capacity, max_load_factor_);
+        if (nullptr == slots_)
+        {
+            // moved-from maps have no slots
+            allocate(slot_count);
+        }
+        else if (slot_count > slot_count_)
+        {
+            rehash(slot_count);
+        }
+    }
+
+    /// Shrinks the map to the smallest size able to store its entries.
+    void shrink_to_fit()
+    {
+        size_t slot_count = slot_count_for(size_, max_load_factor_);
+        if ((nullptr != slots_) && (slot_count < slot_count_))
+        {
+            rehash(slot_count);
+        }
+    }
+
+    iterator begin() { return iterator(this, next(0)); }
+    iterator end() { return iterator(this, slot_count_); }
+    const_iterator begin() const { return const_iterator(this, next(0)); }
+    const_iterator end() const { return const_iterator(this, slot_count_); }
+
+private:
+    static constexpr double default_load_factor = 0.7;
+
+    struct slot_count_tag { };
+
+    /// Creates a map with exactly \arg slot_count slots.
+    map(slot_count_tag, size_t slot_count, Hash const & hash, Eq const & eq, double max_load_factor)
+    : hash_(hash)
+    , eq_(eq)
+    , max_load_factor_(max_load_factor)
+    , size_(0)
+    , slot_count_(0)
+    , threshold_(0)
+    , slots_(nullptr)
+    , ctrl_(nullptr)
+    {
+        allocate(slot_count);
+    }
+
+    template <typename K>
+    size_t hash_of(K const & key) const
+    {
+        return static_cast<size_t>(hash_(key));
+    }
+
+    /// Returns the home slot of \arg hash, see \see hmap_table_gethome.
+    size_t home_of(size_t hash) const
+    {
+        return hmap_table_gethome(hash, slot_count_);
+    }
+
+    static size_t threshold_for(size_t slot_count, double max_load_factor)
+    {
+        size_t threshold = static_cast<size_t>(max_load_factor * static_cast<double>(slot_count));
+
+        // at least one empty slot is needed to terminate probing
+        return (threshold > (slot_count - 2)) ? (slot_count - 2) : threshold;
+    }
+
+    static size_t slot_count_for(size_t capacity, double max_load_factor)
+    {
+        size_t slot_count = initial_slots;
+        while (threshold_for(slot_count, max_load_factor) < capacity)
+        {
+            slot_count *= 2;
+        }
+
+        return slot_count;
+    }
+
+    void allocate(size_t slot_count)
+    {
+        std::unique_ptr<unsigned char[]> ctrl(new unsigned char[slot_count + HMAP_GROUP_WIDTH]);
+        std::memset(ctrl.get(), HMAP_CTRL_EMPTY, slot_count + HMAP_GROUP_WIDTH);
+        slots_ = std::allocator<slot>().allocate(slot_count);
+        ctrl_ = ctrl.release();
+        slot_count_ = slot_count;
+        threshold_ = threshold_for(slot_count, max_load_factor_);
+    }
+
+    void release()
+    {
+        if (nullptr != slots_)
+        {
+            for (size_t i = 0; i < slot_count_; i++)
+            {
+                if (HMAP_CTRL_EMPTY != ctrl_[i])
+                {
+                    slots_[i].~slot();
+                }
+            }
+
+            std::allocator<slot>().deallocate(slots_, slot_count_);
+            delete[] ctrl_;
+            slots_ = nullptr;
+            ctrl_ = nullptr;
+        }
+    }
+
+    template <typename K, typename... Args>
+    void construct(size_t id, size_t hash, K && key, Args &&... args)
+    {
+        ::new (static_cast<void *>(&(slots_[id]))) slot{hash, Key(std::forward<K>(key)), Value(std::forward<Args>(args)...)};
+        hmap_probe_setctrl(ctrl_, slot_count_, id, hmap_table_getfragment(hash, slot_count_));
+        size_++;
+    }
+
+    void move(size_t id, slot & source)
+    {
+        ::new (static_cast<void *>(&(slots_[id]))) slot{source.hash, std::move(source.key), std::move(source.value)};
+        hmap_probe_setctrl(ctrl_, slot_count_, id, hmap_table_getfragment(source.hash, slot_count_));
+    }
+
+    void destroy(size_t id)
+    {
+        slots_[id].~slot();
+        hmap_probe_setctrl(ctrl_, slot_count_, id, HMAP_CTRL_EMPTY);
+    }
+
+    /// Returns \arg value as rvalue, if entries are moved on rehash.
+    template <typename T>
+    static typename std::conditional<move_on_rehash, T &&, T const &>::type relocate(T & value)
+    {
+        return static_cast<typename std::conditional<move_on_rehash, T &&, T const &>::type>(value);
+    }
+
+    /// Probes for \arg key starting at its home slot.
+    ///
+    /// \return Id of the slot storing \arg key or the id of the first
+    ///         empty slot of the probe sequence, if \arg key is not found.
+    template <typename K>
+    size_t probe(size_t hash, K const & key, bool & found) const
+    {
+        hmap_probe state;
+        hmap_probe_start(&state, ctrl_, slot_count_, hash);
+
+        size_t id = 0;
+        while (hmap_probe_next(&state, ctrl_, &id))
+        {
+            slot const & current = slots_[id];
+            if ((hash == current.hash) && (eq_(current.key, key)))
+            {
+                found = true;
+                return id;
+            }
+        }
+
+        found = false;
+        return id;
+    }
+
+    /// Returns the slot of \arg key or the empty slot to store it.
+    template <typename K>
+    size_t insert(size_t hash, K const & key, bool & created)
+    {
+        if (nullptr == slots_)
+        {
+            // moved-from maps have no slots
+            allocate(initial_slots);
+        }
+        else if (size_ > threshold_)
+        {
+            rehash(2 * slot_count_);
+        }
+
+        bool found = false;
+        size_t id = probe(hash, key, found);
+        created = !found;
+        return id;
+    }
+
+    /// Rebuilds the map with \arg new_slot_count slots.
+    ///
+    /// Entries are placed into a new map, which replaces this one once
+    /// all entries are placed. If placing an entry throws, the new map
+    /// is destroyed and this map is left unchanged (see \see relocate).
+    void rehash(size_t new_slot_count)
+    {
+        map rebuilt(slot_count_tag(), new_slot_count, hash_, eq_, max_load_factor_);
+        for (size_t i = 0; i < slot_count_; i++)
+        {
+            if (HMAP_CTRL_EMPTY != ctrl_[i])
+            {
+                slot & source = slots_[i];
+                size_t id = hmap_probe_findempty(rebuilt.ctrl_, new_slot_count, rebuilt.home_of(source.hash));
+                rebuilt.construct(id, source.hash, relocate(source.key), relocate(source.value));
+            }
+        }
+
+        *this = std::move(rebuilt);
+    }
+
+    /// Returns the id of the first used slot at or behind \arg id.
+    size_t next(size_t id) const
+    {
+        return hmap_probe_nextused(ctrl_, slot_count_, 0, id);
+    }
+
+    Hash hash_;
+    Eq eq_;
+    double max_load_factor_;
+    size_t size_;
+    size_t slot_count_;
+    size_t threshold_;
+    slot * slots_;
+    unsigned char * ctrl_;
+};
+
+}
+
+#endif
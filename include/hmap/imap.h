@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef IMAP_H
+#define IMAP_H
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Releases an item.
+///
+/// \param item Item to release.
+typedef void imap_release_fn(void * item);
+
+/// Allocates memory.
+///
+/// \param size Number of bytes to allocate.
+/// \param context User defined context of the allocator.
+/// \return Pointer to the allocated memory.
+typedef void * imap_alloc_fn(size_t size, void * context);
+
+/// Frees memory allocated by \see imap_alloc_fn.
+///
+/// \param ptr Pointer to the memory to free.
+/// \param size Number of bytes allocated.
+/// \param context User defined context of the allocator.
+typedef void imap_free_fn(void * ptr, size_t size, void * context);
+
+/// Allocator used for the internal memory of a Hashmap.
+struct imap_allocator
+{
+    imap_alloc_fn * alloc;      ///< Allocates memory; NULL to use malloc.
+    imap_free_fn * free;        ///< Frees memory; NULL if memory is not freed individually (e.g. arenas).
+    void * context;             ///< Passed to \arg alloc and \arg free.
+};
+
+struct imap;
+
+/// Options used to create a Hashmap with integer keys.
+///
+/// \note Use \see imap_options_init to initialize the options
+///       with default values before setting individual fields.
+struct imap_options
+{
+    size_t seed;                        ///< Seed used for hash randomization.
+    imap_release_fn * release_value;    ///< Used to release values; NULL if values are not released.
+    size_t capacity;                    ///< Number of items to reserve space for (defaults to 0).
+    double max_load_factor;             ///< Average number of items per slot that triggers growth (defaults to 0.7);
+                                        ///< limited below 1.
+    struct imap_allocator allocator;    ///< Allocator of internal memory (defaults to malloc and free).
+};
+
+/// Hashmap iterator.
+///
+/// \note Do note use any field of this struct.
+struct imap_iter
+{
+    struct imap * map;              ///< Pointer to Hashmap; do not use
+    size_t slot_id;                 ///< Id of the next slot; do not use
+    uint64_t key;                   ///< Key of the current item; do not use
+    void * value;                   ///< Value of the current item; do not use
+};
+
+/// Initializes Hashmap options with default values.
+///
+/// \param options Pointer to the options to initialize.
+extern void imap_options_init(
+    struct imap_options * options);
+
+/// Creates a new Hashmap with integer keys.
+///
+/// Keys are stored inline and hashed by a built-in mixer function,
+/// so no callbacks are involved to find an item.
+///
+/// \param seed          Seed used for hash randomization.
+/// \param release_value Used to release values.
+/// \return newly creates Hashmap.
+extern struct imap * imap_create(
+    size_t seed,
+    imap_release_fn * release_value);
+
+/// Creates a new Hashmap with integer keys using the given options.
+///
+/// \param options Options of the Hashmap.
+/// \return newly creates Hashmap.
+extern struct imap * imap_create_ex(
+    struct imap_options const * options);
+
+/// Releases a Hashmap.
+///
+/// \param map Pointer to Hashmap.
+extern void imap_release(
+    struct imap * map);
+
+/// Adds or updates a value.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value.
+/// \param value value to add or update.
+extern void imap_add(
+    struct imap * map,
+    uint64_t key,
+    void * value);
+
+/// Returns the value slot of a given key, inserting the key if it does not exist.
+///
+/// If the item was newly created, its value is set to NULL.
+///
+/// \note The returned pointer is invalidated by any later modification
+///       of the Hashmap.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value associated with \arg key.
+extern void ** imap_get_or_insert(
+    struct imap * map,
+    uint64_t key,
+    bool * created);
+
+/// Return the value of a given key.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value to get.
+/// \return Value assiciated with \arg key or NULL, if key not found.
+extern void const * imap_get(
+    struct imap * map,
+    uint64_t key);
+
+/// Returns true, if the Hashmap contains \arg key.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key to test.
+/// \return True, if \arg key is contained in the Hashmap, otherwise false.
+extern bool imap_contains(
+    struct imap * map,
+    uint64_t key);
+
+/// Removes an item from the Hashmap.
+///
+/// \param map Pointer to the Hashmap.
+/// \param key Key of the item to remove.
+extern void imap_remove(
+    struct imap * map,
+    uint64_t key);
+
+/// Reserves space for at least \arg capacity items.
+///
+/// \note Adding up to \arg capacity items does not cause the
+///       Hashmap to grow.
+///
+/// \param map Pointer to the Hashmap.
+/// \param capacity Number of items to reserve space for.
+extern void imap_reserve(
+    struct imap * map,
+    size_t capacity);
+
+/// Shrinks the Hashmap to the smallest size able to store its items.
+///
+/// \param map Pointer to the Hashmap.
+extern void imap_shrink_to_fit(
+    struct imap * map);
+
+/// Initialized an iterator for a given Hashmap.
+///
+/// \note The iterator is positioned before the first element.
+///       Therefore, a call to \see imap_iter_next is needed to
+///       retrieve the first item.
+///
+/// \note The Hashmap must not be changed during iteration.
+///
+/// \param iter Pointer to the iterator.
+/// \param map Pointer to the Hashmap to iterate.
+extern void imap_iter_init(
+    struct imap_iter * iter,
+    struct imap * map);
+
+/// Retrieves the next item of the Hashmap.
+///
+/// \note The Hashmap must not be changes during iteration.
+///
+/// \param iter Pointer to the iterator.
+/// \return True, if the next item is fetched successfully, otherwise false.
+extern bool imap_iter_next(
+    struct imap_iter * iter);
+
+/// Returns the currently fetched key.
+///
+/// \note The Hashmap must not be changes during iteration.
+///
+/// \param iter Pointer to the iterator.
+/// \return Currently fetched key or 0, if no key is fetched.
+extern uint64_t imap_iter_key(
+    struct imap_iter * iter);
+
+/// Returns the currently fetched value.
+///
+/// \note The Hashmap must not be changes during iteration.
+///
+/// \param iter Pointer to the iterator.
+/// \return Currently fetched value or NULL, if no value is fetched.
+extern void const * imap_iter_value(
+    struct imap_iter * iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,9 +21,127 @@ extern "C"
 /// \param item Item to release.
 typedef void smap_release_fn(void * item);
 
+/// Allocates memory.
+///
+/// \param size Number of bytes to allocate.
+/// \param context User defined context of the allocator.
+/// \return Pointer to the allocated memory.
+typedef void * smap_alloc_fn(size_t size, void * context);
+
+/// Frees memory allocated by \see smap_alloc_fn.
+///
+/// \param ptr Pointer to the memory to free.
+/// \param size Number of bytes allocated.
+/// \param context User defined context of the allocator.
+typedef void smap_free_fn(void * ptr, size_t size, void * context);
+
+/// Serializes a value for \see smap_save.
+///
+/// \note The function is called twice per value: first to query the
+///       size of the serialized value, then to serialize it.
+///
+/// \param value Value to serialize.
+/// \param buffer Receives the serialized value; NULL to query its size.
+/// \param context User defined context.
+/// \return Size of the serialized value in bytes.
+typedef size_t smap_serialize_fn(void const * value, void * buffer, void * context);
+
+/// Decides, whether an item is kept by \see smap_retain.
+///
+/// \param key Key of the item.
+/// \param length Length of \arg key in bytes.
+/// \param value Value of the item (or a pointer to the inline value, if
+///              \arg value_size is set).
+/// \param context User defined context.
+/// \return true, if the item is kept; false, if it is removed.
+typedef bool smap_predicate_fn(char const * key, size_t length, void const * value, void * context);
+
+/// Allocator used for the internal memory of a Hashmap.
+struct smap_allocator
+{
+    smap_alloc_fn * alloc;      ///< Allocates memory; NULL to use malloc.
+    smap_free_fn * free;        ///< Frees memory; NULL if memory is not freed individually (e.g. arenas).
+    void * context;             ///< Passed to \arg alloc and \arg free.
+};
+
 struct smap;
-struct smap_bucket;
 struct smap_entry;
+struct smap_frozen;
+
+/// Storage engine of a Hashmap.
+enum smap_engine
+{
+    SMAP_ENGINE_CHAINED,            ///< Separate chaining; one heap node per entry (default)
+    SMAP_ENGINE_OPEN,               ///< Open addressing; entries are stored in a contiguous slot array
+    SMAP_ENGINE_DENSE               ///< Entries are stored in insertion order in a dense array referenced
+                                    ///< by a compact index; iteration visits entries in insertion order
+};
+
+/// Hash function of a Hashmap with string keys.
+enum smap_hash
+{
+    SMAP_HASH_WYHASH,               ///< Fast seeded hash processing 8 bytes at a time (default)
+    SMAP_HASH_SIPHASH,              ///< Keyed SipHash-2-4; resists hash flooding as long as the key is secret
+    SMAP_HASH_DJB2                  ///< djb2 as used by earlier versions; kept for compatibility
+};
+
+/// Size of the secret key used by \see SMAP_HASH_SIPHASH in bytes.
+#define SMAP_HASH_KEY_SIZE 16
+
+/// Options used to create a Hashmap with string keys.
+///
+/// \note Use \see smap_options_init to initialize the options
+///       with default values before setting individual fields.
+struct smap_options
+{
+    size_t seed;                        ///< Seed used for hash randomization.
+    smap_release_fn * release_value;    ///< Used to release values; NULL if values are not released.
+    size_t value_size;                  ///< Size of values stored inline in bytes; 0 to store value
+                                        ///< pointers (default). Inline values are aligned to pointers.
+    enum smap_hash hash;                ///< Hash function (defaults to \see SMAP_HASH_WYHASH).
+    unsigned char hash_key[SMAP_HASH_KEY_SIZE]; ///< Secret key of \see SMAP_HASH_SIPHASH (defaults to zero);
+                                        ///< should be filled from a random source; \arg seed is mixed in.
+    enum smap_engine engine;            ///< Storage engine (defaults to \see SMAP_ENGINE_CHAINED).
+    bool incremental_rehash;            ///< Grow in small steps on add and remove instead of all at once;
+                                        ///< only supported by \see SMAP_ENGINE_CHAINED (defaults to false).
+    size_t rehash_threads;              ///< Number of threads moving entries when the Hashmap grows at once;
+                                        ///< 0 for one thread per processor; only supported by
+                                        ///< \see SMAP_ENGINE_CHAINED (defaults to 1).
+    size_t capacity;                    ///< Number of items to reserve space for (defaults to 0).
+    double max_load_factor;             ///< Average number of items per bucket that triggers growth (defaults to 0.7);
+                                        ///< limited below 1 for \see SMAP_ENGINE_OPEN and \see SMAP_ENGINE_DENSE.
+    struct smap_allocator allocator;    ///< Allocator of internal memory including keys (defaults to malloc and free).
+};
+
+/// Number of buckets of the probe length histogram.
+#define SMAP_STATS_HISTOGRAM_SIZE 16
+
+/// Statistics of a Hashmap with string keys.
+///
+/// The probe length of an item is the number of items compared
+/// when the item is looked up, i.e. its position within its chain
+/// (\see SMAP_ENGINE_CHAINED) or its distance to its home slot
+/// plus one (\see SMAP_ENGINE_OPEN and \see SMAP_ENGINE_DENSE).
+///
+/// \note The counters of lookups, misses and comparisons are only
+///       maintained, if the library is built with the CMake option
+///       WITH_STATS_COUNTERS; otherwise they are always 0.
+struct smap_stats
+{
+    size_t size;                        ///< Number of items.
+    size_t bucket_count;                ///< Number of buckets or slots.
+    size_t capacity;                    ///< Number of items that can be stored before the Hashmap grows.
+    double load_factor;                 ///< Number of items per bucket.
+    size_t bytes_allocated;             ///< Memory allocated by the Hashmap in bytes (including keys).
+    size_t rehash_count;                ///< Number of times the Hashmap was resized.
+    size_t max_probe_length;            ///< Maximum probe length of all items.
+    double mean_probe_length;           ///< Mean probe length of all items.
+    size_t probe_histogram[SMAP_STATS_HISTOGRAM_SIZE];  ///< Number of items per probe length, starting at 1;
+                                        ///< the last bucket also counts all longer probes.
+    size_t lookups;                     ///< Number of lookups including adds and removes.
+    size_t misses;                      ///< Number of lookups of keys that were not found.
+    size_t comparisons;                 ///< Number of key comparisons.
+};
 
 /// Hashmap iterator.
 ///
@@ -31,10 +149,18 @@ struct smap_entry;
 struct smap_iter
 {
     struct smap * map;              ///< Pointer to Hashmap; do not use
-    size_t bucket_id;               ///< Id of the current bucket; do not use
+    size_t bucket_id;               ///< Id of the current bucket or slot; do not use
+    size_t start;                   ///< Position the iteration started at; do not use
+    void * position;                ///< Position within the current bucket; do not use
     struct smap_entry * entry;      ///< Pointer to the current Hashmap entry; do not use
 };
 
+/// Initializes Hashmap options with default values.
+///
+/// \param options Pointer to the options to initialize.
+extern void smap_options_init(
+    struct smap_options * options);
+
 /// Creates a new Hashmap with string keys.
 ///
 /// \param seed          Seed used for hash randomization.
@@ -44,6 +170,39 @@ extern struct smap * smap_create(
     size_t seed,
     smap_release_fn * release_value);
 
+/// Creates a new Hashmap with string keys using the given options.
+///
+/// \param options Options of the Hashmap.
+/// \return newly creates Hashmap.
+extern struct smap * smap_create_ex(
+    struct smap_options const * options);
+
+/// Creates a new Hashmap from arrays of keys and values using multiple threads.
+///
+/// The Hashmap is sized to store all items before they are inserted,
+/// keys are hashed and copied in parallel and the items are inserted in
+/// parallel into disjoint ranges of buckets.
+///
+/// Items with equal keys are handled as if they were added in order
+/// using \see smap_add: the last value is stored and the values of the
+/// previous items are released.
+///
+/// \note Release functions are only called by the calling thread.
+///
+/// \param options      Options of the Hashmap.
+/// \param keys         Keys of the items; the keys are copied.
+/// \param values       Values of the items (or pointers to the inline values, if
+///                     \arg value_size is set); NULL to store NULL values.
+/// \param count        Number of items.
+/// \param thread_count Number of threads to use; 0 to use one thread per processor.
+/// \return Newly created Hashmap.
+extern struct smap * smap_build_bulk(
+    struct smap_options const * options,
+    char const * const * keys,
+    void * const * values,
+    size_t count,
+    size_t thread_count);
+
 /// Releases a Hashmap.
 ///
 /// \param map Pointer to Hashmap.
@@ -51,6 +210,9 @@ extern void smap_release(struct smap * map);
 
 /// Adds or updates a value.
 ///
+/// \note If \arg value_size is set, \arg value points to the bytes
+///       to copy into the Hashmap; NULL sets all bytes to 0.
+///
 /// \param map Pointer to Hashmap.
 /// \param key Key of the value.
 /// \param value value to add or update.
@@ -59,8 +221,108 @@ extern void smap_add(
     char const * key,
     void * value);
 
+/// Adds or updates a value using a key of known length.
+///
+/// \note The key does not need to be terminated by '\0' and
+///       may contain '\0' characters.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value.
+/// \param length Length of \arg key in bytes.
+/// \param value value to add or update.
+extern void smap_add_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    void * value);
+
+/// Returns the value slot of a given key, inserting the key if it does not exist.
+///
+/// The key is hashed and looked up only once. If the item was newly
+/// created, its value is set to NULL. The key is copied into the Hashmap
+/// only for a newly created item, so \arg key always remains owned by
+/// the caller.
+///
+/// A value written through the returned pointer is owned by the Hashmap.
+/// Overwriting an existing value does not release it; the caller must
+/// release it before, unlike \see smap_add.
+///
+/// \note The returned pointer is invalidated by any later modification
+///       of the Hashmap.
+/// \note If \arg value_size is set, the returned pointer points to the
+///       inline value, which is set to 0 for newly created items.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value associated with \arg key.
+extern void ** smap_get_or_insert(
+    struct smap * map,
+    char const * key,
+    bool * created);
+
+/// Returns the value slot of a given key of known length, inserting the key if it does not exist.
+///
+/// Same as \see smap_get_or_insert, but the key may contain '\0' characters.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value; does not need to be terminated by '\0'.
+/// \param length Length of \arg key in bytes.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value associated with \arg key.
+extern void ** smap_get_or_insert_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    bool * created);
+
+/// Adds a value, unless \arg key already exists.
+///
+/// The key is hashed and looked up only once; it is copied only for a
+/// newly created item and always remains owned by the caller. If the item
+/// was newly created, the Hashmap takes ownership of \arg value. In
+/// contrast to \see smap_add an existing value is neither updated nor
+/// released: it is kept, while \arg value remains owned by the caller,
+/// who must release it.
+///
+/// \note The returned pointer is invalidated by any later modification
+///       of the Hashmap.
+/// \note If \arg value_size is set, \arg value points to the bytes to
+///       copy into a newly created item and always remains owned by the
+///       caller; the returned pointer points to the inline value.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value.
+/// \param value Value to add, if \arg key does not exist.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value associated with \arg key.
+extern void ** smap_emplace(
+    struct smap * map,
+    char const * key,
+    void * value,
+    bool * created);
+
+/// Adds a value using a key of known length, unless the key already exists.
+///
+/// Same as \see smap_emplace, but the key may contain '\0' characters.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value; does not need to be terminated by '\0'.
+/// \param length Length of \arg key in bytes.
+/// \param value Value to add, if \arg key does not exist.
+/// \param created Set to true, if the item was newly created; may be NULL.
+/// \return Pointer to the value associated with \arg key.
+extern void ** smap_emplace_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    void * value,
+    bool * created);
+
 /// Return the value of a given key.
 ///
+/// \note If \arg value_size is set, a pointer to the inline value is returned.
+///
 /// \param map Pointer to Hashmap.
 /// \param key Key of the value to get.
 /// \return Value assiciated with \arg key or NULL, if key not found.
@@ -68,6 +330,47 @@ extern void const * smap_get(
     struct smap * map,
     char const * key);
 
+/// Return the value of a given key of known length.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key of the value to get; does not need to be terminated by '\0'.
+/// \param length Length of \arg key in bytes.
+/// \return Value assiciated with \arg key or NULL, if key not found.
+extern void const * smap_get_n(
+    struct smap * map,
+    char const * key,
+    size_t length);
+
+/// Return the values of multiple keys.
+///
+/// Keys are hashed and their buckets are prefetched in small batches
+/// before they are looked up, so that cache misses of different keys
+/// overlap. This is faster than calling \see smap_get for each key.
+///
+/// \param map Pointer to Hashmap.
+/// \param keys Keys of the values to get.
+/// \param count Number of keys.
+/// \param values Receives the value of each key or NULL, if the key was not found.
+extern void smap_get_batch(
+    struct smap * map,
+    char const * const * keys,
+    size_t count,
+    void const * * values);
+
+/// Return the values of multiple keys of known length.
+///
+/// \param map Pointer to Hashmap.
+/// \param keys Keys of the values to get; do not need to be terminated by '\0'.
+/// \param lengths Length of each key in bytes.
+/// \param count Number of keys.
+/// \param values Receives the value of each key or NULL, if the key was not found.
+extern void smap_get_batch_n(
+    struct smap * map,
+    char const * const * keys,
+    size_t const * lengths,
+    size_t count,
+    void const * * values);
+
 /// Returns true, if the Hashmap contains \arg key.
 ///
 /// \param map Pointer to Hashmap.
@@ -77,6 +380,17 @@ extern bool smap_contains(
     struct smap * map,
     char const * key);
 
+/// Returns true, if the Hashmap contains \arg key of known length.
+///
+/// \param map Pointer to Hashmap.
+/// \param key Key to test; does not need to be terminated by '\0'.
+/// \param length Length of \arg key in bytes.
+/// \return True, if \arg key is contained in the Hashmap, otherwise false.
+extern bool smap_contains_n(
+    struct smap * map,
+    char const * key,
+    size_t length);
+
 /// Removes an item from the Hashmap.
 ///
 /// \param map Pointer to the Hashmap.
@@ -85,13 +399,64 @@ extern void smap_remove(
     struct smap * map,
     char const * key);
 
+/// Removes an item with a key of known length from the Hashmap.
+///
+/// \param map Pointer to the Hashmap.
+/// \param key Key of the item to remove; does not need to be terminated by '\0'.
+/// \param length Length of \arg key in bytes.
+extern void smap_remove_n(
+    struct smap * map,
+    char const * key,
+    size_t length);
+
+/// Removes all items for which \arg predicate returns false.
+///
+/// The items are visited in a single pass and removed in place,
+/// so the Hashmap does not grow or shrink.
+///
+/// \param map       Pointer to the Hashmap.
+/// \param predicate Returns true for each item to keep.
+/// \param context   Passed to \arg predicate.
+extern void smap_retain(
+    struct smap * map,
+    smap_predicate_fn * predicate,
+    void * context);
+
+/// Reserves space for at least \arg capacity items.
+///
+/// \note Adding up to \arg capacity items does not cause the
+///       Hashmap to grow.
+///
+/// \param map Pointer to the Hashmap.
+/// \param capacity Number of items to reserve space for.
+extern void smap_reserve(
+    struct smap * map,
+    size_t capacity);
+
+/// Shrinks the Hashmap to the smallest size able to store its items.
+///
+/// \param map Pointer to the Hashmap.
+extern void smap_shrink_to_fit(
+    struct smap * map);
+
+/// Returns statistics of a Hashmap.
+///
+/// \note The probe lengths are determined by visiting all items.
+///
+/// \param map Pointer to the Hashmap.
+/// \param stats Receives the statistics.
+extern void smap_get_stats(
+    struct smap * map,
+    struct smap_stats * stats);
+
 /// Initialized an iterator for a given Hashmap.
 ///
 /// \note The iterator is positioned before the first element.
 ///       Therefore, a call to \see smap_inter_next is needed to
 ///       retrieve the first item.
 ///
-/// \note The Hashmap must not be changed during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see smap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \param map Pointer to the Hashmap to iterate.
@@ -101,7 +466,8 @@ extern void smap_iter_init(
 
 /// Retrieves the next item of the Hashmap.
 ///
-/// \note The Hashmap must not be changes during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see smap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \return True, if the next item is fetched successfully, otherwise false.
@@ -110,22 +476,156 @@ extern bool smap_iter_next(
 
 /// Returns the currently fetched key.
 ///
-/// \note The Hashmap must not be changes during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see smap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
 /// \return Currently fetched key or NULL, if no key is fetched. 
 extern char const * smap_iter_key(
     struct smap_iter * iter);
 
+/// Returns the currently fetched key and its length.
+///
+/// \note The key is always terminated by '\0', but may contain
+///       '\0' characters, if it was added using \see smap_add_n.
+///
+/// \param iter Pointer to the iterator.
+/// \param length Set to the length of the key in bytes.
+/// \return Currently fetched key or NULL, if no key is fetched.
+extern char const * smap_iter_key_n(
+    struct smap_iter * iter,
+    size_t * length);
+
 /// Returns the currently fetched value.
 ///
-/// \note The Hashmap must not be changes during iteration.
+/// \note The Hashmap must not be changed during iteration,
+///       except by \see smap_iter_remove.
 ///
 /// \param iter Pointer to the iterator.
-/// \return Currently fetched value or NULL, if no value is fetched. 
+/// \return Currently fetched value (or a pointer to the inline value, if
+///         \arg value_size is set) or NULL, if no value is fetched.
 extern void const * smap_iter_value(
     struct smap_iter * iter);
 
+/// Removes the currently fetched item.
+///
+/// The iteration continues with the next item; all remaining items
+/// are still fetched exactly once. No item is fetched until the next
+/// call of \see smap_iter_next.
+///
+/// \note This is the only way to change the Hashmap during iteration.
+///       Keys fetched before stay valid until the iteration ends.
+///
+/// \param iter Pointer to the iterator.
+extern void smap_iter_remove(
+    struct smap_iter * iter);
+
+/// Converts a Hashmap into an immutable Hashmap using a minimal perfect hash.
+///
+/// Each lookup of a frozen Hashmap reads exactly one slot and compares
+/// exactly one key; there are as many slots as items.
+///
+/// \note On success, \arg map is consumed and must not be used anymore;
+///       its values are owned by the frozen Hashmap.
+/// \note If the hash values of two keys are equal, all keys are hashed
+///       again using a few other seeds. Freezing fails, if keys collide
+///       for each of these seeds, which is unlikely for all hash functions
+///       but \see SMAP_HASH_DJB2. In this case, \arg map is left unchanged.
+///
+/// \param map Pointer to the Hashmap to freeze.
+/// \return Pointer to the frozen Hashmap or NULL, if freezing failed.
+extern struct smap_frozen * smap_freeze(
+    struct smap * map);
+
+/// Releases a frozen Hashmap.
+///
+/// \note Values are released using the release function
+///       of the Hashmap it was created from.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+extern void smap_frozen_release(
+    struct smap_frozen * frozen);
+
+/// Returns the number of items of a frozen Hashmap.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \return Number of items.
+extern size_t smap_frozen_size(
+    struct smap_frozen const * frozen);
+
+/// Returns the value associated with a key.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \param key Key of the value.
+/// \return Value (or a pointer to the inline value, if \arg value_size
+///         is set) or NULL, if the key is not present.
+extern void const * smap_frozen_get(
+    struct smap_frozen const * frozen,
+    char const * key);
+
+/// Returns the value associated with a key of a given length.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \param key Key of the value.
+/// \param length Length of the key in bytes.
+/// \return Value (or a pointer to the inline value, if \arg value_size
+///         is set) or NULL, if the key is not present.
+extern void const * smap_frozen_get_n(
+    struct smap_frozen const * frozen,
+    char const * key,
+    size_t length);
+
+/// Returns true, if a key is present.
+///
+/// \param frozen Pointer to the frozen Hashmap.
+/// \param key Key to check.
+/// \return true, if the key is present.
+extern bool smap_frozen_contains(
+    struct smap_frozen const * frozen,
+    char const * key);
+
+/// Writes a Hashmap into a file, which can be mapped by \see smap_load.
+///
+/// The file contains the keys, the serialized values and a perfect hash
+/// table (\see smap_freeze) referencing both by offset, so it is
+/// independent of the address it is mapped to. Inline values
+/// (\arg value_size) are written as they are.
+///
+/// \note The file uses the byte order and size of size_t of the
+///       writing platform; it can only be loaded by the same platform.
+/// \note \arg map is not modified; keys of removed items are not
+///       written to the file.
+///
+/// \param map Pointer to the Hashmap to write.
+/// \param path Path of the file to write.
+/// \param serialize Used to serialize values; NULL if \arg value_size
+///        is set or values are not written (all values load as NULL).
+/// \param context Passed to \arg serialize.
+/// \return true on success; false, if the file could not be written
+///         or keys collide for each seed tried (\see smap_freeze).
+extern bool smap_save(
+    struct smap * map,
+    char const * path,
+    smap_serialize_fn * serialize,
+    void * context);
+
+/// Maps a file written by \see smap_save into memory.
+///
+/// Lookups are served directly from the mapping; neither keys nor
+/// values are copied. Since the mapping is read-only and shared,
+/// processes loading the same file share its pages.
+///
+/// \note The file must not be changed while it is loaded. The header
+///       and all entries are validated on load, so lookups stay within
+///       the file; the serialized values themselves are not validated.
+/// \note Values returned by \see smap_frozen_get point to the serialized
+///       values, which are aligned to 8 bytes. Values are not released.
+///
+/// \param path Path of the file to load.
+/// \return Pointer to a frozen Hashmap or NULL, if the file cannot be loaded.
+extern struct smap_frozen * smap_load(
+    char const * path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/allocator.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void * hmap_allocator_defaultalloc(
+    size_t size,
+    void * context)
+{
+    (void) context;
+    return malloc(size);
+}
+
+static void hmap_allocator_defaultfree(
+    void * ptr,
+    size_t size,
+    void * context)
+{
+    (void) size;
+    (void) context;
+    free(ptr);
+}
+
+void hmap_allocator_init(
+    struct hmap_allocator * allocator,
+    struct hmap_allocator const * user)
+{
+    if ((NULL != user) && (NULL != user->alloc))
+    {
+        *allocator = *user;
+    }
+    else
+    {
+        allocator->alloc = &hmap_allocator_defaultalloc;
+        allocator->free = &hmap_allocator_defaultfree;
+        allocator->context = NULL;
+    }
+}
+
+void * hmap_allocator_alloc(
+    struct hmap_allocator const * allocator,
+    size_t size)
+{
+    return allocator->alloc(size, allocator->context);
+}
+
+void * hmap_allocator_calloc(
+    struct hmap_allocator const * allocator,
+    size_t size)
+{
+    void * ptr = allocator->alloc(size, allocator->context);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void hmap_allocator_free(
+    struct hmap_allocator const * allocator,
+    void * ptr,
+    size_t size)
+{
+    if ((NULL != allocator->free) && (NULL != ptr))
+    {
+        allocator->free(ptr, size, allocator->context);
+    }
+}
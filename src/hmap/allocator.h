@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_ALLOCATOR_H
+#define HMAP_ALLOCATOR_H
+
+#include "hmap/hmap.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Initializes an allocator from user provided callbacks.
+///
+/// \note Missing callbacks are replaced by malloc and free, unless
+///       \arg user provides an alloc function only.
+///
+/// \param allocator Pointer to the allocator to initialize.
+/// \param user User provided allocator.
+extern void hmap_allocator_init(
+    struct hmap_allocator * allocator,
+    struct hmap_allocator const * user);
+
+/// Allocates \arg size bytes.
+extern void * hmap_allocator_alloc(
+    struct hmap_allocator const * allocator,
+    size_t size);
+
+/// Allocates \arg size bytes initialized with 0.
+extern void * hmap_allocator_calloc(
+    struct hmap_allocator const * allocator,
+    size_t size);
+
+/// Frees \arg size bytes previously allocated with \arg allocator.
+extern void hmap_allocator_free(
+    struct hmap_allocator const * allocator,
+    void * ptr,
+    size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
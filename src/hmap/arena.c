@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/arena.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+#define HMAP_ARENA_MIN_CAPACITY 256
+
+void hmap_arena_init(
+    struct hmap_arena * arena)
+{
+    arena->data = NULL;
+    arena->size = 0;
+    arena->capacity = 0;
+    arena->garbage = 0;
+}
+
+void hmap_arena_cleanup(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator)
+{
+    hmap_allocator_free(allocator, arena->data, arena->capacity);
+    hmap_arena_init(arena);
+}
+
+/// Grows the arena to hold at least \arg required bytes.
+///
+/// \return Previous memory of the arena, if it was replaced; NULL otherwise.
+///         It must be freed by the caller using \arg capacity.
+static char * hmap_arena_grow(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    size_t required,
+    size_t * capacity)
+{
+    *capacity = arena->capacity;
+    if (required <= arena->capacity)
+    {
+        return NULL;
+    }
+
+    size_t new_capacity = (0 < arena->capacity) ? arena->capacity : HMAP_ARENA_MIN_CAPACITY;
+    while (new_capacity < required)
+    {
+        new_capacity *= 2;
+    }
+
+    char * data = arena->data;
+    arena->data = hmap_allocator_alloc(allocator, new_capacity);
+    arena->capacity = new_capacity;
+    if (0 < arena->size)
+    {
+        memcpy(arena->data, data, arena->size);
+    }
+
+    return data;
+}
+
+size_t hmap_arena_append(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    char const * data,
+    size_t length)
+{
+    // data may point into the arena itself, so the previous memory is
+    // freed after data was copied
+    size_t capacity = 0;
+    char * previous = hmap_arena_grow(arena, allocator, arena->size + length + 1, &capacity);
+
+    size_t offset = arena->size;
+    arena->size += length + 1;
+    memcpy(&(arena->data[offset]), data, length);
+    arena->data[offset + length] = '\0';
+
+    hmap_allocator_free(allocator, previous, capacity);
+    return offset;
+}
+
+size_t hmap_arena_reserve(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    size_t size)
+{
+    size_t capacity = 0;
+    char * previous = hmap_arena_grow(arena, allocator, arena->size + size, &capacity);
+    hmap_allocator_free(allocator, previous, capacity);
+
+    size_t offset = arena->size;
+    arena->size += size;
+
+    return offset;
+}
+
+char * hmap_arena_reset(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    size_t capacity)
+{
+    char * data = arena->data;
+
+    arena->data = (0 < capacity) ? hmap_allocator_alloc(allocator, capacity) : NULL;
+    arena->size = 0;
+    arena->capacity = capacity;
+    arena->garbage = 0;
+
+    return data;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_ARENA_H
+#define HMAP_ARENA_H
+
+#include "hmap/hmap.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Append-only byte arena.
+///
+/// Data is addressed by its offset, so the arena can grow (and be
+/// compacted) without invalidating references held by its owner.
+/// Removed data is not reclaimed; it is only accounted as garbage.
+struct hmap_arena
+{
+    char * data;
+    size_t size;
+    size_t capacity;
+    size_t garbage;
+};
+
+/// Initializes an empty arena.
+extern void hmap_arena_init(
+    struct hmap_arena * arena);
+
+/// Releases the memory of the arena.
+extern void hmap_arena_cleanup(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator);
+
+/// Appends \arg length bytes followed by a terminating '\0'.
+///
+/// \note \arg data may point into the arena itself.
+///
+/// \return Offset of the appended data.
+extern size_t hmap_arena_append(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    char const * data,
+    size_t length);
+
+/// Reserves \arg size bytes at the end of the arena.
+///
+/// \note The contents of the reserved bytes are undefined; they are
+///       to be written by the caller.
+///
+/// \return Offset of the reserved bytes.
+extern size_t hmap_arena_reserve(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    size_t size);
+
+/// Replaces the memory of the arena by a buffer of \arg capacity bytes.
+///
+/// \note The contents are not copied; the arena is empty afterwards.
+///
+/// \return Previous memory of the arena; must be freed by the caller
+///         using \arg allocator and the previous capacity.
+extern char * hmap_arena_reset(
+    struct hmap_arena * arena,
+    struct hmap_allocator const * allocator,
+    size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/chmap.h"
+#include "hmap/table.h"
+#include "hmap/table_lockfree.h"
+#include "hmap/epoch.h"
+#include "hmap/allocator.h"
+#include <pthread.h>
+
+// Each shard is an independent table guarded by a reader-writer lock.
+// The shard is selected by the low bits of the mixed hash, so that weak
+// hash functions (e.g. the identity) still spread across all shards.
+// The mix is independent of the Fibonacci product used for home buckets
+// and fragments, so the bits used within a shard are not biased by the
+// shard.
+// Shards are padded to keep locks of neighboring shards apart in cache.
+//
+// With lock_free_reads, shards use a lock-free table instead: writers
+// are serialized by a mutex per shard, while readers only enter the
+// epoch shared by all shards.
+
+#define CHMAP_DEFAULT_SHARD_COUNT 64
+#define CHMAP_MAX_SHARD_COUNT 4096
+#define CHMAP_CACHE_LINE_SIZE 64
+
+struct chmap_entry
+{
+    void * key;
+    void * value;
+};
+
+struct chmap_shard
+{
+    union
+    {
+        struct
+        {
+            pthread_rwlock_t lock;
+            struct hmap_table table;
+        } locked;
+        struct
+        {
+            pthread_mutex_t write_lock;
+            struct hmap_lockfree_table table;
+        } lock_free;
+    } u;
+    unsigned char padding[CHMAP_CACHE_LINE_SIZE];
+};
+
+struct chmap
+{
+    size_t seed;
+    hmap_hash_fn * hash;
+    hmap_equals_fn * equals;
+    hmap_release_fn * release_key;
+    hmap_release_fn * release_value;
+
+    struct hmap_allocator allocator;
+    struct hmap_epoch * epoch;
+    size_t shard_count;
+    struct chmap_shard * shards;
+};
+
+
+static bool chmap_matchentry(
+    void const * key,
+    void const * entry,
+    void * context)
+{
+    struct chmap * map = context;
+    struct chmap_entry const * chmap_entry = entry;
+    return (0 == map->equals(key, chmap_entry->key));
+}
+
+static void chmap_releaseentry(
+    void * entry,
+    void * context)
+{
+    struct chmap * map = context;
+    struct chmap_entry * chmap_entry = entry;
+
+    if (NULL != map->release_key)
+    {
+        map->release_key(chmap_entry->key);
+    }
+
+    if (NULL != map->release_value)
+    {
+        map->release_value(chmap_entry->value);
+    }
+}
+
+static struct chmap_shard * chmap_getshard(
+    struct chmap * map,
+    size_t hash)
+{
+    size_t shard_id = (size_t) (hmap_table_mix((uint64_t) hash) & (map->shard_count - 1));
+    return &(map->shards[shard_id]);
+}
+
+void chmap_options_init(
+    struct chmap_options * options)
+{
+    hmap_options_init(&(options->map));
+    options->shard_count = CHMAP_DEFAULT_SHARD_COUNT;
+    options->lock_free_reads = false;
+}
+
+struct chmap * chmap_create(
+    size_t seed,
+    hmap_hash_fn * hash,
+    hmap_equals_fn * equals,
+    hmap_release_fn * release_key,
+    hmap_release_fn * release_value)
+{
+    struct chmap_options options;
+    chmap_options_init(&options);
+    options.map.seed = seed;
+    options.map.hash = hash;
+    options.map.equals = equals;
+    options.map.release_key = release_key;
+    options.map.release_value = release_value;
+
+    return chmap_create_ex(&options);
+}
+
+struct chmap * chmap_create_ex(
+    struct chmap_options const * options)
+{
+    struct hmap_allocator allocator;
+    hmap_allocator_init(&allocator, &(options->map.allocator));
+
+    struct chmap * map = hmap_allocator_alloc(&allocator, sizeof(struct chmap));
+    map->seed = options->map.seed;
+    map->hash = options->map.hash;
+    map->equals = options->map.equals;
+    map->release_key = options->map.release_key;
+    map->release_value = options->map.release_value;
+    map->allocator = allocator;
+
+    unsigned int shard_bits = 0;
+    while (((((size_t) 1) << shard_bits) < options->shard_count) && ((((size_t) 1) << shard_bits) < CHMAP_MAX_SHARD_COUNT))
+    {
+        shard_bits++;
+    }
+    map->shard_count = ((size_t) 1) << shard_bits;
+
+    struct hmap_options shard_options = options->map;
+    shard_options.capacity = (options->map.capacity + map->shard_count - 1) / map->shard_count;
+
+    bool has_release = (NULL != map->release_key) || (NULL != map->release_value);
+    hmap_table_release_fn * release = has_release ? &chmap_releaseentry : NULL;
+    map->epoch = NULL;
+    if (options->lock_free_reads)
+    {
+        map->epoch = hmap_allocator_alloc(&allocator, sizeof(struct hmap_epoch));
+        hmap_epoch_init(map->epoch);
+    }
+
+    map->shards = hmap_allocator_alloc(&allocator, map->shard_count * sizeof(struct chmap_shard));
+    for (size_t i = 0; i < map->shard_count; i++)
+    {
+        struct chmap_shard * shard = &(map->shards[i]);
+        if (NULL != map->epoch)
+        {
+            pthread_mutex_init(&(shard->u.lock_free.write_lock), NULL);
+            hmap_lockfree_init(&(shard->u.lock_free.table), &shard_options, sizeof(struct chmap_entry),
+                &chmap_matchentry, release, map, map->epoch);
+        }
+        else
+        {
+            pthread_rwlock_init(&(shard->u.locked.lock), NULL);
+            hmap_table_init(&(shard->u.locked.table), &shard_options, sizeof(struct chmap_entry),
+                &chmap_matchentry, release, map);
+        }
+    }
+
+    return map;
+}
+
+void chmap_release(
+    struct chmap * map)
+{
+    struct hmap_allocator allocator = map->allocator;
+
+    for (size_t i = 0; i < map->shard_count; i++)
+    {
+        struct chmap_shard * shard = &(map->shards[i]);
+        if (NULL != map->epoch)
+        {
+            hmap_lockfree_cleanup(&(shard->u.lock_free.table));
+            pthread_mutex_destroy(&(shard->u.lock_free.write_lock));
+        }
+        else
+        {
+            hmap_table_cleanup(&(shard->u.locked.table));
+            pthread_rwlock_destroy(&(shard->u.locked.lock));
+        }
+    }
+
+    hmap_allocator_free(&allocator, map->shards, map->shard_count * sizeof(struct chmap_shard));
+    hmap_allocator_free(&allocator, map->epoch, sizeof(struct hmap_epoch));
+    hmap_allocator_free(&allocator, map, sizeof(struct chmap));
+}
+
+void chmap_add(
+    struct chmap * map,
+    void * key,
+    void * value)
+{
+    size_t hash = map->hash(key, map->seed);
+    struct chmap_shard * shard = chmap_getshard(map, hash);
+
+    if (NULL != map->epoch)
+    {
+        struct chmap_entry new_entry = { key, value };
+
+        pthread_mutex_lock(&(shard->u.lock_free.write_lock));
+        hmap_lockfree_put(&(shard->u.lock_free.table), hash, key, &new_entry);
+        pthread_mutex_unlock(&(shard->u.lock_free.write_lock));
+        return;
+    }
+
+    pthread_rwlock_wrlock(&(shard->u.locked.lock));
+
+    bool created = false;
+    struct chmap_entry * entry = hmap_table_insert(&(shard->u.locked.table), hash, key, &created);
+    if (!created)
+    {
+        chmap_releaseentry(entry, map);
+    }
+
+    entry->key = key;
+    entry->value = value;
+
+    pthread_rwlock_unlock(&(shard->u.locked.lock));
+}
+
+void const * chmap_get(
+    struct chmap * map,
+    void const * key)
+{
+    size_t hash = map->hash(key, map->seed);
+    struct chmap_shard * shard = chmap_getshard(map, hash);
+
+    if (NULL != map->epoch)
+    {
+        size_t token = hmap_epoch_enter(map->epoch);
+
+        struct chmap_entry const * entry = hmap_lockfree_find(&(shard->u.lock_free.table), hash, key);
+        void const * value = (NULL != entry) ? entry->value : NULL;
+
+        hmap_epoch_leave(map->epoch, token);
+        return value;
+    }
+
+    // lookups never modify the table, not even to migrate buckets
+    pthread_rwlock_rdlock(&(shard->u.locked.lock));
+
+    struct chmap_entry * entry = hmap_table_find(&(shard->u.locked.table), hash, key);
+    void const * value = (NULL != entry) ? entry->value : NULL;
+
+    pthread_rwlock_unlock(&(shard->u.locked.lock));
+
+    return value;
+}
+
+bool chmap_contains(
+    struct chmap * map,
+    void const * key)
+{
+    return (NULL != chmap_get(map, key));
+}
+
+void chmap_remove(
+    struct chmap * map,
+    void const * key)
+{
+    size_t hash = map->hash(key, map->seed);
+    struct chmap_shard * shard = chmap_getshard(map, hash);
+
+    if (NULL != map->epoch)
+    {
+        pthread_mutex_lock(&(shard->u.lock_free.write_lock));
+        hmap_lockfree_remove(&(shard->u.lock_free.table), hash, key);
+        pthread_mutex_unlock(&(shard->u.lock_free.write_lock));
+        return;
+    }
+
+    pthread_rwlock_wrlock(&(shard->u.locked.lock));
+    hmap_table_remove(&(shard->u.locked.table), hash, key);
+    pthread_rwlock_unlock(&(shard->u.locked.lock));
+}
@@ -1,13 +1,12 @@
 #include "hmap/djb2.h"
 
-size_t smap_djb2(char const * key, size_t seed)
+size_t smap_djb2(char const * key, size_t length, size_t seed)
 {
     size_t hash = 5381 + seed;
 
-    while ('\0' != key[0])
+    for (size_t i = 0; i < length; i++)
     {
-        hash = (hash * 33) ^ key[0];
-        key++;
+        hash = (hash * 33) ^ key[i];
     }
 
     return hash;
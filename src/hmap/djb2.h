@@ -19,9 +19,10 @@ extern "C"
 /// The modification is made to support a seed for hash randomization.
 ///
 /// \param key Key to hash.
+/// \param length Length of \arg key in bytes.
 /// \param seed Seed for hash randomization.
 /// \return Hash value of \arg key.
-extern size_t smap_djb2(char const * key, size_t seed);
+extern size_t smap_djb2(char const * key, size_t length, size_t seed);
 
 #ifdef __cplusplus
 }
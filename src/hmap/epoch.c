@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/epoch.h"
+#include <stdint.h>
+
+// All accesses use sequentially consistent atomics: a reader must
+// either be visible to a writer advancing the epoch or see the
+// advanced epoch itself (and retry).
+
+void hmap_epoch_init(
+    struct hmap_epoch * epoch)
+{
+    epoch->global = 0;
+    for (size_t i = 0; i < HMAP_EPOCH_STRIPES; i++)
+    {
+        epoch->stripes[i].active[0] = 0;
+        epoch->stripes[i].active[1] = 0;
+    }
+}
+
+size_t hmap_epoch_enter(
+    struct hmap_epoch * epoch)
+{
+    // stacks of different threads are far apart, so the stack
+    // address spreads threads across stripes without registration
+    unsigned char marker;
+    uintptr_t address = (uintptr_t) &marker;
+    size_t stripe = (size_t) ((address >> 16) ^ (address >> 24)) % HMAP_EPOCH_STRIPES;
+
+    while (true)
+    {
+        size_t current = __atomic_load_n(&(epoch->global), __ATOMIC_SEQ_CST);
+        size_t parity = current & 1;
+        __atomic_fetch_add(&(epoch->stripes[stripe].active[parity]), 1, __ATOMIC_SEQ_CST);
+
+        if (current == __atomic_load_n(&(epoch->global), __ATOMIC_SEQ_CST))
+        {
+            return (stripe * 2) + parity;
+        }
+
+        // epoch advanced in between; the writer may have missed this reader
+        __atomic_fetch_sub(&(epoch->stripes[stripe].active[parity]), 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void hmap_epoch_leave(
+    struct hmap_epoch * epoch,
+    size_t token)
+{
+    __atomic_fetch_sub(&(epoch->stripes[token / 2].active[token & 1]), 1, __ATOMIC_SEQ_CST);
+}
+
+size_t hmap_epoch_current(
+    struct hmap_epoch * epoch)
+{
+    return __atomic_load_n(&(epoch->global), __ATOMIC_SEQ_CST);
+}
+
+size_t hmap_epoch_advance(
+    struct hmap_epoch * epoch)
+{
+    size_t current = __atomic_load_n(&(epoch->global), __ATOMIC_SEQ_CST);
+
+    // readers of the previous epoch share their counters with the next epoch
+    size_t parity = (current + 1) & 1;
+    for (size_t i = 0; i < HMAP_EPOCH_STRIPES; i++)
+    {
+        if (0 != __atomic_load_n(&(epoch->stripes[i].active[parity]), __ATOMIC_SEQ_CST))
+        {
+            return current;
+        }
+    }
+
+    size_t next = current + 1;
+    if (__atomic_compare_exchange_n(&(epoch->global), &current, next, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+        return next;
+    }
+
+    // another writer advanced the epoch
+    return current;
+}
+
+bool hmap_epoch_isreclaimable(
+    size_t current,
+    size_t tag)
+{
+    return ((tag + 2) <= current);
+}
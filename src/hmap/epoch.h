@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_EPOCH_H
+#define HMAP_EPOCH_H
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HMAP_EPOCH_STRIPES 64
+#define HMAP_EPOCH_CACHE_LINE_SIZE 64
+
+/// Number of readers active in even and odd epochs.
+///
+/// Readers are spread across stripes to avoid contention on a single
+/// counter; each stripe occupies its own cache line.
+struct hmap_epoch_stripe
+{
+    size_t active[2];
+    unsigned char padding[HMAP_EPOCH_CACHE_LINE_SIZE - (2 * sizeof(size_t))];
+};
+
+/// Epoch based reclamation.
+///
+/// Readers enter the current epoch before they access shared memory
+/// and leave it afterwards. Writers retire unlinked memory tagged with
+/// the current epoch. The epoch is only advanced when no reader is left
+/// in the previous epoch, so memory retired in epoch E is no longer
+/// reachable by any reader once the epoch reached E + 2.
+struct hmap_epoch
+{
+    size_t global;
+    unsigned char padding[HMAP_EPOCH_CACHE_LINE_SIZE - sizeof(size_t)];
+    struct hmap_epoch_stripe stripes[HMAP_EPOCH_STRIPES];
+};
+
+/// Initializes the epoch.
+///
+/// \param epoch Pointer to the epoch.
+extern void hmap_epoch_init(
+    struct hmap_epoch * epoch);
+
+/// Enters the current epoch as reader.
+///
+/// \param epoch Pointer to the epoch.
+/// \return Token to pass to \see hmap_epoch_leave.
+extern size_t hmap_epoch_enter(
+    struct hmap_epoch * epoch);
+
+/// Leaves the epoch entered by \see hmap_epoch_enter.
+///
+/// \param epoch Pointer to the epoch.
+/// \param token Token returned by \see hmap_epoch_enter.
+extern void hmap_epoch_leave(
+    struct hmap_epoch * epoch,
+    size_t token);
+
+/// Returns the current epoch used to tag retired memory.
+///
+/// \note Must be called after the memory is unlinked.
+///
+/// \param epoch Pointer to the epoch.
+extern size_t hmap_epoch_current(
+    struct hmap_epoch * epoch);
+
+/// Advances the epoch, if no reader is left in the previous epoch.
+///
+/// \param epoch Pointer to the epoch.
+/// \return Current epoch.
+extern size_t hmap_epoch_advance(
+    struct hmap_epoch * epoch);
+
+/// Returns true, if memory retired in epoch \arg tag can be freed.
+///
+/// \param current Current epoch as returned by \see hmap_epoch_advance.
+/// \param tag Epoch the memory was retired in.
+extern bool hmap_epoch_isreclaimable(
+    size_t current,
+    size_t tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,20 +2,19 @@
 // Copyright (c) 2022 Falk Werner
 
 #include "hmap/hmap.h"
-#include <stdlib.h>
+#include "hmap/table.h"
+#include "hmap/table_perfect.h"
+#include "hmap/allocator.h"
+#include <string.h>
 
-#define HMAP_INITIAL_BUCKETS 16
+// Values are either stored as pointer or, if value_size is set,
+// inline starting at the address of the value field; the entry is
+// extended to hold value_size bytes.
 
 struct hmap_entry
 {
     void * key;
     void * value;
-    struct hmap_entry * next;
-};
-
-struct hmap_bucket
-{
-    struct hmap_entry head;
 };
 
 struct hmap
@@ -24,65 +23,147 @@ struct hmap
     hmap_hash_fn * hash;
     hmap_equals_fn * equals;
     hmap_release_fn * release_key;
-    hmap_release_fn * releae_value;
+    hmap_release_fn * release_value;
+    size_t value_size;
 
-    size_t entry_count;
-    size_t bucket_count;
-    struct hmap_bucket * buckets;
+    struct hmap_table table;
 };
 
+struct hmap_frozen
+{
+    struct hmap map;    // settings of the frozen map; its table is already released
+    struct hmap_perfect_table table;
+};
 
-static struct hmap_bucket * hmap_getbucket(
-    struct hmap * map,
-    void const * key)
+static void * hmap_loadvalue(
+    struct hmap const * map,
+    void * const * value)
 {
-    size_t hash = map->hash(key, map->seed);
-    size_t bucket_id = hash % map->bucket_count;
-    return &(map->buckets[bucket_id]);
+    return (0 < map->value_size) ? ((void *) value) : *value;
+}
+
+static void hmap_storevalue(
+    struct hmap const * map,
+    void * * value,
+    void * new_value)
+{
+    if (0 == map->value_size)
+    {
+        *value = new_value;
+    }
+    else if (NULL != new_value)
+    {
+        memcpy(value, new_value, map->value_size);
+    }
+    else
+    {
+        memset(value, 0, map->value_size);
+    }
 }
 
 
-static size_t hmap_getthreshold(size_t bucket_count)
+static bool hmap_matchentry(
+    void const * key,
+    void const * entry,
+    void * context)
 {
-    return (7 * bucket_count) / 10;
+    struct hmap * map = context;
+    struct hmap_entry const * hmap_entry = entry;
+    return (0 == map->equals(key, hmap_entry->key));
 }
 
-static void hmap_rehash(struct hmap * map)
+static size_t hmap_hashentry(
+    void const * entry,
+    void * context)
 {
-    // create new buckets
-    size_t new_bucket_count = 2 * map->bucket_count;
-    struct hmap_bucket * new_buckets = malloc(new_bucket_count * sizeof(struct hmap_bucket));
-    for(size_t i = 0; i < new_bucket_count; i++)
+    struct hmap * map = context;
+    struct hmap_entry const * hmap_entry = entry;
+    return map->hash(hmap_entry->key, map->seed);
+}
+
+static void hmap_releaseentry(
+    void * entry,
+    void * context)
+{
+    struct hmap * map = context;
+    struct hmap_entry * hmap_entry = entry;
+
+    if (NULL != map->release_key)
     {
-        struct hmap_bucket * new_bucket = &(new_buckets[i]);
-        new_bucket->head.next = &(new_bucket->head);
+        map->release_key(hmap_entry->key);
     }
 
-    // put entries into new buckets
-    for (size_t i = 0; i < map->bucket_count; i++)    
+    if (NULL != map->release_value)
     {
-        struct hmap_bucket * old_bucket = &(map->buckets[i]);
-        struct hmap_entry * entry = old_bucket->head.next;
-        while (&(old_bucket->head) != entry)
-        {
-            struct hmap_entry * next = entry->next;
+        map->release_value(hmap_loadvalue(map, &(hmap_entry->value)));
+    }
+}
 
-            size_t hash = map->hash(entry->key, map->seed);
-            size_t new_bucket_id = hash % new_bucket_count;
-            struct hmap_bucket * new_bucket = &(new_buckets[new_bucket_id]);
+/// Items of \see hmap_build_bulk.
+struct hmap_bulk_items
+{
+    struct hmap * map;
+    void * const * keys;
+    void * const * values;
+};
 
-            entry->next = new_bucket->head.next;
-            new_bucket->head.next = entry;
+static size_t hmap_bulkhash(
+    size_t index,
+    void * context)
+{
+    struct hmap_bulk_items const * items = context;
+    return items->map->hash(items->keys[index], items->map->seed);
+}
 
-            entry = next;
-        }
-    }
+static bool hmap_bulkmatch(
+    size_t index,
+    void const * entry,
+    void * context)
+{
+    struct hmap_bulk_items const * items = context;
+    return hmap_matchentry(items->keys[index], entry, items->map);
+}
 
-    // update map to use new buckets
-    free(map->buckets);
-    map->bucket_count = new_bucket_count;
-    map->buckets = new_buckets;
+static void hmap_bulkstore(
+    size_t index,
+    void * entry,
+    void * context)
+{
+    struct hmap_bulk_items const * items = context;
+    struct hmap_entry * hmap_entry = entry;
 
+    hmap_entry->key = items->keys[index];
+    hmap_storevalue(items->map, &(hmap_entry->value), (NULL != items->values) ? items->values[index] : NULL);
+}
+
+static void hmap_bulkreplace(
+    size_t index,
+    void * entry,
+    void * context)
+{
+    struct hmap_bulk_items const * items = context;
+
+    hmap_releaseentry(entry, items->map);
+    hmap_bulkstore(index, entry, context);
+}
+
+void hmap_options_init(
+    struct hmap_options * options)
+{
+    options->seed = 0;
+    options->hash = NULL;
+    options->equals = NULL;
+    options->release_key = NULL;
+    options->release_value = NULL;
+    options->value_size = 0;
+    options->engine = HMAP_ENGINE_CHAINED;
+    options->incremental_rehash = false;
+    options->rehash_threads = 1;
+    options->capacity = 0;
+    options->max_load_factor = 0.7;
+    options->allocator.alloc = NULL;
+    options->allocator.free = NULL;
+    options->allocator.context = NULL;
 }
 
 struct hmap * hmap_create(
@@ -93,45 +174,68 @@ struct hmap * hmap_create(
     hmap_release_fn * release_value
 )
 {
-    struct hmap * map = malloc(sizeof(struct hmap));
-    map->seed = seed;
-    map->hash = hash;
-    map->equals = equals;
-    map->release_key = release_key;
-    map->releae_value = release_value;
-    map->entry_count = 0;
-
-    map->bucket_count = HMAP_INITIAL_BUCKETS;
-    map->buckets = malloc(map->bucket_count * sizeof(struct hmap_bucket));
-    for (size_t i = 0; i < HMAP_INITIAL_BUCKETS; i++)
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.seed = seed;
+    options.hash = hash;
+    options.equals = equals;
+    options.release_key = release_key;
+    options.release_value = release_value;
+
+    return hmap_create_ex(&options);
+}
+
+struct hmap * hmap_create_ex(
+    struct hmap_options const * options)
+{
+    struct hmap_allocator allocator;
+    hmap_allocator_init(&allocator, &(options->allocator));
+
+    struct hmap * map = hmap_allocator_alloc(&allocator, sizeof(struct hmap));
+    map->seed = options->seed;
+    map->hash = options->hash;
+    map->equals = options->equals;
+    map->release_key = options->release_key;
+    map->release_value = options->release_value;
+    map->value_size = options->value_size;
+
+    size_t entry_size = sizeof(struct hmap_entry);
+    if (map->value_size > sizeof(void *))
     {
-        map->buckets[i].head.next = &(map->buckets[i].head);
+        entry_size = offsetof(struct hmap_entry, value) + map->value_size;
     }
 
+    bool has_release = (NULL != map->release_key) || (NULL != map->release_value);
+    hmap_table_init(&(map->table), options, entry_size,
+        &hmap_matchentry, has_release ? &hmap_releaseentry : NULL, map);
+
     return map;
 }
 
-void hmap_release(
-    struct hmap * map)
+struct hmap * hmap_build_bulk(
+    struct hmap_options const * options,
+    void * const * keys,
+    void * const * values,
+    size_t count,
+    size_t thread_count)
 {
-    for (size_t i = 0; i < map->bucket_count; i++)
-    {
-        struct hmap_bucket * bucket = &(map->buckets[i]);
-        struct hmap_entry * entry = bucket->head.next;
+    struct hmap * map = hmap_create_ex(options);
 
-        while (&(bucket->head) != entry)
-        {
-            struct hmap_entry * next = entry->next;
-            map->release_key(entry->key);
-            map->releae_value(entry->value);
-            free(entry);
+    struct hmap_bulk_items items = { map, keys, values };
+    struct hmap_table_bulk bulk = { count, &hmap_bulkhash, &hmap_bulkmatch,
+        &hmap_bulkstore, &hmap_bulkreplace, &items };
+    hmap_table_build(&(map->table), &bulk, thread_count);
 
-            entry = next;
-        }
-    }
+    return map;
+}
 
-    free(map->buckets);
-    free(map);
+void hmap_release(
+    struct hmap * map)
+{
+    struct hmap_allocator allocator = map->table.allocator;
+
+    hmap_table_cleanup(&(map->table));
+    hmap_allocator_free(&allocator, map, sizeof(struct hmap));
 }
 
 void hmap_add(
@@ -139,63 +243,101 @@ void hmap_add(
     void * key,
     void * value)
 {
-    if (map->entry_count > hmap_getthreshold(map->bucket_count))
+    size_t hash = map->hash(key, map->seed);
+
+    bool created = false;
+    struct hmap_entry * entry = hmap_table_insert(&(map->table), hash, key, &created);
+    if (!created)
     {
-        hmap_rehash(map);
+        hmap_releaseentry(entry, map);
     }
 
-    struct hmap_bucket * bucket = hmap_getbucket(map, key);
+    entry->key = key;
+    hmap_storevalue(map, &(entry->value), value);
+}
+
+void ** hmap_get_or_insert(
+    struct hmap * map,
+    void * key,
+    bool * created)
+{
+    size_t hash = map->hash(key, map->seed);
 
-    // try to find previously added key
-    bool found = false;
-    struct hmap_entry * entry = bucket->head.next;
-    while (&(bucket->head) != entry)
+    bool is_new = false;
+    struct hmap_entry * entry = hmap_table_insert(&(map->table), hash, key, &is_new);
+    if (is_new)
     {
-        if (0 == map->equals(key, entry->key))
-        {
-            map->release_key(entry->key);
-            map->releae_value(entry->value);
-            entry->key = key;
-            entry->value = value;
-            found = true;
-            break;
-        }
-        entry = entry->next;
+        entry->key = key;
+        hmap_storevalue(map, &(entry->value), NULL);
     }
 
-    if (!found)
+    if (NULL != created)
     {
-        struct hmap_entry * entry = malloc(sizeof(struct hmap_entry));
-        entry->key = key;
-        entry->value = value;
-        entry->next = bucket->head.next;
+        *created = is_new;
+    }
 
-        bucket->head.next = entry;
-        map->entry_count++;
+    return &(entry->value);
+}
+
+void ** hmap_emplace(
+    struct hmap * map,
+    void * key,
+    void * value,
+    bool * created)
+{
+    bool is_new = false;
+    void ** slot = hmap_get_or_insert(map, key, &is_new);
+    if (is_new)
+    {
+        hmap_storevalue(map, slot, value);
     }
 
+    if (NULL != created)
+    {
+        *created = is_new;
+    }
+
+    return slot;
 }
 
 void const * hmap_get(
     struct hmap * map,
     void const * key)
 {
-    void * value = NULL;
+    size_t hash = map->hash(key, map->seed);
+    struct hmap_entry * entry = hmap_table_find(&(map->table), hash, key);
+
+    return (NULL != entry) ? hmap_loadvalue(map, &(entry->value)) : NULL;
+}
 
-    struct hmap_bucket * bucket = hmap_getbucket(map, key);
+void hmap_get_batch(
+    struct hmap * map,
+    void const * const * keys,
+    size_t count,
+    void const * * values)
+{
+    size_t hashes[HMAP_TABLE_BATCH_SIZE];
 
-    struct hmap_entry * entry = bucket->head.next;
-    while (&(bucket->head) != entry)
+    for (size_t offset = 0; offset < count; offset += HMAP_TABLE_BATCH_SIZE)
     {
-        if (0 == map->equals(key, entry->key))
+        size_t batch_size = count - offset;
+        if (batch_size > HMAP_TABLE_BATCH_SIZE)
         {
-            value = entry->value;
-            break;
+            batch_size = HMAP_TABLE_BATCH_SIZE;
         }
-        entry = entry->next;
-    }
 
-    return value;
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            hashes[i] = map->hash(keys[offset + i], map->seed);
+            hmap_table_prefetch(&(map->table), hashes[i]);
+        }
+
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            struct hmap_entry * entry = hmap_table_find(&(map->table), hashes[i], keys[offset + i]);
+            values[offset + i] = (NULL != entry) ? hmap_loadvalue(map, &(entry->value)) : NULL;
+        }
+    }
 }
 
 bool hmap_contains(
@@ -209,78 +351,151 @@ void hmap_remove(
     struct hmap * map,
     void const * key)
 {
-    struct hmap_bucket * bucket = hmap_getbucket(map, key);
+    size_t hash = map->hash(key, map->seed);
+    hmap_table_remove(&(map->table), hash, key);
+}
 
-    struct hmap_entry * prev = &(bucket->head);
-    struct hmap_entry * entry = bucket->head.next;
-    while (&(bucket->head) != entry)
+void hmap_retain(
+    struct hmap * map,
+    hmap_predicate_fn * predicate,
+    void * context)
+{
+    size_t bucket_id = 0;
+    size_t start = 0;
+    void * entry = NULL;
+    while (hmap_table_next(&(map->table), &bucket_id, &start, &entry))
     {
-        if (0 == map->equals(key, entry->key))
+        struct hmap_entry * hmap_entry = entry;
+        if (!predicate(hmap_entry->key, hmap_loadvalue(map, &(hmap_entry->value)), context))
         {
-            map->release_key(entry->key);
-            map->releae_value(entry->value);
-            prev->next = entry->next;
-            free(entry);
-
-            map->entry_count--;
-            break;
+            hmap_table_removeat(&(map->table), &bucket_id, &start, &entry);
         }
-        prev = prev->next;
-        entry = entry->next;
     }
 }
 
+void hmap_reserve(
+    struct hmap * map,
+    size_t capacity)
+{
+    hmap_table_reserve(&(map->table), capacity);
+}
+
+void hmap_shrink_to_fit(
+    struct hmap * map)
+{
+    hmap_table_shrink(&(map->table));
+}
+
+void hmap_get_stats(
+    struct hmap * map,
+    struct hmap_stats * stats)
+{
+    hmap_table_getstats(&(map->table), stats);
+    stats->bytes_allocated += sizeof(struct hmap);
+}
+
 void hmap_iter_init(
     struct hmap_iter * iter,
     struct hmap * map)
 {
-    size_t last_bucket_id = map->bucket_count - 1;
-
     iter->map = map;
-    iter->bucket_id = -1;
+    iter->bucket_id = 0;
+    iter->start = 0;
+    iter->position = NULL;
     iter->entry = NULL;
-    iter->end = &(map->buckets[last_bucket_id].head);
 }
 
 bool hmap_iter_next(
         struct hmap_iter * iter)
 {
-    if (NULL == iter->entry)
+    bool has_next = hmap_table_next(&(iter->map->table), &(iter->bucket_id), &(iter->start), &(iter->position));
+    iter->entry = iter->position;
+
+    return has_next;
+}
+
+void const * hmap_iter_value(
+    struct hmap_iter * iter)
+{
+    void const * value = (NULL != iter->entry) ? hmap_loadvalue(iter->map, &(iter->entry->value)) : NULL;
+    return value;
+}
+
+void const * hmap_iter_key(
+    struct hmap_iter * iter)
+{
+    void const * key = (NULL != iter->entry) ? iter->entry->key : NULL;
+    return key;
+}
+
+void hmap_iter_remove(
+    struct hmap_iter * iter)
+{
+    if (NULL != iter->entry)
     {
-        iter->bucket_id = 0;
-        iter->entry = iter->map->buckets[0].head.next;
+        hmap_table_removeat(&(iter->map->table), &(iter->bucket_id), &(iter->start), &(iter->position));
+        iter->entry = NULL;
     }
-    else
-    {
-        struct hmap_entry * bucket_end = &(iter->map->buckets[iter->bucket_id].head);
+}
 
-        if (bucket_end != iter->entry)
-        {
-            iter->entry = iter->entry->next;
-        }
+struct hmap_frozen * hmap_freeze(
+    struct hmap * map)
+{
+    struct hmap_allocator allocator = map->table.allocator;
+    struct hmap_frozen * frozen = hmap_allocator_alloc(&allocator, sizeof(struct hmap_frozen));
+    frozen->map = *map;
+
+    // keys sharing a hash value are separated by re-hashing with another seed
+    bool success = hmap_perfect_init(&(frozen->table), &(map->table), NULL, &(frozen->map));
+    for (size_t attempt = 1; (!success) && (attempt <= HMAP_PERFECT_RESEEDS); attempt++)
+    {
+        frozen->map.seed = hmap_perfect_reseed(map->seed, attempt);
+        success = hmap_perfect_init(&(frozen->table), &(map->table), &hmap_hashentry, &(frozen->map));
     }
 
-    struct hmap_entry * bucket_end = &(iter->map->buckets[iter->bucket_id].head);
-    while ((iter->end != iter->entry) && (iter->entry == bucket_end))
+    if (!success)
     {
-        iter->bucket_id++;
-        iter->entry = iter->map->buckets[iter->bucket_id].head.next;
-        bucket_end = &(iter->map->buckets[iter->bucket_id].head);        
+        hmap_allocator_free(&allocator, frozen, sizeof(struct hmap_frozen));
+        return NULL;
     }
 
-    return (iter->end != iter->entry);
+    // entries are owned by the frozen map now; its settings keep the seed used
+    map->table.release = NULL;
+    hmap_table_cleanup(&(map->table));
+    frozen->map.table = map->table;
+    hmap_allocator_free(&allocator, map, sizeof(struct hmap));
+
+    return frozen;
 }
 
-void const * hmap_iter_value(
-    struct hmap_iter * iter)
+void hmap_frozen_release(
+    struct hmap_frozen * frozen)
 {
-    void const * value = ((NULL != iter->entry) && (iter->end != iter->entry)) ? iter->entry->value : NULL;
-    return value;
+    struct hmap_allocator allocator = frozen->table.allocator;
+
+    hmap_perfect_cleanup(&(frozen->table));
+    hmap_allocator_free(&allocator, frozen, sizeof(struct hmap_frozen));
 }
 
-void const * hmap_iter_key(
-    struct hmap_iter * iter)
+size_t hmap_frozen_size(
+    struct hmap_frozen const * frozen)
 {
-    void const * key = ((NULL != iter->entry) && (iter->end != iter->entry)) ? iter->entry->key : NULL;
-    return key;
+    return frozen->table.entry_count;
+}
+
+void const * hmap_frozen_get(
+    struct hmap_frozen const * frozen,
+    void const * key)
+{
+    size_t hash = frozen->map.hash(key, frozen->map.seed);
+    struct hmap_entry * entry = hmap_perfect_find(&(frozen->table), hash, key);
+
+    return (NULL != entry) ? hmap_loadvalue(&(frozen->map), &(entry->value)) : NULL;
+}
+
+bool hmap_frozen_contains(
+    struct hmap_frozen const * frozen,
+    void const * key)
+{
+    return (NULL != hmap_frozen_get(frozen, key));
 }
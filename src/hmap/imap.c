@@ -0,0 +1,367 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/imap.h"
+#include "hmap/hmap.h"
+#include "hmap/table.h"
+#include "hmap/detail/probe.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+// Open addressing with linear probing, specialized for integer keys.
+//
+// Keys and values are stored inline in a contiguous array of slots.
+// The layout matches the open addressing engine of hmap and shares its
+// probing primitives (see hmap/detail/probe.h), but keys are compared
+// directly and hashes are recomputed by the built-in mixer instead of
+// being stored.
+
+#define IMAP_INITIAL_SLOTS 16
+#define IMAP_DEFAULT_LOAD_FACTOR 0.7
+
+struct imap_slot
+{
+    uint64_t key;
+    void * value;
+};
+
+struct imap
+{
+    uint64_t seed;
+    imap_release_fn * release_value;
+    double max_load_factor;
+    struct hmap_allocator allocator;
+
+    size_t entry_count;
+    size_t slot_count;
+    size_t threshold;
+    struct imap_slot * slots;
+    unsigned char * ctrl;
+};
+
+/// Mixes all bits of \arg key, see \see hmap_table_mix.
+static inline size_t imap_hash(
+    struct imap const * map,
+    uint64_t key)
+{
+    return (size_t) hmap_table_mix(key ^ map->seed);
+}
+
+static size_t imap_getthreshold(
+    struct imap const * map,
+    size_t slot_count)
+{
+    size_t threshold = (size_t) (map->max_load_factor * (double) slot_count);
+
+    // at least one empty slot is needed to terminate probing
+    return (threshold > (slot_count - 2)) ? (slot_count - 2) : threshold;
+}
+
+static size_t imap_getslotcount(
+    struct imap const * map,
+    size_t capacity)
+{
+    size_t slot_count = IMAP_INITIAL_SLOTS;
+    while ((imap_getthreshold(map, slot_count) < capacity) && (slot_count <= (((size_t) -1) / (4 * sizeof(struct imap_slot)))))
+    {
+        slot_count *= 2;
+    }
+
+    return slot_count;
+}
+
+static void imap_createslots(
+    struct imap * map,
+    size_t slot_count)
+{
+    map->slot_count = slot_count;
+    map->threshold = imap_getthreshold(map, slot_count);
+    map->slots = hmap_allocator_alloc(&(map->allocator), slot_count * sizeof(struct imap_slot));
+    map->ctrl = hmap_allocator_alloc(&(map->allocator), slot_count + HMAP_GROUP_WIDTH);
+    memset(map->ctrl, HMAP_CTRL_EMPTY, slot_count + HMAP_GROUP_WIDTH);
+}
+
+static void imap_freeslots(
+    struct imap * map,
+    struct imap_slot * slots,
+    unsigned char * ctrl,
+    size_t slot_count)
+{
+    hmap_allocator_free(&(map->allocator), slots, slot_count * sizeof(struct imap_slot));
+    hmap_allocator_free(&(map->allocator), ctrl, slot_count + HMAP_GROUP_WIDTH);
+}
+
+/// Probes for \arg key starting at its home slot.
+///
+/// \return Id of the slot storing \arg key or the id of the first
+///         empty slot of the probe sequence, if \arg key is not found.
+static size_t imap_probe(
+    struct imap const * map,
+    uint64_t key,
+    size_t hash,
+    bool * found)
+{
+    struct hmap_probe probe;
+    hmap_probe_start(&probe, map->ctrl, map->slot_count, hash);
+
+    size_t id = 0;
+    while (hmap_probe_next(&probe, map->ctrl, &id))
+    {
+        if (key == map->slots[id].key)
+        {
+            *found = true;
+            return id;
+        }
+    }
+
+    *found = false;
+    return id;
+}
+
+static void imap_rehash(
+    struct imap * map,
+    size_t new_slot_count)
+{
+    struct imap_slot * old_slots = map->slots;
+    unsigned char * old_ctrl = map->ctrl;
+    size_t old_slot_count = map->slot_count;
+
+    imap_createslots(map, new_slot_count);
+
+    for (size_t i = 0; i < old_slot_count; i++)
+    {
+        if (HMAP_CTRL_EMPTY != old_ctrl[i])
+        {
+            size_t hash = imap_hash(map, old_slots[i].key);
+            size_t id = hmap_probe_findempty(map->ctrl, new_slot_count, hmap_table_gethome(hash, new_slot_count));
+
+            map->slots[id] = old_slots[i];
+            hmap_probe_setctrl(map->ctrl, new_slot_count, id, hmap_table_getfragment(hash, new_slot_count));
+        }
+    }
+
+    imap_freeslots(map, old_slots, old_ctrl, old_slot_count);
+}
+
+void imap_options_init(
+    struct imap_options * options)
+{
+    options->seed = 0;
+    options->release_value = NULL;
+    options->capacity = 0;
+    options->max_load_factor = IMAP_DEFAULT_LOAD_FACTOR;
+    options->allocator.alloc = NULL;
+    options->allocator.free = NULL;
+    options->allocator.context = NULL;
+}
+
+struct imap * imap_create(
+    size_t seed,
+    imap_release_fn * release_value)
+{
+    struct imap_options options;
+    imap_options_init(&options);
+    options.seed = seed;
+    options.release_value = release_value;
+
+    return imap_create_ex(&options);
+}
+
+struct imap * imap_create_ex(
+    struct imap_options const * options)
+{
+    struct hmap_allocator user_allocator;
+    user_allocator.alloc = options->allocator.alloc;
+    user_allocator.free = options->allocator.free;
+    user_allocator.context = options->allocator.context;
+
+    struct hmap_allocator allocator;
+    hmap_allocator_init(&allocator, &user_allocator);
+
+    struct imap * map = hmap_allocator_alloc(&allocator, sizeof(struct imap));
+    map->seed = options->seed;
+    map->release_value = options->release_value;
+    map->max_load_factor = (0.0 < options->max_load_factor) ? options->max_load_factor : IMAP_DEFAULT_LOAD_FACTOR;
+    map->allocator = allocator;
+    map->entry_count = 0;
+    imap_createslots(map, imap_getslotcount(map, options->capacity));
+
+    return map;
+}
+
+void imap_release(
+    struct imap * map)
+{
+    struct hmap_allocator allocator = map->allocator;
+
+    if (NULL != map->release_value)
+    {
+        for (size_t i = 0; i < map->slot_count; i++)
+        {
+            if (HMAP_CTRL_EMPTY != map->ctrl[i])
+            {
+                map->release_value(map->slots[i].value);
+            }
+        }
+    }
+
+    imap_freeslots(map, map->slots, map->ctrl, map->slot_count);
+    hmap_allocator_free(&allocator, map, sizeof(struct imap));
+}
+
+void imap_add(
+    struct imap * map,
+    uint64_t key,
+    void * value)
+{
+    bool created = false;
+    void ** slot = imap_get_or_insert(map, key, &created);
+    if ((!created) && (NULL != map->release_value))
+    {
+        map->release_value(*slot);
+    }
+
+    *slot = value;
+}
+
+void ** imap_get_or_insert(
+    struct imap * map,
+    uint64_t key,
+    bool * created)
+{
+    if (map->entry_count > map->threshold)
+    {
+        imap_rehash(map, 2 * map->slot_count);
+    }
+
+    size_t hash = imap_hash(map, key);
+    bool found = false;
+    size_t id = imap_probe(map, key, hash, &found);
+
+    if (!found)
+    {
+        map->slots[id].key = key;
+        map->slots[id].value = NULL;
+        hmap_probe_setctrl(map->ctrl, map->slot_count, id, hmap_table_getfragment(hash, map->slot_count));
+        map->entry_count++;
+    }
+
+    if (NULL != created)
+    {
+        *created = !found;
+    }
+
+    return &(map->slots[id].value);
+}
+
+void const * imap_get(
+    struct imap * map,
+    uint64_t key)
+{
+    bool found = false;
+    size_t id = imap_probe(map, key, imap_hash(map, key), &found);
+
+    return (found) ? map->slots[id].value : NULL;
+}
+
+bool imap_contains(
+    struct imap * map,
+    uint64_t key)
+{
+    bool found = false;
+    imap_probe(map, key, imap_hash(map, key), &found);
+
+    return found;
+}
+
+void imap_remove(
+    struct imap * map,
+    uint64_t key)
+{
+    bool found = false;
+    size_t hole = imap_probe(map, key, imap_hash(map, key), &found);
+
+    if (found)
+    {
+        size_t mask = map->slot_count - 1;
+
+        if (NULL != map->release_value)
+        {
+            map->release_value(map->slots[hole].value);
+        }
+        hmap_probe_setctrl(map->ctrl, map->slot_count, hole, HMAP_CTRL_EMPTY);
+        map->entry_count--;
+
+        // shift following entries back
+        size_t id = (hole + 1) & mask;
+        while (HMAP_CTRL_EMPTY != map->ctrl[id])
+        {
+            size_t home = hmap_table_gethome(imap_hash(map, map->slots[id].key), map->slot_count);
+            if (hmap_probe_canshift(id, home, hole, mask))
+            {
+                map->slots[hole] = map->slots[id];
+                hmap_probe_setctrl(map->ctrl, map->slot_count, hole, map->ctrl[id]);
+                hmap_probe_setctrl(map->ctrl, map->slot_count, id, HMAP_CTRL_EMPTY);
+                hole = id;
+            }
+            id = (id + 1) & mask;
+        }
+    }
+}
+
+void imap_reserve(
+    struct imap * map,
+    size_t capacity)
+{
+    size_t slot_count = imap_getslotcount(map, capacity);
+    if (slot_count > map->slot_count)
+    {
+        imap_rehash(map, slot_count);
+    }
+}
+
+void imap_shrink_to_fit(
+    struct imap * map)
+{
+    size_t slot_count = imap_getslotcount(map, map->entry_count);
+    if (slot_count < map->slot_count)
+    {
+        imap_rehash(map, slot_count);
+    }
+}
+
+void imap_iter_init(
+    struct imap_iter * iter,
+    struct imap * map)
+{
+    iter->map = map;
+    iter->slot_id = 0;
+    iter->key = 0;
+    iter->value = NULL;
+}
+
+bool imap_iter_next(
+    struct imap_iter * iter)
+{
+    struct imap const * map = iter->map;
+    size_t id = hmap_probe_nextused(map->ctrl, map->slot_count, 0, iter->slot_id);
+
+    bool has_next = (id < map->slot_count);
+    iter->slot_id = (has_next) ? (id + 1) : map->slot_count;
+    iter->key = (has_next) ? map->slots[id].key : 0;
+    iter->value = (has_next) ? map->slots[id].value : NULL;
+
+    return has_next;
+}
+
+uint64_t imap_iter_key(
+    struct imap_iter * iter)
+{
+    return iter->key;
+}
+
+void const * imap_iter_value(
+    struct imap_iter * iter)
+{
+    return iter->value;
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/parallel.h"
+#include "hmap/allocator.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <stdbool.h>
+
+struct hmap_parallel_thread
+{
+    hmap_parallel_fn * work;
+    void * context;
+    size_t id;
+    pthread_t thread;
+    bool started;
+};
+
+static void * hmap_parallel_main(
+    void * arg)
+{
+    struct hmap_parallel_thread * thread = arg;
+    thread->work(thread->id, thread->context);
+
+    return NULL;
+}
+
+size_t hmap_parallel_getthreadcount(
+    size_t thread_count)
+{
+    if (0 == thread_count)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (0 < processors) ? ((size_t) processors) : 1;
+    }
+
+    return thread_count;
+}
+
+size_t hmap_parallel_slice(
+    size_t count,
+    size_t thread_count,
+    size_t thread_id)
+{
+    size_t remainder = count % thread_count;
+    return ((count / thread_count) * thread_id) + ((thread_id < remainder) ? thread_id : remainder);
+}
+
+void hmap_parallel_run(
+    struct hmap_allocator const * allocator,
+    size_t thread_count,
+    hmap_parallel_fn * work,
+    void * context)
+{
+    if (thread_count <= 1)
+    {
+        work(0, context);
+        return;
+    }
+
+    struct hmap_parallel_thread * threads = hmap_allocator_alloc(allocator, thread_count * sizeof(struct hmap_parallel_thread));
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        threads[i].work = work;
+        threads[i].context = context;
+        threads[i].id = i;
+        threads[i].started = (0 == pthread_create(&(threads[i].thread), NULL, &hmap_parallel_main, &(threads[i])));
+    }
+
+    work(0, context);
+
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        if (threads[i].started)
+        {
+            pthread_join(threads[i].thread, NULL);
+        }
+        else
+        {
+            work(i, context);
+        }
+    }
+
+    hmap_allocator_free(allocator, threads, thread_count * sizeof(struct hmap_parallel_thread));
+}
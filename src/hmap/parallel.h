@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_PARALLEL_H
+#define HMAP_PARALLEL_H
+
+#include "hmap/hmap.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Work of a single thread.
+///
+/// \param thread_id Id of the thread; 0 is the calling thread.
+/// \param context User defined context.
+typedef void hmap_parallel_fn(size_t thread_id, void * context);
+
+/// Returns the number of threads to use.
+///
+/// \param thread_count Requested number of threads; 0 for one thread per processor.
+/// \return Number of threads; at least 1.
+extern size_t hmap_parallel_getthreadcount(
+    size_t thread_count);
+
+/// Returns the begin of the slice of \arg count items processed by a thread.
+///
+/// \note The slice of a thread ends at the begin of the slice of the next thread.
+///
+/// \param count Number of items.
+/// \param thread_count Number of threads.
+/// \param thread_id Id of the thread; thread_count for the end of the last slice.
+extern size_t hmap_parallel_slice(
+    size_t count,
+    size_t thread_count,
+    size_t thread_id);
+
+/// Runs \arg work once for each thread id and waits until all are done.
+///
+/// The calling thread runs the work of thread 0. If a thread cannot
+/// be created, its work is done by the calling thread as well.
+///
+/// \param allocator Allocator used for the thread handles.
+/// \param thread_count Number of threads.
+/// \param work Work of each thread.
+/// \param context Passed to \arg work.
+extern void hmap_parallel_run(
+    struct hmap_allocator const * allocator,
+    size_t thread_count,
+    hmap_parallel_fn * work,
+    void * context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
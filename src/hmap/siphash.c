@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/siphash.h"
+
+#define SMAP_SIPHASH_ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static uint64_t smap_siphash_read8(unsigned char const * p)
+{
+    return ((uint64_t) p[0])
+        | (((uint64_t) p[1]) << 8)
+        | (((uint64_t) p[2]) << 16)
+        | (((uint64_t) p[3]) << 24)
+        | (((uint64_t) p[4]) << 32)
+        | (((uint64_t) p[5]) << 40)
+        | (((uint64_t) p[6]) << 48)
+        | (((uint64_t) p[7]) << 56);
+}
+
+static void smap_siphash_round(uint64_t v[4])
+{
+    v[0] += v[1];
+    v[1] = SMAP_SIPHASH_ROTL(v[1], 13);
+    v[1] ^= v[0];
+    v[0] = SMAP_SIPHASH_ROTL(v[0], 32);
+    v[2] += v[3];
+    v[3] = SMAP_SIPHASH_ROTL(v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = SMAP_SIPHASH_ROTL(v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = SMAP_SIPHASH_ROTL(v[1], 17);
+    v[1] ^= v[2];
+    v[2] = SMAP_SIPHASH_ROTL(v[2], 32);
+}
+
+size_t smap_siphash(char const * key, size_t length, uint64_t const secret[2])
+{
+    unsigned char const * p = (unsigned char const *) key;
+    uint64_t v[4] =
+    {
+        secret[0] ^ UINT64_C(0x736f6d6570736575),
+        secret[1] ^ UINT64_C(0x646f72616e646f6d),
+        secret[0] ^ UINT64_C(0x6c7967656e657261),
+        secret[1] ^ UINT64_C(0x7465646279746573)
+    };
+
+    // compress full 8 byte words
+    size_t end = length - (length % 8);
+    for (size_t i = 0; i < end; i += 8)
+    {
+        uint64_t m = smap_siphash_read8(&p[i]);
+        v[3] ^= m;
+        smap_siphash_round(v);
+        smap_siphash_round(v);
+        v[0] ^= m;
+    }
+
+    // last word contains remaining bytes and the length
+    uint64_t m = ((uint64_t) length) << 56;
+    for (size_t i = 0; i < (length % 8); i++)
+    {
+        m |= ((uint64_t) p[end + i]) << (8 * i);
+    }
+    v[3] ^= m;
+    smap_siphash_round(v);
+    smap_siphash_round(v);
+    v[0] ^= m;
+
+    // finalize
+    v[2] ^= 0xff;
+    smap_siphash_round(v);
+    smap_siphash_round(v);
+    smap_siphash_round(v);
+    smap_siphash_round(v);
+
+    return (size_t) (v[0] ^ v[1] ^ v[2] ^ v[3]);
+}
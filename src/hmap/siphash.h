@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef SMAP_SIPHASH_H
+#define SMAP_SIPHASH_H
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdint.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Returns a keyed hash for string values.
+///
+/// Provides SipHash-2-4 by Jean-Philippe Aumasson and Daniel J. Bernstein
+/// (see https://www.aumasson.jp/siphash/siphash.pdf). As long as the
+/// key is kept secret, collisions cannot be provoked by crafted keys.
+///
+/// \param key Key to hash.
+/// \param length Length of \arg key in bytes.
+/// \param secret 128 bit secret key of the hash function.
+/// \return Hash value of \arg key.
+extern size_t smap_siphash(char const * key, size_t length, uint64_t const secret[2]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
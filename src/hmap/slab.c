@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/slab.h"
+#include "hmap/allocator.h"
+
+#define HMAP_SLAB_MIN_NODES 16
+#define HMAP_SLAB_MAX_NODES 4096
+
+struct hmap_slab
+{
+    struct hmap_slab * next;
+    size_t size;
+};
+
+void hmap_slab_init(
+    struct hmap_slab_pool * pool,
+    size_t node_size)
+{
+    // nodes must be able to hold the free list link
+    pool->node_size = (node_size < sizeof(void *)) ? sizeof(void *) : node_size;
+    pool->slab_nodes = HMAP_SLAB_MIN_NODES;
+    pool->size = 0;
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+}
+
+void hmap_slab_cleanup(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator)
+{
+    struct hmap_slab * slab = pool->slabs;
+    while (NULL != slab)
+    {
+        struct hmap_slab * next = slab->next;
+        hmap_allocator_free(allocator, slab, slab->size);
+        slab = next;
+    }
+
+    pool->size = 0;
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+}
+
+void * hmap_slab_alloc(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator)
+{
+    void * node = pool->free_list;
+    if (NULL != node)
+    {
+        pool->free_list = *((void **) node);
+        return node;
+    }
+
+    if (pool->next == pool->end)
+    {
+        size_t size = sizeof(struct hmap_slab) + (pool->slab_nodes * pool->node_size);
+        struct hmap_slab * slab = hmap_allocator_alloc(allocator, size);
+        slab->next = pool->slabs;
+        slab->size = size;
+        pool->slabs = slab;
+        pool->size += size;
+
+        pool->next = (unsigned char *) (slab + 1);
+        pool->end = pool->next + (pool->slab_nodes * pool->node_size);
+        if (pool->slab_nodes < HMAP_SLAB_MAX_NODES)
+        {
+            pool->slab_nodes *= 2;
+        }
+    }
+
+    node = pool->next;
+    pool->next += pool->node_size;
+    return node;
+}
+
+void * hmap_slab_alloc_n(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator,
+    size_t count)
+{
+    // the current slab is kept, so its remaining nodes are still used
+    size_t size = sizeof(struct hmap_slab) + (count * pool->node_size);
+    struct hmap_slab * slab = hmap_allocator_alloc(allocator, size);
+    slab->next = pool->slabs;
+    slab->size = size;
+    pool->slabs = slab;
+    pool->size += size;
+
+    return slab + 1;
+}
+
+void hmap_slab_free(
+    struct hmap_slab_pool * pool,
+    void * node)
+{
+    *((void **) node) = pool->free_list;
+    pool->free_list = node;
+}
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_SLAB_H
+#define HMAP_SLAB_H
+
+#include "hmap/hmap.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct hmap_slab;
+
+/// Pool of fixed-size nodes.
+///
+/// Nodes are carved from slabs, which are allocated with growing
+/// size. Freed nodes are kept in a free list and reused by later
+/// allocations; slabs are only released when the pool is cleaned up.
+/// Owners give memory of freed nodes back by copying the remaining
+/// nodes into a new pool.
+struct hmap_slab_pool
+{
+    size_t node_size;
+    size_t slab_nodes;
+    size_t size;
+    struct hmap_slab * slabs;
+    void * free_list;
+    unsigned char * next;
+    unsigned char * end;
+};
+
+/// Initializes an empty pool.
+///
+/// \param pool Pointer to the pool.
+/// \param node_size Size of a node in bytes.
+extern void hmap_slab_init(
+    struct hmap_slab_pool * pool,
+    size_t node_size);
+
+/// Releases all slabs of the pool.
+///
+/// \param pool Pointer to the pool.
+/// \param allocator Allocator used to allocate the slabs.
+extern void hmap_slab_cleanup(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator);
+
+/// Allocates a node.
+///
+/// \param pool Pointer to the pool.
+/// \param allocator Allocator used to allocate slabs.
+/// \return Pointer to the node.
+extern void * hmap_slab_alloc(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator);
+
+/// Allocates \arg count contiguous nodes in a slab of their own.
+///
+/// \note Unused nodes can be returned to the pool using \see hmap_slab_free.
+///
+/// \param pool Pointer to the pool.
+/// \param allocator Allocator used to allocate the slab.
+/// \param count Number of nodes to allocate.
+/// \return Pointer to the first node.
+extern void * hmap_slab_alloc_n(
+    struct hmap_slab_pool * pool,
+    struct hmap_allocator const * allocator,
+    size_t count);
+
+/// Returns a node to the pool.
+///
+/// \param pool Pointer to the pool.
+/// \param node Node to free.
+extern void hmap_slab_free(
+    struct hmap_slab_pool * pool,
+    void * node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,126 +3,516 @@
 
 #include "hmap/smap.h"
 #include "hmap/djb2.h"
-#include <stdlib.h>
+#include "hmap/wyhash.h"
+#include "hmap/siphash.h"
+#include "hmap/table.h"
+#include "hmap/table_perfect.h"
+#include "hmap/allocator.h"
+#include "hmap/arena.h"
 #include <string.h>
+#include <stdio.h>
 
-#define SMAP_INITIAL_BUCKETS 16
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Keys shorter than SMAP_INLINE_KEY_SIZE (including the terminating
+// '\0') are stored inline in the entry. Longer keys are appended to
+// a per-map arena and referenced by their offset. The arena is
+// compacted once more than half of it is occupied by removed keys.
+//
+// Values are either stored as pointer or, if value_size is set,
+// inline starting at the address of the value field; the entry is
+// extended to hold value_size bytes.
+
+#define SMAP_INLINE_KEY_SIZE 16
+#define SMAP_COMPACT_MIN_GARBAGE 4096
+
+// Files written by smap_save consist of a header followed by the
+// serialized values, the displacements and entries of a perfect table
+// and the key arena. Each section starts at a multiple of
+// SMAP_FILE_ALIGNMENT. Entries reference keys by their offset into
+// the arena and values by their offset into the value section.
+
+#define SMAP_FILE_MAGIC "smapfile"
+#define SMAP_FILE_VERSION 1
+#define SMAP_FILE_BYTE_ORDER UINT32_C(0x01020304)
+#define SMAP_FILE_ALIGNMENT 8
+#define SMAP_FILE_NULL_VALUE ((size_t) -1)
 
 struct smap_entry
 {
-    char * key;
+    size_t length;
+    union
+    {
+        char data[SMAP_INLINE_KEY_SIZE];
+        size_t offset;
+    } key;
     void * value;
-    struct smap_entry * next;
 };
 
-struct smap_bucket
+struct smap_key
 {
-    struct smap_entry head;
+    char const * data;
+    size_t length;
 };
 
 struct smap
 {
     size_t seed;
     smap_release_fn * release_value;
+    enum smap_hash hash;
+    uint64_t hash_key[2];
+    size_t value_size;
 
-    size_t entry_count;
-    size_t bucket_count;
-    struct smap_bucket * buckets;
+    struct hmap_table table;
+    struct hmap_arena keys;
 };
 
-static struct smap_bucket *
-smap_getbucket(
+struct smap_frozen
+{
+    struct smap map;    // settings and keys of the frozen map; its table is already released
+    struct hmap_perfect_table table;
+
+    unsigned char * mapping;        // file mapped by smap_load; NULL if not loaded from a file
+    size_t mapping_size;
+    unsigned char const * values;   // serialized values of a mapped file
+};
+
+struct smap_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t size_of_size;
+    uint32_t hash;
+    uint64_t seed;
+    uint64_t hash_key[2];
+    uint64_t value_size;
+    uint64_t entry_size;
+    uint64_t entry_count;
+    uint64_t bucket_count;
+    uint64_t values_offset;
+    uint64_t values_size;
+    uint64_t displacements_offset;
+    uint64_t entries_offset;
+    uint64_t keys_offset;
+    uint64_t keys_size;
+};
+
+static void * smap_loadvalue(
+    struct smap const * map,
+    void * const * value)
+{
+    return (0 < map->value_size) ? ((void *) value) : *value;
+}
+
+static void smap_storevalue(
+    struct smap const * map,
+    void * * value,
+    void * new_value)
+{
+    if (0 == map->value_size)
+    {
+        *value = new_value;
+    }
+    else if (NULL != new_value)
+    {
+        memcpy(value, new_value, map->value_size);
+    }
+    else
+    {
+        memset(value, 0, map->value_size);
+    }
+}
+
+static size_t smap_getentrysize(
+    size_t value_size)
+{
+    size_t entry_size = sizeof(struct smap_entry);
+    if (value_size > sizeof(void *))
+    {
+        entry_size = offsetof(struct smap_entry, value) + value_size;
+    }
+
+    return entry_size;
+}
+
+static char const * smap_getkey(
+    struct smap const * map,
+    struct smap_entry const * entry)
+{
+    return (entry->length < SMAP_INLINE_KEY_SIZE) ? entry->key.data : &(map->keys.data[entry->key.offset]);
+}
+
+static void smap_setkey(
     struct smap * map,
-    char const * key)
+    struct smap_entry * entry,
+    struct smap_key const * key)
 {
-    size_t hash = smap_djb2(key, map->seed);
-    size_t bucket_id = hash % map->bucket_count;
-    return &(map->buckets[bucket_id]);
+    entry->length = key->length;
+    if (key->length < SMAP_INLINE_KEY_SIZE)
+    {
+        memcpy(entry->key.data, key->data, key->length);
+        entry->key.data[key->length] = '\0';
+    }
+    else
+    {
+        entry->key.offset = hmap_arena_append(&(map->keys), &(map->table.allocator), key->data, key->length);
+    }
 }
 
-static size_t smap_getthreshold(size_t bucket_count)
+static bool smap_matchentry(
+    void const * key,
+    void const * entry,
+    void * context)
 {
-    return (7 * bucket_count) / 10;
+    struct smap * map = context;
+    struct smap_key const * smap_key = key;
+    struct smap_entry const * smap_entry = entry;
+    return (smap_key->length == smap_entry->length) &&
+        (0 == memcmp(smap_key->data, smap_getkey(map, smap_entry), smap_key->length));
 }
 
-static void smap_rehash(struct smap * map)
+static void smap_releaseentry(
+    void * entry,
+    void * context)
 {
-    // create new buckets
-    size_t new_bucket_count = 2 * map->bucket_count;
-    struct smap_bucket * new_buckets = malloc(new_bucket_count * sizeof(struct smap_bucket));
-    for(size_t i = 0; i < new_bucket_count; i++)
+    struct smap * map = context;
+    struct smap_entry * smap_entry = entry;
+
+    if (smap_entry->length >= SMAP_INLINE_KEY_SIZE)
+    {
+        map->keys.garbage += smap_entry->length + 1;
+    }
+
+    if (NULL != map->release_value)
     {
-        struct smap_bucket * new_bucket = &(new_buckets[i]);
-        new_bucket->head.next = &(new_bucket->head);
+        map->release_value(smap_loadvalue(map, &(smap_entry->value)));
     }
+}
+
+static void smap_compact(
+    struct smap * map)
+{
+    struct hmap_allocator const * allocator = &(map->table.allocator);
+    size_t capacity = map->keys.capacity;
+    char * data = hmap_arena_reset(&(map->keys), allocator, map->keys.size - map->keys.garbage);
 
-    // put entries into new buckets
-    for (size_t i = 0; i < map->bucket_count; i++)    
+    size_t bucket_id = 0;
+    size_t start = 0;
+    void * entry = NULL;
+    while (hmap_table_next(&(map->table), &bucket_id, &start, &entry))
     {
-        struct smap_bucket * old_bucket = &(map->buckets[i]);
-        struct smap_entry * entry = old_bucket->head.next;
-        while (&(old_bucket->head) != entry)
+        struct smap_entry * smap_entry = entry;
+        if (smap_entry->length >= SMAP_INLINE_KEY_SIZE)
         {
-            struct smap_entry * next = entry->next;
+            smap_entry->key.offset = hmap_arena_append(&(map->keys), allocator,
+                &(data[smap_entry->key.offset]), smap_entry->length);
+        }
+    }
+
+    hmap_allocator_free(allocator, data, capacity);
+}
 
-            size_t hash = smap_djb2(entry->key, map->seed);
-            size_t new_bucket_id = hash % new_bucket_count;
-            struct smap_bucket * new_bucket = &(new_buckets[new_bucket_id]);
+/// Compacts the arena, if at least half of it is garbage.
+static void smap_collect(
+    struct smap * map)
+{
+    if ((SMAP_COMPACT_MIN_GARBAGE < map->keys.garbage) && (map->keys.size < (2 * map->keys.garbage)))
+    {
+        smap_compact(map);
+    }
+}
 
-            entry->next = new_bucket->head.next;
-            new_bucket->head.next = entry;
+static enum hmap_engine smap_getengine(
+    enum smap_engine engine)
+{
+    switch (engine)
+    {
+        case SMAP_ENGINE_OPEN:
+            return HMAP_ENGINE_OPEN;
+        case SMAP_ENGINE_DENSE:
+            return HMAP_ENGINE_DENSE;
+        case SMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            return HMAP_ENGINE_CHAINED;
+    }
+}
 
-            entry = next;
+static void smap_sethashkey(
+    struct smap * map,
+    unsigned char const * key)
+{
+    for (size_t i = 0; i < 2; i++)
+    {
+        uint64_t value = 0;
+        for (size_t j = 0; j < 8; j++)
+        {
+            value |= ((uint64_t) key[(i * 8) + j]) << (8 * j);
         }
+        map->hash_key[i] = value;
+    }
+
+    map->hash_key[0] ^= (uint64_t) map->seed;
+}
+
+static size_t smap_hash(
+    struct smap const * map,
+    char const * key,
+    size_t length)
+{
+    switch (map->hash)
+    {
+        case SMAP_HASH_SIPHASH:
+            return smap_siphash(key, length, map->hash_key);
+        case SMAP_HASH_DJB2:
+            return smap_djb2(key, length, map->seed);
+        case SMAP_HASH_WYHASH:
+            // fall-through
+        default:
+            return smap_wyhash(key, length, map->seed);
+    }
+}
+
+static size_t smap_hashentry(
+    void const * entry,
+    void * context)
+{
+    struct smap const * map = context;
+    struct smap_entry const * smap_entry = entry;
+    return smap_hash(map, smap_getkey(map, smap_entry), smap_entry->length);
+}
+
+/// Builds a perfect table from the entries of \arg map.
+///
+/// If keys share a hash value, \arg settings are re-seeded and all
+/// keys are re-hashed; on success, \arg settings keep the seed used.
+///
+/// \param perfect Pointer to the table to build.
+/// \param map Map to copy entries from.
+/// \param settings Copy of \arg map; passed to the callbacks.
+/// \return true on success; false, if keys share a hash value for each seed tried.
+static bool smap_buildperfect(
+    struct hmap_perfect_table * perfect,
+    struct smap * map,
+    struct smap * settings)
+{
+    bool success = hmap_perfect_init(perfect, &(map->table), NULL, settings);
+    for (size_t attempt = 1; (!success) && (attempt <= HMAP_PERFECT_RESEEDS); attempt++)
+    {
+        // the seed is mixed into the key of siphash, see smap_sethashkey
+        size_t seed = hmap_perfect_reseed(map->seed, attempt);
+        settings->hash_key[0] = map->hash_key[0] ^ ((uint64_t) map->seed) ^ ((uint64_t) seed);
+        settings->seed = seed;
+        success = hmap_perfect_init(perfect, &(map->table), &smap_hashentry, settings);
+    }
+
+    return success;
+}
+
+/// Items of \see smap_build_bulk.
+///
+/// Space for long keys is reserved in the arena before the build;
+/// keys are copied into it while they are hashed.
+struct smap_bulk_items
+{
+    struct smap * map;
+    char const * const * keys;
+    void * const * values;
+    size_t * lengths;
+    size_t * offsets;
+};
+
+static size_t smap_bulkhash(
+    size_t index,
+    void * context)
+{
+    struct smap_bulk_items const * items = context;
+    struct smap * map = items->map;
+    size_t length = items->lengths[index];
+
+    if (length >= SMAP_INLINE_KEY_SIZE)
+    {
+        memcpy(&(map->keys.data[items->offsets[index]]), items->keys[index], length + 1);
+    }
+
+    return smap_hash(map, items->keys[index], length);
+}
+
+static bool smap_bulkmatch(
+    size_t index,
+    void const * entry,
+    void * context)
+{
+    struct smap_bulk_items const * items = context;
+    struct smap_key key = { items->keys[index], items->lengths[index] };
+    return smap_matchentry(&key, entry, items->map);
+}
+
+static void smap_bulkstore(
+    size_t index,
+    void * entry,
+    void * context)
+{
+    struct smap_bulk_items const * items = context;
+    struct smap_entry * smap_entry = entry;
+    size_t length = items->lengths[index];
+
+    smap_entry->length = length;
+    if (length < SMAP_INLINE_KEY_SIZE)
+    {
+        memcpy(smap_entry->key.data, items->keys[index], length + 1);
+    }
+    else
+    {
+        smap_entry->key.offset = items->offsets[index];
+    }
+    smap_storevalue(items->map, &(smap_entry->value), (NULL != items->values) ? items->values[index] : NULL);
+}
+
+static void smap_bulkreplace(
+    size_t index,
+    void * entry,
+    void * context)
+{
+    struct smap_bulk_items const * items = context;
+    struct smap * map = items->map;
+    struct smap_entry * smap_entry = entry;
+
+    // the entry keeps its key, so the copy of the key is garbage
+    if (items->lengths[index] >= SMAP_INLINE_KEY_SIZE)
+    {
+        map->keys.garbage += items->lengths[index] + 1;
     }
 
-    // update map to use new buckets
-    free(map->buckets);
-    map->bucket_count = new_bucket_count;
-    map->buckets = new_buckets;
+    if (NULL != map->release_value)
+    {
+        map->release_value(smap_loadvalue(map, &(smap_entry->value)));
+    }
+    smap_storevalue(map, &(smap_entry->value), (NULL != items->values) ? items->values[index] : NULL);
 }
 
+void smap_options_init(
+    struct smap_options * options)
+{
+    options->seed = 0;
+    options->release_value = NULL;
+    options->value_size = 0;
+    options->hash = SMAP_HASH_WYHASH;
+    memset(options->hash_key, 0, SMAP_HASH_KEY_SIZE);
+    options->engine = SMAP_ENGINE_CHAINED;
+    options->incremental_rehash = false;
+    options->rehash_threads = 1;
+    options->capacity = 0;
+    options->max_load_factor = 0.7;
+    options->allocator.alloc = NULL;
+    options->allocator.free = NULL;
+    options->allocator.context = NULL;
+}
 
 struct smap * smap_create(
     size_t seed,
     smap_release_fn * release_value)
 {
-    struct smap * map = malloc(sizeof(struct smap));
-    map->seed = seed;
-    map->release_value = release_value;
-    map->entry_count = 0;
+    struct smap_options options;
+    smap_options_init(&options);
+    options.seed = seed;
+    options.release_value = release_value;
 
-    map->bucket_count = SMAP_INITIAL_BUCKETS;
-    map->buckets = malloc(map->bucket_count * sizeof(struct smap_bucket));
-    for (size_t i = 0; i < map->bucket_count; i++)
-    {
-        map->buckets[i].head.next = &(map->buckets[i].head);
-    }
+    return smap_create_ex(&options);
+}
+
+struct smap * smap_create_ex(
+    struct smap_options const * options)
+{
+    struct hmap_options table_options;
+    hmap_options_init(&table_options);
+    table_options.engine = smap_getengine(options->engine);
+    table_options.incremental_rehash = options->incremental_rehash;
+    table_options.rehash_threads = options->rehash_threads;
+    table_options.capacity = options->capacity;
+    table_options.max_load_factor = options->max_load_factor;
+    table_options.allocator.alloc = options->allocator.alloc;
+    table_options.allocator.free = options->allocator.free;
+    table_options.allocator.context = options->allocator.context;
+
+    struct hmap_allocator allocator;
+    hmap_allocator_init(&allocator, &(table_options.allocator));
+
+    struct smap * map = hmap_allocator_alloc(&allocator, sizeof(struct smap));
+    map->seed = options->seed;
+    map->release_value = options->release_value;
+    map->hash = options->hash;
+    smap_sethashkey(map, options->hash_key);
+    map->value_size = options->value_size;
+
+    hmap_table_init(&(map->table), &table_options, smap_getentrysize(map->value_size),
+        &smap_matchentry, &smap_releaseentry, map);
+    hmap_arena_init(&(map->keys));
 
     return map;
 }
 
-void smap_release(struct smap * map)
+struct smap * smap_build_bulk(
+    struct smap_options const * options,
+    char const * const * keys,
+    void * const * values,
+    size_t count,
+    size_t thread_count)
 {
-    for (size_t i = 0; i < map->bucket_count; i++)
-    {
-        struct smap_bucket * bucket = &(map->buckets[i]);
-        struct smap_entry * entry = bucket->head.next;
-        struct smap_entry * end = &(bucket->head);
+    struct smap * map = smap_create_ex(options);
+    struct hmap_allocator const * allocator = &(map->table.allocator);
+
+    struct smap_bulk_items items = { map, keys, values, NULL, NULL };
+    items.lengths = hmap_allocator_alloc(allocator, count * sizeof(size_t));
+    items.offsets = hmap_allocator_alloc(allocator, count * sizeof(size_t));
 
-        while (entry != end)
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        items.lengths[i] = strlen(keys[i]);
+        items.offsets[i] = size;
+        if (items.lengths[i] >= SMAP_INLINE_KEY_SIZE)
         {
-            struct smap_entry * next = entry->next;
-            free(entry->key);
-            map->release_value(entry->value);
-            free(entry);
+            size += items.lengths[i] + 1;
+        }
+    }
 
-            entry = next;
+    if (0 < size)
+    {
+        size_t offset = hmap_arena_reserve(&(map->keys), allocator, size);
+        for (size_t i = 0; i < count; i++)
+        {
+            items.offsets[i] += offset;
         }
     }
 
-    free(map->buckets);
-    free(map);
+    struct hmap_table_bulk bulk = { count, &smap_bulkhash, &smap_bulkmatch,
+        &smap_bulkstore, &smap_bulkreplace, &items };
+    hmap_table_build(&(map->table), &bulk, thread_count);
+
+    hmap_allocator_free(allocator, items.offsets, count * sizeof(size_t));
+    hmap_allocator_free(allocator, items.lengths, count * sizeof(size_t));
+
+    return map;
+}
+
+void smap_release(struct smap * map)
+{
+    struct hmap_allocator allocator = map->table.allocator;
+
+    // keys are freed with the arena, so entries are only visited to release values
+    if (NULL == map->release_value)
+    {
+        map->table.release = NULL;
+    }
+
+    hmap_table_cleanup(&(map->table));
+    hmap_arena_cleanup(&(map->keys), &allocator);
+    hmap_allocator_free(&allocator, map, sizeof(struct smap));
 }
 
 void smap_add(
@@ -130,62 +520,169 @@ void smap_add(
     char const * key,
     void * value)
 {
-    if (map->entry_count > smap_getthreshold(map->bucket_count))
+    smap_add_n(map, key, strlen(key), value);
+}
+
+void smap_add_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    void * value)
+{
+    struct smap_key smap_key = { key, length };
+    size_t hash = smap_hash(map, key, length);
+
+    bool created = false;
+    struct smap_entry * entry = hmap_table_insert(&(map->table), hash, &smap_key, &created);
+    if (created)
+    {
+        smap_setkey(map, entry, &smap_key);
+    }
+    else if (NULL != map->release_value)
     {
-        smap_rehash(map);
+        map->release_value(smap_loadvalue(map, &(entry->value)));
     }
 
-    struct smap_bucket * bucket = smap_getbucket(map, key);
+    smap_storevalue(map, &(entry->value), value);
+}
+
+void ** smap_get_or_insert(
+    struct smap * map,
+    char const * key,
+    bool * created)
+{
+    return smap_get_or_insert_n(map, key, strlen(key), created);
+}
+
+void ** smap_get_or_insert_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    bool * created)
+{
+    struct smap_key smap_key = { key, length };
+    size_t hash = smap_hash(map, key, length);
 
-    bool found = false;
-    struct smap_entry * entry = bucket->head.next;
-    struct smap_entry * end = &(bucket->head);
-    while (entry != end)
+    bool is_new = false;
+    struct smap_entry * entry = hmap_table_insert(&(map->table), hash, &smap_key, &is_new);
+    if (is_new)
     {
-        if (0 == strcmp(key, entry->key))
-        {
-            map->release_value(entry->value);
-            entry->value = value;
-            found = true;
-            break;
-        }
+        smap_setkey(map, entry, &smap_key);
+        smap_storevalue(map, &(entry->value), NULL);
+    }
 
-        entry = entry->next;
+    if (NULL != created)
+    {
+        *created = is_new;
     }
 
-    if (!found)
+    return &(entry->value);
+}
+
+void ** smap_emplace(
+    struct smap * map,
+    char const * key,
+    void * value,
+    bool * created)
+{
+    return smap_emplace_n(map, key, strlen(key), value, created);
+}
+
+void ** smap_emplace_n(
+    struct smap * map,
+    char const * key,
+    size_t length,
+    void * value,
+    bool * created)
+{
+    bool is_new = false;
+    void ** slot = smap_get_or_insert_n(map, key, length, &is_new);
+    if (is_new)
     {
-        struct smap_entry * entry = malloc(sizeof(struct smap_entry));
-        entry->key = strdup(key);
-        entry->value = value;
-        entry->next = bucket->head.next;
-        bucket->head.next = entry;
+        smap_storevalue(map, slot, value);
+    }
 
-        map->entry_count++;
+    if (NULL != created)
+    {
+        *created = is_new;
     }
+
+    return slot;
 }
 
 void const * smap_get(
     struct smap * map,
     char const * key)
 {
-    char const * value = NULL;
+    return smap_get_n(map, key, strlen(key));
+}
+
+void const * smap_get_n(
+    struct smap * map,
+    char const * key,
+    size_t length)
+{
+    struct smap_key smap_key = { key, length };
+    size_t hash = smap_hash(map, key, length);
+    struct smap_entry * entry = hmap_table_find(&(map->table), hash, &smap_key);
 
-    struct smap_bucket * bucket = smap_getbucket(map, key);
+    return (NULL != entry) ? smap_loadvalue(map, &(entry->value)) : NULL;
+}
+
+static void smap_getbatch(
+    struct smap * map,
+    char const * const * keys,
+    size_t const * lengths,
+    size_t count,
+    void const * * values)
+{
+    struct smap_key smap_keys[HMAP_TABLE_BATCH_SIZE];
+    size_t hashes[HMAP_TABLE_BATCH_SIZE];
 
-    struct smap_entry * entry = bucket->head.next;
-    struct smap_entry * end = &(bucket->head);
-    while (entry != end)
+    for (size_t offset = 0; offset < count; offset += HMAP_TABLE_BATCH_SIZE)
     {
-        if (0 == strcmp(key, entry->key))
+        size_t batch_size = count - offset;
+        if (batch_size > HMAP_TABLE_BATCH_SIZE)
+        {
+            batch_size = HMAP_TABLE_BATCH_SIZE;
+        }
+
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            char const * key = keys[offset + i];
+            size_t length = (NULL != lengths) ? lengths[offset + i] : strlen(key);
+
+            smap_keys[i].data = key;
+            smap_keys[i].length = length;
+            hashes[i] = smap_hash(map, key, length);
+            hmap_table_prefetch(&(map->table), hashes[i]);
+        }
+
+        for (size_t i = 0; i < batch_size; i++)
         {
-            value = entry->value;
-            break;
+            struct smap_entry * entry = hmap_table_find(&(map->table), hashes[i], &(smap_keys[i]));
+            values[offset + i] = (NULL != entry) ? smap_loadvalue(map, &(entry->value)) : NULL;
         }
-        entry = entry->next;
     }
+}
 
-    return value;
+void smap_get_batch(
+    struct smap * map,
+    char const * const * keys,
+    size_t count,
+    void const * * values)
+{
+    smap_getbatch(map, keys, NULL, count, values);
+}
+
+void smap_get_batch_n(
+    struct smap * map,
+    char const * const * keys,
+    size_t const * lengths,
+    size_t count,
+    void const * * values)
+{
+    smap_getbatch(map, keys, lengths, count, values);
 }
 
 bool smap_contains(
@@ -195,31 +692,93 @@ bool smap_contains(
     return (NULL != smap_get(map, key));
 }
 
+bool smap_contains_n(
+    struct smap * map,
+    char const * key,
+    size_t length)
+{
+    return (NULL != smap_get_n(map, key, length));
+}
+
 void smap_remove(
     struct smap * map,
     char const * key)
 {
-    struct smap_bucket * bucket = smap_getbucket(map, key);
+    smap_remove_n(map, key, strlen(key));
+}
 
-    struct smap_entry * prev = &(bucket->head);
-    struct smap_entry * entry = bucket->head.next;
-    struct smap_entry * end = &(bucket->head);
-    while (entry != end)
+void smap_remove_n(
+    struct smap * map,
+    char const * key,
+    size_t length)
+{
+    struct smap_key smap_key = { key, length };
+    size_t hash = smap_hash(map, key, length);
+    hmap_table_remove(&(map->table), hash, &smap_key);
+    smap_collect(map);
+}
+
+void smap_retain(
+    struct smap * map,
+    smap_predicate_fn * predicate,
+    void * context)
+{
+    size_t bucket_id = 0;
+    size_t start = 0;
+    void * entry = NULL;
+    while (hmap_table_next(&(map->table), &bucket_id, &start, &entry))
     {
-        if (0 == strcmp(key, entry->key))
+        struct smap_entry * smap_entry = entry;
+        if (!predicate(smap_getkey(map, smap_entry), smap_entry->length, smap_loadvalue(map, &(smap_entry->value)), context))
         {
-            free(entry->key);
-            map->release_value(entry->value);
-            prev->next = entry->next;
-            free(entry);
-
-            map->entry_count--;
-            break;
+            hmap_table_removeat(&(map->table), &bucket_id, &start, &entry);
         }
+    }
 
-        prev = entry;
-        entry = entry->next;
+    // the arena is compacted once after all items are removed
+    smap_collect(map);
+}
+
+void smap_reserve(
+    struct smap * map,
+    size_t capacity)
+{
+    hmap_table_reserve(&(map->table), capacity);
+}
+
+void smap_shrink_to_fit(
+    struct smap * map)
+{
+    hmap_table_shrink(&(map->table));
+
+    if (map->keys.capacity > (map->keys.size - map->keys.garbage))
+    {
+        smap_compact(map);
+    }
+}
+
+void smap_get_stats(
+    struct smap * map,
+    struct smap_stats * stats)
+{
+    struct hmap_stats table_stats;
+    hmap_table_getstats(&(map->table), &table_stats);
+
+    stats->size = table_stats.size;
+    stats->bucket_count = table_stats.bucket_count;
+    stats->capacity = table_stats.capacity;
+    stats->load_factor = table_stats.load_factor;
+    stats->bytes_allocated = table_stats.bytes_allocated + map->keys.capacity + sizeof(struct smap);
+    stats->rehash_count = table_stats.rehash_count;
+    stats->max_probe_length = table_stats.max_probe_length;
+    stats->mean_probe_length = table_stats.mean_probe_length;
+    for (size_t i = 0; i < SMAP_STATS_HISTOGRAM_SIZE; i++)
+    {
+        stats->probe_histogram[i] = table_stats.probe_histogram[i];
     }
+    stats->lookups = table_stats.lookups;
+    stats->misses = table_stats.misses;
+    stats->comparisons = table_stats.comparisons;
 }
 
 void smap_iter_init(
@@ -227,51 +786,466 @@ void smap_iter_init(
     struct smap * map)
 {
     iter->map = map;
-    iter->bucket_id = -1;
+    iter->bucket_id = 0;
+    iter->start = 0;
+    iter->position = NULL;
     iter->entry = NULL;
 }
 
 bool smap_iter_next(
     struct smap_iter * iter)
 {
-    if (NULL == iter->entry)
+    bool has_next = hmap_table_next(&(iter->map->table), &(iter->bucket_id), &(iter->start), &(iter->position));
+    iter->entry = iter->position;
+
+    return has_next;
+}
+
+char const * smap_iter_key(
+    struct smap_iter * iter)
+{
+    char const * key = (NULL != iter->entry) ? smap_getkey(iter->map, iter->entry) : NULL;
+    return key;
+}
+
+char const * smap_iter_key_n(
+    struct smap_iter * iter,
+    size_t * length)
+{
+    *length = (NULL != iter->entry) ? iter->entry->length : 0;
+    return smap_iter_key(iter);
+}
+
+void const * smap_iter_value(
+    struct smap_iter * iter)
+{
+    void const * value = (NULL != iter->entry) ? smap_loadvalue(iter->map, &(iter->entry->value)) : NULL;
+    return value;
+}
+
+void smap_iter_remove(
+    struct smap_iter * iter)
+{
+    // the arena is not compacted, since fetched keys would be moved
+    if (NULL != iter->entry)
+    {
+        hmap_table_removeat(&(iter->map->table), &(iter->bucket_id), &(iter->start), &(iter->position));
+        iter->entry = NULL;
+    }
+}
+
+struct smap_frozen * smap_freeze(
+    struct smap * map)
+{
+    // the arena of the frozen map is never changed, so it is shrunk to fit
+    if (map->keys.capacity > (map->keys.size - map->keys.garbage))
+    {
+        smap_compact(map);
+    }
+
+    struct hmap_allocator allocator = map->table.allocator;
+    struct smap_frozen * frozen = hmap_allocator_alloc(&allocator, sizeof(struct smap_frozen));
+    frozen->map = *map;
+    if (!smap_buildperfect(&(frozen->table), map, &(frozen->map)))
+    {
+        hmap_allocator_free(&allocator, frozen, sizeof(struct smap_frozen));
+        return NULL;
+    }
+
+    // keys are freed with the arena, so entries are only visited to release values
+    if (NULL == map->release_value)
+    {
+        frozen->table.release = NULL;
+    }
+
+    // entries and keys are owned by the frozen map now; its settings keep the seed used
+    map->table.release = NULL;
+    hmap_table_cleanup(&(map->table));
+    frozen->map.table = map->table;
+    frozen->mapping = NULL;
+    frozen->mapping_size = 0;
+    frozen->values = NULL;
+    hmap_allocator_free(&allocator, map, sizeof(struct smap));
+
+    return frozen;
+}
+
+void smap_frozen_release(
+    struct smap_frozen * frozen)
+{
+    struct hmap_allocator allocator = frozen->table.allocator;
+
+    if (NULL != frozen->mapping)
     {
-        iter->bucket_id = 0;
-        iter->entry = iter->map->buckets[0].head.next;
+        // tables and keys are part of the mapping
+        munmap(frozen->mapping, frozen->mapping_size);
     }
     else
     {
-        struct smap_entry * bucket_end = &(iter->map->buckets[iter->bucket_id].head);
-        if (iter->entry != bucket_end)
+        hmap_perfect_cleanup(&(frozen->table));
+        hmap_arena_cleanup(&(frozen->map.keys), &allocator);
+    }
+
+    hmap_allocator_free(&allocator, frozen, sizeof(struct smap_frozen));
+}
+
+size_t smap_frozen_size(
+    struct smap_frozen const * frozen)
+{
+    return frozen->table.entry_count;
+}
+
+void const * smap_frozen_get(
+    struct smap_frozen const * frozen,
+    char const * key)
+{
+    return smap_frozen_get_n(frozen, key, strlen(key));
+}
+
+void const * smap_frozen_get_n(
+    struct smap_frozen const * frozen,
+    char const * key,
+    size_t length)
+{
+    struct smap_key smap_key = { key, length };
+    size_t hash = smap_hash(&(frozen->map), key, length);
+    struct smap_entry * entry = hmap_perfect_find(&(frozen->table), hash, &smap_key);
+
+    if (NULL == entry)
+    {
+        return NULL;
+    }
+
+    if ((NULL != frozen->mapping) && (0 == frozen->map.value_size))
+    {
+        // values of mapped files are stored by offset
+        size_t offset = *((size_t const *) &(entry->value));
+        return (SMAP_FILE_NULL_VALUE != offset) ? &(frozen->values[offset]) : NULL;
+    }
+
+    return smap_loadvalue(&(frozen->map), &(entry->value));
+}
+
+bool smap_frozen_contains(
+    struct smap_frozen const * frozen,
+    char const * key)
+{
+    return (NULL != smap_frozen_get(frozen, key));
+}
+
+static size_t smap_file_align(
+    size_t offset)
+{
+    return (offset + (SMAP_FILE_ALIGNMENT - 1)) & ~((size_t) (SMAP_FILE_ALIGNMENT - 1));
+}
+
+static bool smap_file_write(
+    FILE * file,
+    void const * data,
+    size_t size)
+{
+    static unsigned char const padding[SMAP_FILE_ALIGNMENT] = { 0 };
+
+    size_t padding_size = smap_file_align(size) - size;
+    return ((0 == size) || (size == fwrite(data, 1, size, file))) &&
+        ((0 == padding_size) || (padding_size == fwrite(padding, 1, padding_size, file)));
+}
+
+/// Writes the values of all entries and replaces them by their offset.
+static bool smap_file_writevalues(
+    struct smap const * map,
+    struct hmap_perfect_table * perfect,
+    FILE * file,
+    smap_serialize_fn * serialize,
+    void * context,
+    size_t * values_size)
+{
+    struct hmap_allocator const * allocator = &(map->table.allocator);
+    unsigned char * buffer = NULL;
+    size_t capacity = 0;
+    size_t offset = 0;
+    bool success = true;
+
+    for (size_t i = 0; (success) && (i < perfect->entry_count); i++)
+    {
+        struct smap_entry * entry = (struct smap_entry *) &(perfect->entries[i * perfect->entry_size]);
+        size_t value_offset = SMAP_FILE_NULL_VALUE;
+
+        if ((NULL != serialize) && (NULL != entry->value))
+        {
+            size_t size = serialize(entry->value, NULL, context);
+            if (size > capacity)
+            {
+                hmap_allocator_free(allocator, buffer, capacity);
+                capacity = size;
+                buffer = hmap_allocator_alloc(allocator, capacity);
+            }
+
+            serialize(entry->value, buffer, context);
+            success = smap_file_write(file, buffer, size);
+            value_offset = offset;
+            offset += smap_file_align(size);
+        }
+
+        memcpy(&(entry->value), &value_offset, sizeof(size_t));
+    }
+
+    hmap_allocator_free(allocator, buffer, capacity);
+    *values_size = offset;
+    return success;
+}
+
+/// Copies the long keys of the entries of \arg perfect into \arg keys.
+///
+/// Only the keys in use are copied, so the garbage of the arena of
+/// \arg map is not written, while \arg map itself is left unchanged.
+/// The entries are copies owned by \arg perfect; their key offsets are
+/// rebased onto \arg keys.
+static void smap_file_collectkeys(
+    struct smap const * map,
+    struct hmap_perfect_table * perfect,
+    struct hmap_arena * keys)
+{
+    hmap_arena_init(keys);
+    hmap_arena_reset(keys, &(map->table.allocator), map->keys.size - map->keys.garbage);
+
+    for (size_t i = 0; i < perfect->entry_count; i++)
+    {
+        struct smap_entry * entry = (struct smap_entry *) &(perfect->entries[i * perfect->entry_size]);
+        if (entry->length >= SMAP_INLINE_KEY_SIZE)
         {
-            iter->entry = iter->entry->next;
+            entry->key.offset = hmap_arena_append(keys, &(map->table.allocator),
+                &(map->keys.data[entry->key.offset]), entry->length);
         }
     }
+}
+
+bool smap_save(
+    struct smap * map,
+    char const * path,
+    smap_serialize_fn * serialize,
+    void * context)
+{
+    struct smap settings = *map;
+    struct hmap_perfect_table perfect;
+    if (!smap_buildperfect(&perfect, map, &settings))
+    {
+        return false;
+    }
+
+    // entries are copies, so values are released by map only
+    perfect.release = NULL;
+
+    FILE * file = fopen(path, "wb");
+    if (NULL == file)
+    {
+        hmap_perfect_cleanup(&perfect);
+        return false;
+    }
+
+    struct smap_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SMAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = SMAP_FILE_VERSION;
+    header.byte_order = SMAP_FILE_BYTE_ORDER;
+    header.size_of_size = (uint32_t) sizeof(size_t);
+    header.hash = (uint32_t) map->hash;
+    header.seed = (uint64_t) settings.seed;
+    header.hash_key[0] = settings.hash_key[0];
+    header.hash_key[1] = settings.hash_key[1];
+    header.value_size = (uint64_t) map->value_size;
+    header.entry_size = (uint64_t) perfect.entry_size;
+    header.entry_count = (uint64_t) perfect.entry_count;
+    header.bucket_count = (uint64_t) perfect.bucket_count;
+
+    size_t values_size = 0;
+    bool success = smap_file_write(file, &header, sizeof(header));
+    if ((success) && (0 == map->value_size))
+    {
+        success = smap_file_writevalues(map, &perfect, file, serialize, context, &values_size);
+    }
+
+    struct hmap_arena keys;
+    smap_file_collectkeys(map, &perfect, &keys);
+
+    size_t displacements_size = (0 < perfect.entry_count) ? (perfect.bucket_count * sizeof(uint32_t)) : 0;
+    size_t entries_size = perfect.entry_count * perfect.entry_size;
+    success = (success) &&
+        (smap_file_write(file, perfect.displacements, displacements_size)) &&
+        (smap_file_write(file, perfect.entries, entries_size)) &&
+        (smap_file_write(file, keys.data, keys.size));
+
+    header.values_offset = (uint64_t) smap_file_align(sizeof(header));
+    header.values_size = (uint64_t) values_size;
+    header.displacements_offset = header.values_offset + smap_file_align(values_size);
+    header.entries_offset = header.displacements_offset + smap_file_align(displacements_size);
+    header.keys_offset = header.entries_offset + smap_file_align(entries_size);
+    header.keys_size = (uint64_t) keys.size;
+
+    success = (success) &&
+        (0 == fseek(file, 0, SEEK_SET)) &&
+        (smap_file_write(file, &header, sizeof(header)));
+
+    success = (0 == fclose(file)) && (success);
+    hmap_arena_cleanup(&keys, &(map->table.allocator));
+    hmap_perfect_cleanup(&perfect);
+
+    if (!success)
+    {
+        remove(path);
+    }
+
+    return success;
+}
+
+static bool smap_file_checksection(
+    size_t file_size,
+    uint64_t offset,
+    uint64_t size)
+{
+    return (offset <= file_size) && (size <= (file_size - offset));
+}
+
+static bool smap_file_checkalignment(
+    uint64_t offset)
+{
+    return (0 == (offset % SMAP_FILE_ALIGNMENT));
+}
 
-    struct smap_entry * bucket_end = &(iter->map->buckets[iter->bucket_id].head);
-    struct smap_entry * end = &(iter->map->buckets[iter->map->bucket_count - 1].head);
-    while ((iter->entry != end) && (iter->entry == bucket_end))
+/// Returns true, if \arg hash is the id of a known hash function.
+static bool smap_file_checkhash(
+    uint32_t hash)
+{
+    switch (hash)
     {
-        iter->bucket_id++;
-        iter->entry = iter->map->buckets[iter->bucket_id].head.next;
-        bucket_end = &(iter->map->buckets[iter->bucket_id].head);
+        case SMAP_HASH_WYHASH:
+            // fall-through
+        case SMAP_HASH_SIPHASH:
+            // fall-through
+        case SMAP_HASH_DJB2:
+            return true;
+        default:
+            return false;
     }
+}
 
-    return (end != iter->entry);
+static bool smap_file_checkheader(
+    struct smap_file_header const * header,
+    size_t file_size)
+{
+    return (0 == memcmp(header->magic, SMAP_FILE_MAGIC, sizeof(header->magic))) &&
+        (SMAP_FILE_VERSION == header->version) &&
+        (SMAP_FILE_BYTE_ORDER == header->byte_order) &&
+        (sizeof(size_t) == header->size_of_size) &&
+        (smap_file_checkhash(header->hash)) &&
+        (header->entry_size == smap_getentrysize((size_t) header->value_size)) &&
+        ((0 == header->entry_count) || (0 < header->bucket_count)) &&
+        (header->bucket_count <= (SIZE_MAX / sizeof(uint32_t))) &&
+        ((0 == header->entry_count) || (header->entry_count <= (SIZE_MAX / header->entry_size))) &&
+        (smap_file_checksection(file_size, header->values_offset, header->values_size)) &&
+        (smap_file_checksection(file_size, header->displacements_offset,
+            (0 < header->entry_count) ? (header->bucket_count * sizeof(uint32_t)) : 0)) &&
+        (smap_file_checksection(file_size, header->entries_offset, header->entry_count * header->entry_size)) &&
+        (smap_file_checksection(file_size, header->keys_offset, header->keys_size)) &&
+        (smap_file_checkalignment(header->values_offset)) &&
+        (smap_file_checkalignment(header->displacements_offset)) &&
+        (smap_file_checkalignment(header->entries_offset));
 }
 
-char const * smap_iter_key(
-    struct smap_iter * iter)
+/// Returns true, if all entries reference keys and values within their sections.
+static bool smap_file_checkentries(
+    struct smap_file_header const * header,
+    unsigned char const * mapping)
 {
-    struct smap_entry * end = &(iter->map->buckets[iter->map->bucket_count - 1].head);
-    char const * key = ((NULL != iter->entry) && (iter->entry != end)) ? iter->entry->key : NULL;
-    return key;
+    size_t const entry_count = (size_t) header->entry_count;
+    size_t const entry_size = (size_t) header->entry_size;
+    size_t const keys_size = (size_t) header->keys_size;
+    size_t const values_size = (size_t) header->values_size;
+    char const * keys = (char const *) &(mapping[header->keys_offset]);
+
+    for (size_t i = 0; i < entry_count; i++)
+    {
+        struct smap_entry const * entry = (struct smap_entry const *) &(mapping[header->entries_offset + (i * entry_size)]);
+
+        // keys are terminated within the entry or the key section
+        if ((entry->length < SMAP_INLINE_KEY_SIZE) ?
+            ('\0' != entry->key.data[entry->length]) :
+            ((entry->key.offset >= keys_size) || (entry->length >= (keys_size - entry->key.offset)) ||
+                ('\0' != keys[entry->key.offset + entry->length])))
+        {
+            return false;
+        }
+
+        if (0 == header->value_size)
+        {
+            size_t offset = *((size_t const *) &(entry->value));
+            if ((SMAP_FILE_NULL_VALUE != offset) && (offset >= values_size))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
-void const * smap_iter_value(
-    struct smap_iter * iter)
+struct smap_frozen * smap_load(
+    char const * path)
 {
-    struct smap_entry * end = &(iter->map->buckets[iter->map->bucket_count - 1].head);
-    void const * value = ((NULL != iter->entry) && (iter->entry != end)) ? iter->entry->value : NULL;
-    return value;
+    int fd = open(path, O_RDONLY);
+    if (0 > fd)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    unsigned char * mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+    if ((0 == fstat(fd, &info)) && (sizeof(struct smap_file_header) <= (size_t) info.st_size))
+    {
+        mapping_size = (size_t) info.st_size;
+        mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (MAP_FAILED == mapping)
+    {
+        return NULL;
+    }
+
+    struct smap_file_header const * header = (struct smap_file_header const *) mapping;
+    if ((!smap_file_checkheader(header, mapping_size)) || (!smap_file_checkentries(header, mapping)))
+    {
+        munmap(mapping, mapping_size);
+        return NULL;
+    }
+
+    struct hmap_allocator allocator;
+    hmap_allocator_init(&allocator, NULL);
+
+    struct smap_frozen * frozen = hmap_allocator_alloc(&allocator, sizeof(struct smap_frozen));
+    memset(&(frozen->map), 0, sizeof(struct smap));
+    frozen->map.seed = (size_t) header->seed;
+    frozen->map.hash = (enum smap_hash) header->hash;
+    frozen->map.hash_key[0] = header->hash_key[0];
+    frozen->map.hash_key[1] = header->hash_key[1];
+    frozen->map.value_size = (size_t) header->value_size;
+    frozen->map.keys.data = (char *) &(mapping[header->keys_offset]);
+    frozen->map.keys.size = (size_t) header->keys_size;
+
+    frozen->table.entry_size = (size_t) header->entry_size;
+    frozen->table.match = &smap_matchentry;
+    frozen->table.release = NULL;
+    frozen->table.context = &(frozen->map);
+    frozen->table.allocator = allocator;
+    frozen->table.entry_count = (size_t) header->entry_count;
+    frozen->table.bucket_count = (size_t) header->bucket_count;
+    frozen->table.displacements = (uint32_t *) &(mapping[header->displacements_offset]);
+    frozen->table.entries = &(mapping[header->entries_offset]);
+
+    frozen->mapping = mapping;
+    frozen->mapping_size = mapping_size;
+    frozen->values = &(mapping[header->values_offset]);
+
+    return frozen;
 }
@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table.h"
+#include "hmap/allocator.h"
+
+#define HMAP_TABLE_INITIAL_BUCKETS 16
+#define HMAP_TABLE_DEFAULT_LOAD_FACTOR 0.7
+
+size_t hmap_table_gethash(
+    void const * entry)
+{
+    return ((size_t const *) entry)[-1];
+}
+
+size_t hmap_table_getthreshold(
+    struct hmap_table const * table,
+    size_t bucket_count)
+{
+    size_t threshold = (size_t) (table->max_load_factor * (double) bucket_count);
+
+    // open addressing needs at least one empty slot to terminate probing
+    if ((HMAP_ENGINE_CHAINED != table->engine) && (threshold > (bucket_count - 2)))
+    {
+        threshold = bucket_count - 2;
+    }
+
+    return threshold;
+}
+
+size_t hmap_table_getbucketcount(
+    struct hmap_table const * table,
+    size_t capacity)
+{
+    size_t bucket_count = HMAP_TABLE_INITIAL_BUCKETS;
+    while ((hmap_table_getthreshold(table, bucket_count) < capacity) && (bucket_count <= (((size_t) -1) / 4)))
+    {
+        bucket_count *= 2;
+    }
+
+    return bucket_count;
+}
+
+static void hmap_table_resize(
+    struct hmap_table * table,
+    size_t bucket_count)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_resize(table, bucket_count);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_resize(table, bucket_count);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_resize(table, bucket_count);
+            break;
+    }
+}
+
+void hmap_table_init(
+    struct hmap_table * table,
+    struct hmap_options const * options,
+    size_t entry_size,
+    hmap_table_match_fn * match,
+    hmap_table_release_fn * release,
+    void * context)
+{
+    table->engine = options->engine;
+    table->entry_size = ((entry_size + sizeof(size_t) - 1) / sizeof(size_t)) * sizeof(size_t);
+    table->incremental = options->incremental_rehash && (HMAP_ENGINE_CHAINED == options->engine);
+    table->rehash_threads = options->rehash_threads;
+    table->max_load_factor = (0.0 < options->max_load_factor) ? options->max_load_factor : HMAP_TABLE_DEFAULT_LOAD_FACTOR;
+    table->match = match;
+    table->release = release;
+    table->context = context;
+    hmap_allocator_init(&(table->allocator), &(options->allocator));
+
+    table->entry_count = 0;
+    table->bucket_count = hmap_table_getbucketcount(table, options->capacity);
+    table->threshold = hmap_table_getthreshold(table, table->bucket_count);
+    table->buckets = NULL;
+    table->ctrl = NULL;
+
+    table->old_bucket_count = 0;
+    table->old_buckets = NULL;
+    table->rehash_id = 0;
+
+    table->items = NULL;
+    table->item_ctrl = NULL;
+    table->item_count = 0;
+    table->item_capacity = 0;
+    table->index_width = 0;
+
+    table->rehash_count = 0;
+    table->lookups = 0;
+    table->misses = 0;
+    table->comparisons = 0;
+
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_init(table);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_init(table);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_init(table);
+            break;
+    }
+}
+
+void hmap_table_cleanup(
+    struct hmap_table * table)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_cleanup(table);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_cleanup(table);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_cleanup(table);
+            break;
+    }
+}
+
+void * hmap_table_find(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key)
+{
+    void * entry;
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            entry = hmap_dense_find(table, hash, key);
+            break;
+        case HMAP_ENGINE_OPEN:
+            entry = hmap_open_find(table, hash, key);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            entry = hmap_chained_find(table, hash, key);
+            break;
+    }
+
+    HMAP_STATS_INC(table->lookups);
+    if (NULL == entry)
+    {
+        HMAP_STATS_INC(table->misses);
+    }
+
+    return entry;
+}
+
+void hmap_table_prefetch(
+    struct hmap_table const * table,
+    size_t hash)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_prefetch(table, hash);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_prefetch(table, hash);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_prefetch(table, hash);
+            break;
+    }
+}
+
+void * hmap_table_insert(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key,
+    bool * created)
+{
+    void * entry;
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            entry = hmap_dense_insert(table, hash, key, created);
+            break;
+        case HMAP_ENGINE_OPEN:
+            entry = hmap_open_insert(table, hash, key, created);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            entry = hmap_chained_insert(table, hash, key, created);
+            break;
+    }
+
+    HMAP_STATS_INC(table->lookups);
+    if (*created)
+    {
+        HMAP_STATS_INC(table->misses);
+    }
+
+    return entry;
+}
+
+bool hmap_table_remove(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key)
+{
+    bool removed;
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            removed = hmap_dense_remove(table, hash, key);
+            break;
+        case HMAP_ENGINE_OPEN:
+            removed = hmap_open_remove(table, hash, key);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            removed = hmap_chained_remove(table, hash, key);
+            break;
+    }
+
+    HMAP_STATS_INC(table->lookups);
+    if (!removed)
+    {
+        HMAP_STATS_INC(table->misses);
+    }
+
+    return removed;
+}
+
+bool hmap_table_next(
+    struct hmap_table * table,
+    size_t * bucket_id,
+    size_t * start,
+    void ** entry)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            return hmap_dense_next(table, bucket_id, start, entry);
+        case HMAP_ENGINE_OPEN:
+            return hmap_open_next(table, bucket_id, start, entry);
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            return hmap_chained_next(table, bucket_id, start, entry);
+    }
+}
+
+void hmap_table_removeat(
+    struct hmap_table * table,
+    size_t * bucket_id,
+    size_t * start,
+    void ** entry)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_removeat(table, bucket_id, start, entry);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_removeat(table, bucket_id, start, entry);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_removeat(table, bucket_id, start, entry);
+            break;
+    }
+}
+
+void hmap_table_reserve(
+    struct hmap_table * table,
+    size_t capacity)
+{
+    size_t bucket_count = hmap_table_getbucketcount(table, capacity);
+    if (bucket_count > table->bucket_count)
+    {
+        hmap_table_resize(table, bucket_count);
+    }
+}
+
+void hmap_table_shrink(
+    struct hmap_table * table)
+{
+    size_t bucket_count = hmap_table_getbucketcount(table, table->entry_count);
+    if (bucket_count < table->bucket_count)
+    {
+        hmap_table_resize(table, bucket_count);
+    }
+}
+
+void hmap_table_addprobe(
+    struct hmap_stats * stats,
+    size_t probe_length)
+{
+    size_t id = (probe_length < HMAP_STATS_HISTOGRAM_SIZE) ? (probe_length - 1) : (HMAP_STATS_HISTOGRAM_SIZE - 1);
+    stats->probe_histogram[id]++;
+
+    if (probe_length > stats->max_probe_length)
+    {
+        stats->max_probe_length = probe_length;
+    }
+    stats->mean_probe_length += (double) probe_length;
+}
+
+void hmap_table_getstats(
+    struct hmap_table * table,
+    struct hmap_stats * stats)
+{
+    stats->size = table->entry_count;
+    stats->bucket_count = table->bucket_count;
+    stats->capacity = table->threshold;
+    stats->load_factor = (double) table->entry_count / (double) table->bucket_count;
+    stats->bytes_allocated = 0;
+    stats->rehash_count = table->rehash_count;
+    stats->max_probe_length = 0;
+    stats->mean_probe_length = 0.0;
+    for (size_t i = 0; i < HMAP_STATS_HISTOGRAM_SIZE; i++)
+    {
+        stats->probe_histogram[i] = 0;
+    }
+    stats->lookups = table->lookups;
+    stats->misses = table->misses;
+    stats->comparisons = table->comparisons;
+
+    // engines sum up probe lengths in mean_probe_length
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            hmap_dense_getstats(table, stats);
+            break;
+        case HMAP_ENGINE_OPEN:
+            hmap_open_getstats(table, stats);
+            break;
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            hmap_chained_getstats(table, stats);
+            break;
+    }
+
+    if (0 < table->entry_count)
+    {
+        stats->mean_probe_length /= (double) table->entry_count;
+    }
+}
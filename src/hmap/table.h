@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_TABLE_H
+#define HMAP_TABLE_H
+
+#include "hmap/hmap.h"
+#include "hmap/slab.h"
+#include "hmap/detail/probe.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Number of keys hashed and prefetched ahead of their lookup in batched lookups.
+#define HMAP_TABLE_BATCH_SIZE 16
+
+// Counters are incremented atomically, since concurrent readers
+// (see chmap) may update them simultaneously.
+#ifdef HMAP_WITH_STATS
+#define HMAP_STATS_INC(counter) ((void) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED))
+#else
+#define HMAP_STATS_INC(counter) ((void) 0)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HMAP_PREFETCH(address) __builtin_prefetch((address), 0, 3)
+#else
+#define HMAP_PREFETCH(address) ((void) (address))
+#endif
+
+/// Mixes all bits of \arg value (finalizer of MurmurHash3).
+///
+/// \note The result is independent of the bits used by
+///       \see hmap_table_gethome, so it can partition entries
+///       without biasing their home buckets.
+static inline uint64_t hmap_table_mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= UINT64_C(0xff51afd7ed558ccd);
+    value ^= value >> 33;
+    value *= UINT64_C(0xc4ceb9fe1a85ec53);
+    value ^= value >> 33;
+
+    return value;
+}
+
+/// Returns true, if \arg entry is stored using \arg key.
+///
+/// \param key Key to compare.
+/// \param entry Entry to compare.
+/// \param context User defined context of the table.
+/// \return true, if the key of \arg entry equals \arg key.
+typedef bool hmap_table_match_fn(void const * key, void const * entry, void * context);
+
+/// Releases the contents of an entry.
+///
+/// \note The table does not visit its entries on cleanup, if
+///       no release function is provided.
+///
+/// \param entry Entry to release.
+/// \param context User defined context of the table.
+typedef void hmap_table_release_fn(void * entry, void * context);
+
+/// Returns the hash value of an item of a bulk build.
+///
+/// \param index Index of the item.
+/// \param context User defined context of the bulk build.
+/// \return Hash value of the key of the item.
+typedef size_t hmap_table_bulkhash_fn(size_t index, void * context);
+
+/// Returns true, if \arg entry is stored using the key of an item of a bulk build.
+///
+/// \param index Index of the item.
+/// \param entry Entry to compare.
+/// \param context User defined context of the bulk build.
+/// \return true, if the key of \arg entry equals the key of the item.
+typedef bool hmap_table_bulkmatch_fn(size_t index, void const * entry, void * context);
+
+/// Stores an item of a bulk build in \arg entry.
+///
+/// \param index Index of the item.
+/// \param entry New entry to fill, if the key of the item is not stored yet;
+///              otherwise the entry storing the key.
+/// \param context User defined context of the bulk build.
+typedef void hmap_table_bulkstore_fn(size_t index, void * entry, void * context);
+
+/// Items of a bulk build, see \see hmap_table_build.
+///
+/// \note hash, match and store are called concurrently by multiple
+///       threads, each with items of distinct buckets; replace is only
+///       called by the thread calling \see hmap_table_build.
+struct hmap_table_bulk
+{
+    size_t count;                       ///< Number of items.
+    hmap_table_bulkhash_fn * hash;      ///< Hashes the key of an item.
+    hmap_table_bulkmatch_fn * match;    ///< Compares the key of an item with an entry.
+    hmap_table_bulkstore_fn * store;    ///< Fills a new entry.
+    hmap_table_bulkstore_fn * replace;  ///< Updates the entry of an item whose key is already stored.
+    void * context;                     ///< Passed to the callbacks.
+};
+
+/// Outcome of placing an item of a bulk build.
+enum hmap_table_place
+{
+    HMAP_TABLE_PLACE_CREATED,           ///< A new entry was created.
+    HMAP_TABLE_PLACE_FOUND,             ///< An entry storing the key was found.
+    HMAP_TABLE_PLACE_DEFERRED           ///< The probe sequence reaches the end of the partition.
+};
+
+/// Storage engine shared by the Hashmaps.
+///
+/// The table stores opaque entries of a fixed size. The layout
+/// of an entry is defined by the owner of the table, which also
+/// provides callbacks to match and release entries.
+///
+/// The hash of each entry is stored by the table next to the entry,
+/// so entries are never hashed again when the table grows and
+/// entries with a different hash are rejected without calling match.
+struct hmap_table
+{
+    enum hmap_engine engine;
+    size_t entry_size;
+    bool incremental;
+    size_t rehash_threads;
+    double max_load_factor;
+    hmap_table_match_fn * match;
+    hmap_table_release_fn * release;
+    void * context;
+    struct hmap_allocator allocator;
+    struct hmap_slab_pool nodes;
+
+    size_t entry_count;
+    size_t bucket_count;
+    size_t threshold;
+    void * buckets;
+    unsigned char * ctrl;
+
+    size_t old_bucket_count;
+    void * old_buckets;
+    size_t rehash_id;
+
+    unsigned char * items;
+    unsigned char * item_ctrl;
+    size_t item_count;
+    size_t item_capacity;
+    size_t index_width;
+
+    size_t rehash_count;
+    size_t lookups;
+    size_t misses;
+    size_t comparisons;
+};
+
+/// Initializes an empty table.
+///
+/// \note Only the storage related fields of \arg options are used,
+///       e.g. the hash function is ignored.
+///
+/// \param table Pointer to the table.
+/// \param options Options of the map owning the table.
+/// \param entry_size Size of an entry in bytes.
+/// \param match Used to find an entry by key.
+/// \param release Used to release removed entries; NULL if nothing is to release.
+/// \param context Passed to the callbacks.
+extern void hmap_table_init(
+    struct hmap_table * table,
+    struct hmap_options const * options,
+    size_t entry_size,
+    hmap_table_match_fn * match,
+    hmap_table_release_fn * release,
+    void * context);
+
+/// Releases all entries and the memory used by the table.
+///
+/// \param table Pointer to the table.
+extern void hmap_table_cleanup(
+    struct hmap_table * table);
+
+/// Returns the entry stored for \arg key.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key to find.
+/// \return Entry of \arg key or NULL, if \arg key is not stored.
+extern void * hmap_table_find(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key);
+
+/// Prefetches the memory touched first when looking up \arg hash.
+///
+/// Used by batched lookups to overlap cache misses of multiple keys.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of a key to lookup later.
+extern void hmap_table_prefetch(
+    struct hmap_table const * table,
+    size_t hash);
+
+/// Returns the entry stored for \arg key and creates it if needed.
+///
+/// \note A newly created entry is not initialized. The caller must
+///       initialize it before the table is used again.
+/// \note Pointers to entries are invalidated by subsequent inserts
+///       and removals.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key to find or insert.
+/// \param created Set to true, if the entry was newly created.
+/// \return Entry of \arg key.
+extern void * hmap_table_insert(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key,
+    bool * created);
+
+/// Releases and removes the entry stored for \arg key.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key of the entry to remove.
+/// \return true, if an entry was removed.
+extern bool hmap_table_remove(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key);
+
+/// Fetches the next entry of the table.
+///
+/// \note Initialize \arg bucket_id with 0 and \arg entry with NULL
+///       to fetch the first entry.
+///
+/// \param table Pointer to the table.
+/// \param bucket_id Id of the current bucket or slot.
+/// \param start Position the iteration started at; set on the first call.
+/// \param entry Current entry; set to the next entry.
+/// \return true, if there is a next entry, otherwise false.
+extern bool hmap_table_next(
+    struct hmap_table * table,
+    size_t * bucket_id,
+    size_t * start,
+    void ** entry);
+
+/// Releases and removes the current entry of an iteration.
+///
+/// The iteration continues with the entry following the removed one;
+/// all other entries are still fetched exactly once. The table is
+/// never resized by this function.
+///
+/// \param table Pointer to the table.
+/// \param bucket_id Id of the current bucket or slot.
+/// \param start Position the iteration started at.
+/// \param entry Current entry; updated, so that the next call of
+///              \see hmap_table_next fetches the following entry.
+extern void hmap_table_removeat(
+    struct hmap_table * table,
+    size_t * bucket_id,
+    size_t * start,
+    void ** entry);
+
+/// Inserts the items of \arg bulk into an empty table using multiple threads.
+///
+/// The table is resized to store all items first. Keys are hashed in
+/// parallel, then the items are partitioned by ranges of buckets and
+/// each partition is filled by one thread. Items whose probe sequence
+/// leaves their partition are inserted afterwards by the calling thread.
+///
+/// Items with equal keys are processed in the order of their indices:
+/// the first one is stored, each later one is passed to replace.
+///
+/// \param table Pointer to the table; must not contain any entry.
+/// \param bulk Items to insert.
+/// \param thread_count Number of threads to use; 0 to use one thread per processor.
+extern void hmap_table_build(
+    struct hmap_table * table,
+    struct hmap_table_bulk const * bulk,
+    size_t thread_count);
+
+/// Resizes the table to store at least \arg capacity entries without growing.
+///
+/// \param table Pointer to the table.
+/// \param capacity Number of entries to reserve space for.
+extern void hmap_table_reserve(
+    struct hmap_table * table,
+    size_t capacity);
+
+/// Shrinks the table to the smallest size able to store its entries.
+///
+/// \param table Pointer to the table.
+extern void hmap_table_shrink(
+    struct hmap_table * table);
+
+/// Returns statistics of the table.
+///
+/// \note Memory allocated by the owner of the table is not included.
+///
+/// \param table Pointer to the table.
+/// \param stats Receives the statistics.
+extern void hmap_table_getstats(
+    struct hmap_table * table,
+    struct hmap_stats * stats);
+
+/// Records the probe length of an entry.
+///
+/// \param stats Statistics to update.
+/// \param probe_length Probe length of the entry.
+extern void hmap_table_addprobe(
+    struct hmap_stats * stats,
+    size_t probe_length);
+
+/// Returns the hash value stored next to \arg entry.
+///
+/// \note All engines store the hash value directly in front of the entry.
+///
+/// \param entry Entry of a table.
+/// \return Hash value of the key of \arg entry.
+extern size_t hmap_table_gethash(
+    void const * entry);
+
+/// Returns the number of entries the table can store before it grows.
+///
+/// \param table Pointer to the table.
+/// \param bucket_count Number of buckets.
+extern size_t hmap_table_getthreshold(
+    struct hmap_table const * table,
+    size_t bucket_count);
+
+/// Returns the smallest bucket count able to store \arg capacity entries.
+///
+/// \note The bucket count is always a power of two.
+///
+/// \param table Pointer to the table.
+/// \param capacity Number of entries to store.
+extern size_t hmap_table_getbucketcount(
+    struct hmap_table const * table,
+    size_t capacity);
+
+
+extern void hmap_chained_init(struct hmap_table * table);
+extern void hmap_chained_cleanup(struct hmap_table * table);
+extern void * hmap_chained_find(struct hmap_table * table, size_t hash, void const * key);
+extern void hmap_chained_prefetch(struct hmap_table const * table, size_t hash);
+extern void * hmap_chained_insert(struct hmap_table * table, size_t hash, void const * key, bool * created);
+extern bool hmap_chained_remove(struct hmap_table * table, size_t hash, void const * key);
+extern bool hmap_chained_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_chained_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_chained_resize(struct hmap_table * table, size_t bucket_count);
+extern enum hmap_table_place hmap_chained_place(struct hmap_table * table, struct hmap_table_bulk const * bulk, size_t index, size_t hash, size_t end, void * node, void ** entry);
+extern void hmap_chained_getstats(struct hmap_table * table, struct hmap_stats * stats);
+
+extern void hmap_open_init(struct hmap_table * table);
+extern void hmap_open_cleanup(struct hmap_table * table);
+extern void * hmap_open_find(struct hmap_table * table, size_t hash, void const * key);
+extern void hmap_open_prefetch(struct hmap_table const * table, size_t hash);
+extern void * hmap_open_insert(struct hmap_table * table, size_t hash, void const * key, bool * created);
+extern bool hmap_open_remove(struct hmap_table * table, size_t hash, void const * key);
+extern bool hmap_open_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_open_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_open_resize(struct hmap_table * table, size_t bucket_count);
+extern enum hmap_table_place hmap_open_place(struct hmap_table * table, struct hmap_table_bulk const * bulk, size_t index, size_t hash, size_t end, void * node, void ** entry);
+extern void hmap_open_getstats(struct hmap_table * table, struct hmap_stats * stats);
+
+extern void hmap_dense_init(struct hmap_table * table);
+extern void hmap_dense_cleanup(struct hmap_table * table);
+extern void * hmap_dense_find(struct hmap_table * table, size_t hash, void const * key);
+extern void hmap_dense_prefetch(struct hmap_table const * table, size_t hash);
+extern void * hmap_dense_insert(struct hmap_table * table, size_t hash, void const * key, bool * created);
+extern bool hmap_dense_remove(struct hmap_table * table, size_t hash, void const * key);
+extern bool hmap_dense_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_dense_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry);
+extern void hmap_dense_resize(struct hmap_table * table, size_t bucket_count);
+extern enum hmap_table_place hmap_dense_place(struct hmap_table * table, struct hmap_table_bulk const * bulk, size_t index, size_t hash, size_t end, void * node, void ** entry);
+extern void hmap_dense_getstats(struct hmap_table * table, struct hmap_stats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table.h"
+#include "hmap/detail/probe.h"
+#include "hmap/allocator.h"
+#include "hmap/parallel.h"
+#include <stdint.h>
+
+// Parallel bulk build.
+//
+// Partitions are contiguous ranges of buckets. A bulk build runs in
+// four phases:
+//
+// 1. Keys are hashed in parallel; each thread hashes a contiguous
+//    slice of the items and counts its items per partition.
+// 2. Items are sorted by partition (stable counting sort); each
+//    thread scatters its own slice.
+// 3. Each partition is filled by one thread. An item whose probe
+//    sequence reaches the end of its partition is deferred, since
+//    the following buckets belong to another partition.
+// 4. The calling thread inserts deferred items and passes items of
+//    found keys to replace, both in the order of their indices.
+//
+// All engines place an entry at or behind its home bucket
+// (see hmap_table_gethome), so items of equal keys share their
+// partition and are placed in the order of their indices. Once an
+// item is deferred, later items of the same key are deferred as well,
+// since the buckets they probe stay occupied.
+
+#define HMAP_BULK_MIN_PARTITION_SIZE 1024
+#define HMAP_BULK_PARTITIONS_PER_THREAD 4
+#define HMAP_BULK_FOUND (((size_t) 1) << ((sizeof(size_t) * 8) - 1))
+
+struct hmap_bulk_build
+{
+    struct hmap_table * table;
+    struct hmap_table_bulk const * bulk;
+    size_t thread_count;
+    size_t partition_count;
+    size_t partition_size;
+
+    size_t * hashes;            // hash of each item; entry of items with found keys
+    size_t * order;             // items sorted by partition
+    size_t * offsets;           // item counts per thread and partition, then positions in order
+    size_t * begins;            // first position of each partition in order
+    size_t * special_ends;      // end of the deferred and found items at the begin of each partition
+    size_t * created;           // entries created per partition
+    unsigned char * nodes;      // nodes of the chained engine; one per item
+    size_t next_partition;
+};
+
+static size_t hmap_bulk_slice(
+    struct hmap_bulk_build const * build,
+    size_t thread_id)
+{
+    return hmap_parallel_slice(build->bulk->count, build->thread_count, thread_id);
+}
+
+static inline size_t hmap_bulk_partition(
+    struct hmap_bulk_build const * build,
+    size_t hash)
+{
+    return hmap_table_gethome(hash, build->table->bucket_count) / build->partition_size;
+}
+
+static enum hmap_table_place hmap_bulk_place(
+    struct hmap_table * table,
+    struct hmap_table_bulk const * bulk,
+    size_t index,
+    size_t hash,
+    size_t end,
+    void * node,
+    void ** entry)
+{
+    switch (table->engine)
+    {
+        case HMAP_ENGINE_DENSE:
+            return hmap_dense_place(table, bulk, index, hash, end, node, entry);
+        case HMAP_ENGINE_OPEN:
+            return hmap_open_place(table, bulk, index, hash, end, node, entry);
+        case HMAP_ENGINE_CHAINED:
+            // fall-through
+        default:
+            return hmap_chained_place(table, bulk, index, hash, end, node, entry);
+    }
+}
+
+static void hmap_bulk_hash(
+    size_t thread_id,
+    void * context)
+{
+    struct hmap_bulk_build * build = context;
+    struct hmap_table_bulk const * bulk = build->bulk;
+    size_t * counts = &(build->offsets[thread_id * build->partition_count]);
+
+    size_t end = hmap_bulk_slice(build, thread_id + 1);
+    for (size_t i = hmap_bulk_slice(build, thread_id); i < end; i++)
+    {
+        size_t hash = bulk->hash(i, bulk->context);
+        build->hashes[i] = hash;
+        counts[hmap_bulk_partition(build, hash)]++;
+    }
+}
+
+static void hmap_bulk_scatter(
+    size_t thread_id,
+    void * context)
+{
+    struct hmap_bulk_build * build = context;
+    size_t * offsets = &(build->offsets[thread_id * build->partition_count]);
+
+    size_t end = hmap_bulk_slice(build, thread_id + 1);
+    for (size_t i = hmap_bulk_slice(build, thread_id); i < end; i++)
+    {
+        size_t partition = hmap_bulk_partition(build, build->hashes[i]);
+        build->order[offsets[partition]] = i;
+        offsets[partition]++;
+    }
+}
+
+static void hmap_bulk_fill(
+    struct hmap_bulk_build * build,
+    size_t partition)
+{
+    struct hmap_table * table = build->table;
+    struct hmap_table_bulk const * bulk = build->bulk;
+    size_t end = (partition + 1) * build->partition_size;
+    size_t begin = build->begins[partition];
+    size_t special_end = begin;
+    size_t created = 0;
+
+    for (size_t position = begin; position < build->begins[partition + 1]; position++)
+    {
+        size_t index = build->order[position];
+        void * node = (NULL != build->nodes) ? &(build->nodes[(begin + created) * table->nodes.node_size]) : NULL;
+        void * entry = NULL;
+
+        // deferred and found items are collected at the begin of the partition,
+        // which is already processed
+        switch (hmap_bulk_place(table, bulk, index, build->hashes[index], end, node, &entry))
+        {
+            case HMAP_TABLE_PLACE_CREATED:
+                bulk->store(index, entry, bulk->context);
+                created++;
+                break;
+            case HMAP_TABLE_PLACE_FOUND:
+                build->hashes[index] = (size_t) (uintptr_t) entry;
+                build->order[special_end] = index | HMAP_BULK_FOUND;
+                special_end++;
+                break;
+            case HMAP_TABLE_PLACE_DEFERRED:
+                // fall-through
+            default:
+                build->order[special_end] = index;
+                special_end++;
+                break;
+        }
+    }
+
+    build->special_ends[partition] = special_end;
+    build->created[partition] = created;
+}
+
+static void hmap_bulk_place_partitions(
+    size_t thread_id,
+    void * context)
+{
+    (void) thread_id;
+    struct hmap_bulk_build * build = context;
+
+    size_t partition = __atomic_fetch_add(&(build->next_partition), 1, __ATOMIC_RELAXED);
+    while (partition < build->partition_count)
+    {
+        hmap_bulk_fill(build, partition);
+        partition = __atomic_fetch_add(&(build->next_partition), 1, __ATOMIC_RELAXED);
+    }
+}
+
+/// Inserts deferred items and replaces found entries in the calling thread.
+static size_t hmap_bulk_finish(
+    struct hmap_bulk_build * build,
+    size_t partition)
+{
+    struct hmap_table * table = build->table;
+    struct hmap_table_bulk const * bulk = build->bulk;
+    size_t created = 0;
+
+    for (size_t position = build->begins[partition]; position < build->special_ends[partition]; position++)
+    {
+        size_t index = build->order[position] & ~HMAP_BULK_FOUND;
+        void * entry = (void *) (uintptr_t) build->hashes[index];
+        enum hmap_table_place place = HMAP_TABLE_PLACE_FOUND;
+
+        // deferred items may probe any bucket now; the chained engine never defers
+        if (0 == (build->order[position] & HMAP_BULK_FOUND))
+        {
+            place = hmap_bulk_place(table, bulk, index, build->hashes[index], SIZE_MAX, NULL, &entry);
+        }
+
+        if (HMAP_TABLE_PLACE_CREATED == place)
+        {
+            bulk->store(index, entry, bulk->context);
+            created++;
+        }
+        else
+        {
+            bulk->replace(index, entry, bulk->context);
+        }
+    }
+
+    // return unused nodes to the pool
+    if (NULL != build->nodes)
+    {
+        size_t end = build->begins[partition + 1];
+        for (size_t i = build->begins[partition] + build->created[partition]; i < end; i++)
+        {
+            hmap_slab_free(&(table->nodes), &(build->nodes[i * table->nodes.node_size]));
+        }
+    }
+
+    return build->created[partition] + created;
+}
+
+void hmap_table_build(
+    struct hmap_table * table,
+    struct hmap_table_bulk const * bulk,
+    size_t thread_count)
+{
+    hmap_table_reserve(table, bulk->count);
+    if (0 == bulk->count)
+    {
+        return;
+    }
+
+    struct hmap_allocator const * allocator = &(table->allocator);
+    struct hmap_bulk_build build;
+    build.table = table;
+    build.bulk = bulk;
+
+    // partitions are large enough that few probe sequences leave them
+    size_t max_partitions = table->bucket_count / HMAP_BULK_MIN_PARTITION_SIZE;
+    max_partitions = (0 < max_partitions) ? max_partitions : 1;
+    build.thread_count = hmap_parallel_getthreadcount(thread_count);
+    build.thread_count = (build.thread_count < max_partitions) ? build.thread_count : max_partitions;
+    build.partition_count = 1;
+    while ((build.partition_count < (build.thread_count * HMAP_BULK_PARTITIONS_PER_THREAD)) &&
+        (build.partition_count < max_partitions))
+    {
+        build.partition_count *= 2;
+    }
+    build.partition_size = table->bucket_count / build.partition_count;
+
+    size_t count = bulk->count;
+    size_t partition_count = build.partition_count;
+    build.hashes = hmap_allocator_alloc(allocator, count * sizeof(size_t));
+    build.order = hmap_allocator_alloc(allocator, count * sizeof(size_t));
+    build.offsets = hmap_allocator_calloc(allocator, build.thread_count * partition_count * sizeof(size_t));
+    build.begins = hmap_allocator_alloc(allocator, (partition_count + 1) * sizeof(size_t));
+    build.special_ends = hmap_allocator_alloc(allocator, partition_count * sizeof(size_t));
+    build.created = hmap_allocator_alloc(allocator, partition_count * sizeof(size_t));
+    build.nodes = (HMAP_ENGINE_CHAINED == table->engine) ? hmap_slab_alloc_n(&(table->nodes), allocator, count) : NULL;
+    build.next_partition = 0;
+
+    hmap_parallel_run(allocator, build.thread_count, &hmap_bulk_hash, &build);
+
+    // each thread scatters its slice behind the slices of lower threads
+    size_t position = 0;
+    for (size_t partition = 0; partition < partition_count; partition++)
+    {
+        build.begins[partition] = position;
+        for (size_t i = 0; i < build.thread_count; i++)
+        {
+            size_t * offset = &(build.offsets[(i * partition_count) + partition]);
+            size_t items = *offset;
+            *offset = position;
+            position += items;
+        }
+    }
+    build.begins[partition_count] = position;
+
+    hmap_parallel_run(allocator, build.thread_count, &hmap_bulk_scatter, &build);
+    hmap_parallel_run(allocator, build.thread_count, &hmap_bulk_place_partitions, &build);
+
+    for (size_t partition = 0; partition < partition_count; partition++)
+    {
+        table->entry_count += hmap_bulk_finish(&build, partition);
+    }
+
+    // items of the dense engine are stored at their index
+    if (HMAP_ENGINE_DENSE == table->engine)
+    {
+        table->item_count = count;
+        while ((0 < table->item_count) && (HMAP_CTRL_EMPTY == table->item_ctrl[table->item_count - 1]))
+        {
+            table->item_count--;
+        }
+    }
+
+    hmap_allocator_free(allocator, build.created, partition_count * sizeof(size_t));
+    hmap_allocator_free(allocator, build.special_ends, partition_count * sizeof(size_t));
+    hmap_allocator_free(allocator, build.begins, (partition_count + 1) * sizeof(size_t));
+    hmap_allocator_free(allocator, build.offsets, build.thread_count * partition_count * sizeof(size_t));
+    hmap_allocator_free(allocator, build.order, count * sizeof(size_t));
+    hmap_allocator_free(allocator, build.hashes, count * sizeof(size_t));
+}
@@ -0,0 +1,455 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table.h"
+#include "hmap/allocator.h"
+#include "hmap/parallel.h"
+#include <string.h>
+
+// Separate chaining.
+//
+// When the table grows, the current buckets become the old buckets
+// and entries are moved bucket by bucket into the new buckets. By
+// default, all buckets are moved at once. In incremental mode, each
+// insert and remove moves HMAP_CHAINED_REHASH_STEP buckets, so
+// lookups consult both, the new and the old buckets, until all
+// entries are moved. Lookups themselves never move entries, so the
+// table can be read during iteration.
+//
+// Nodes are allocated from a slab pool owned by the table. Slabs are
+// only released with the pool, so when the table shrinks, all nodes
+// are copied into a new pool and the old pool is released.
+//
+// When all buckets are moved at once, the old buckets can be split
+// across rehash_threads threads. Home buckets are taken from the top
+// bits of the mixed hash (see hmap_table_gethome), so all entries of
+// old bucket i are moved to new buckets j with i / (old / n) equal to
+// j / (new / n), where n is the smaller bucket count. Threads moving
+// disjoint ranges of old buckets aligned to old / n never touch the
+// same new bucket.
+
+#define HMAP_CHAINED_REHASH_STEP 4
+#define HMAP_CHAINED_PARALLEL_MIN_BUCKETS 65536
+
+/// Node of a bucket chain.
+///
+/// The entry is stored directly behind the node.
+struct hmap_chained_node
+{
+    struct hmap_chained_node * next;
+    size_t hash;
+};
+
+#define HMAP_CHAINED_ENTRY(node) ((void *) ((node) + 1))
+#define HMAP_CHAINED_NODE(entry) (((struct hmap_chained_node *) (entry)) - 1)
+
+/// Puts the entries of an old bucket into the new buckets.
+static void hmap_chained_movebucket(
+    struct hmap_table * table,
+    size_t old_bucket_id)
+{
+    struct hmap_chained_node ** old_buckets = table->old_buckets;
+    struct hmap_chained_node ** buckets = table->buckets;
+
+    struct hmap_chained_node * node = old_buckets[old_bucket_id];
+    while (NULL != node)
+    {
+        struct hmap_chained_node * next = node->next;
+        size_t bucket_id = hmap_table_gethome(node->hash, table->bucket_count);
+
+        node->next = buckets[bucket_id];
+        buckets[bucket_id] = node;
+
+        node = next;
+    }
+    old_buckets[old_bucket_id] = NULL;
+}
+
+struct hmap_chained_move
+{
+    struct hmap_table * table;
+    size_t thread_count;
+};
+
+static void hmap_chained_moveslice(
+    size_t thread_id,
+    void * context)
+{
+    struct hmap_chained_move * move = context;
+    struct hmap_table * table = move->table;
+    size_t groups = (table->old_bucket_count < table->bucket_count) ? table->old_bucket_count : table->bucket_count;
+    size_t group_size = table->old_bucket_count / groups;
+
+    size_t end = hmap_parallel_slice(groups, move->thread_count, thread_id + 1) * group_size;
+    for (size_t i = hmap_parallel_slice(groups, move->thread_count, thread_id) * group_size; i < end; i++)
+    {
+        hmap_chained_movebucket(table, i);
+    }
+}
+
+static void hmap_chained_migrate(
+    struct hmap_table * table,
+    size_t count)
+{
+    size_t end = table->rehash_id + count;
+    if (end > table->old_bucket_count)
+    {
+        end = table->old_bucket_count;
+    }
+
+    size_t thread_count = (1 != table->rehash_threads) ? hmap_parallel_getthreadcount(table->rehash_threads) : 1;
+    if ((1 < thread_count) && (0 == table->rehash_id) && (end == table->old_bucket_count) &&
+        (HMAP_CHAINED_PARALLEL_MIN_BUCKETS <= table->old_bucket_count))
+    {
+        // move all buckets at once using multiple threads
+        struct hmap_chained_move move = { table, thread_count };
+        hmap_parallel_run(&(table->allocator), thread_count, &hmap_chained_moveslice, &move);
+        table->rehash_id = end;
+    }
+
+    // put entries into new buckets
+    for (; table->rehash_id < end; table->rehash_id++)
+    {
+        hmap_chained_movebucket(table, table->rehash_id);
+    }
+
+    // release old buckets when all entries are moved
+    if (table->rehash_id == table->old_bucket_count)
+    {
+        hmap_allocator_free(&(table->allocator), table->old_buckets, table->old_bucket_count * sizeof(struct hmap_chained_node *));
+        table->old_buckets = NULL;
+        table->old_bucket_count = 0;
+        table->rehash_id = 0;
+    }
+}
+
+static void hmap_chained_rehash(
+    struct hmap_table * table,
+    size_t new_bucket_count,
+    bool incremental)
+{
+    // finish pending migration
+    if (NULL != table->old_buckets)
+    {
+        hmap_chained_migrate(table, table->old_bucket_count);
+    }
+
+    // create new buckets
+    table->rehash_count++;
+    table->old_buckets = table->buckets;
+    table->old_bucket_count = table->bucket_count;
+    table->rehash_id = 0;
+    table->bucket_count = new_bucket_count;
+    table->threshold = hmap_table_getthreshold(table, new_bucket_count);
+    table->buckets = hmap_allocator_calloc(&(table->allocator), new_bucket_count * sizeof(struct hmap_chained_node *));
+
+    if (!incremental)
+    {
+        hmap_chained_migrate(table, table->old_bucket_count);
+    }
+}
+
+static struct hmap_chained_node ** hmap_chained_findinbucket(
+    struct hmap_table * table,
+    struct hmap_chained_node ** link,
+    size_t hash,
+    void const * key)
+{
+    while (NULL != *link)
+    {
+        struct hmap_chained_node * node = *link;
+        if (hash == node->hash)
+        {
+            HMAP_STATS_INC(table->comparisons);
+            if (table->match(key, HMAP_CHAINED_ENTRY(node), table->context))
+            {
+                break;
+            }
+        }
+        link = &(node->next);
+    }
+
+    return (NULL != *link) ? link : NULL;
+}
+
+/// Returns the link pointing to the node of \arg key or NULL, if \arg key is not stored.
+static struct hmap_chained_node ** hmap_chained_findlink(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key)
+{
+    struct hmap_chained_node ** buckets = table->buckets;
+    struct hmap_chained_node ** link = hmap_chained_findinbucket(table, &(buckets[hmap_table_gethome(hash, table->bucket_count)]), hash, key);
+
+    if ((NULL == link) && (NULL != table->old_buckets))
+    {
+        // old buckets before rehash_id are already moved
+        struct hmap_chained_node ** old_buckets = table->old_buckets;
+        size_t old_bucket_id = hmap_table_gethome(hash, table->old_bucket_count);
+        if (old_bucket_id >= table->rehash_id)
+        {
+            link = hmap_chained_findinbucket(table, &(old_buckets[old_bucket_id]), hash, key);
+        }
+    }
+
+    return link;
+}
+
+static void hmap_chained_releasebuckets(
+    struct hmap_table * table,
+    struct hmap_chained_node ** buckets,
+    size_t bucket_count)
+{
+    // nodes are freed with their slabs
+    if (NULL != table->release)
+    {
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            struct hmap_chained_node * node = buckets[i];
+            while (NULL != node)
+            {
+                table->release(HMAP_CHAINED_ENTRY(node), table->context);
+                node = node->next;
+            }
+        }
+    }
+
+    hmap_allocator_free(&(table->allocator), buckets, bucket_count * sizeof(struct hmap_chained_node *));
+}
+
+/// Copies all nodes into a new pool, so that slabs of removed nodes are released.
+static void hmap_chained_compactnodes(
+    struct hmap_table * table)
+{
+    struct hmap_slab_pool old_nodes = table->nodes;
+    hmap_slab_init(&(table->nodes), old_nodes.node_size);
+
+    if (0 < table->entry_count)
+    {
+        unsigned char * nodes = hmap_slab_alloc_n(&(table->nodes), &(table->allocator), table->entry_count);
+        struct hmap_chained_node ** buckets = table->buckets;
+        for (size_t i = 0; i < table->bucket_count; i++)
+        {
+            struct hmap_chained_node ** link = &(buckets[i]);
+            while (NULL != *link)
+            {
+                struct hmap_chained_node * node = (struct hmap_chained_node *) nodes;
+                memcpy(node, *link, old_nodes.node_size);
+                *link = node;
+                link = &(node->next);
+                nodes += old_nodes.node_size;
+            }
+        }
+    }
+
+    hmap_slab_cleanup(&old_nodes, &(table->allocator));
+}
+
+void hmap_chained_resize(struct hmap_table * table, size_t bucket_count)
+{
+    bool shrink = (bucket_count < table->bucket_count);
+    hmap_chained_rehash(table, bucket_count, false);
+
+    if (shrink)
+    {
+        hmap_chained_compactnodes(table);
+    }
+}
+
+void hmap_chained_init(struct hmap_table * table)
+{
+    hmap_slab_init(&(table->nodes), sizeof(struct hmap_chained_node) + table->entry_size);
+    table->buckets = hmap_allocator_calloc(&(table->allocator), table->bucket_count * sizeof(struct hmap_chained_node *));
+}
+
+void hmap_chained_cleanup(struct hmap_table * table)
+{
+    hmap_chained_releasebuckets(table, table->buckets, table->bucket_count);
+    if (NULL != table->old_buckets)
+    {
+        hmap_chained_releasebuckets(table, table->old_buckets, table->old_bucket_count);
+    }
+
+    hmap_slab_cleanup(&(table->nodes), &(table->allocator));
+}
+
+void * hmap_chained_find(struct hmap_table * table, size_t hash, void const * key)
+{
+    struct hmap_chained_node ** link = hmap_chained_findlink(table, hash, key);
+    return (NULL != link) ? HMAP_CHAINED_ENTRY(*link) : NULL;
+}
+
+void hmap_chained_prefetch(struct hmap_table const * table, size_t hash)
+{
+    struct hmap_chained_node * const * buckets = table->buckets;
+    HMAP_PREFETCH(&(buckets[hmap_table_gethome(hash, table->bucket_count)]));
+}
+
+void * hmap_chained_insert(struct hmap_table * table, size_t hash, void const * key, bool * created)
+{
+    if (NULL != table->old_buckets)
+    {
+        hmap_chained_migrate(table, HMAP_CHAINED_REHASH_STEP);
+    }
+
+    if (table->entry_count > table->threshold)
+    {
+        hmap_chained_rehash(table, 2 * table->bucket_count, table->incremental);
+    }
+
+    void * entry = hmap_chained_find(table, hash, key);
+    *created = (NULL == entry);
+
+    if (*created)
+    {
+        struct hmap_chained_node ** bucket = &(((struct hmap_chained_node **) table->buckets)[hmap_table_gethome(hash, table->bucket_count)]);
+        struct hmap_chained_node * node = hmap_slab_alloc(&(table->nodes), &(table->allocator));
+        node->next = *bucket;
+        node->hash = hash;
+        *bucket = node;
+
+        table->entry_count++;
+        entry = HMAP_CHAINED_ENTRY(node);
+    }
+
+    return entry;
+}
+
+enum hmap_table_place hmap_chained_place(struct hmap_table * table, struct hmap_table_bulk const * bulk,
+    size_t index, size_t hash, size_t end, void * node, void ** entry)
+{
+    (void) end;
+
+    // buckets are never shared between partitions, so items are never deferred
+    struct hmap_chained_node ** bucket = &(((struct hmap_chained_node **) table->buckets)[hmap_table_gethome(hash, table->bucket_count)]);
+    for (struct hmap_chained_node * current = *bucket; NULL != current; current = current->next)
+    {
+        if ((hash == current->hash) && (bulk->match(index, HMAP_CHAINED_ENTRY(current), bulk->context)))
+        {
+            *entry = HMAP_CHAINED_ENTRY(current);
+            return HMAP_TABLE_PLACE_FOUND;
+        }
+    }
+
+    struct hmap_chained_node * new_node = node;
+    new_node->next = *bucket;
+    new_node->hash = hash;
+    *bucket = new_node;
+
+    *entry = HMAP_CHAINED_ENTRY(new_node);
+    return HMAP_TABLE_PLACE_CREATED;
+}
+
+bool hmap_chained_remove(struct hmap_table * table, size_t hash, void const * key)
+{
+    if (NULL != table->old_buckets)
+    {
+        hmap_chained_migrate(table, HMAP_CHAINED_REHASH_STEP);
+    }
+
+    struct hmap_chained_node ** link = hmap_chained_findlink(table, hash, key);
+    if (NULL != link)
+    {
+        struct hmap_chained_node * node = *link;
+        if (NULL != table->release)
+        {
+            table->release(HMAP_CHAINED_ENTRY(node), table->context);
+        }
+        *link = node->next;
+        hmap_slab_free(&(table->nodes), node);
+
+        table->entry_count--;
+    }
+
+    return (NULL != link);
+}
+
+bool hmap_chained_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    (void) start;
+
+    // old buckets (if any) are visited before the current buckets
+    struct hmap_chained_node ** old_buckets = table->old_buckets;
+    struct hmap_chained_node ** buckets = table->buckets;
+    size_t bucket_count = table->old_bucket_count + table->bucket_count;
+    struct hmap_chained_node * node = NULL;
+
+    if (NULL != *entry)
+    {
+        node = HMAP_CHAINED_NODE(*entry)->next;
+        if (NULL == node)
+        {
+            (*bucket_id)++;
+        }
+    }
+
+    while ((NULL == node) && (*bucket_id < bucket_count))
+    {
+        node = (*bucket_id < table->old_bucket_count) ?
+            old_buckets[*bucket_id] : buckets[*bucket_id - table->old_bucket_count];
+        if (NULL == node)
+        {
+            (*bucket_id)++;
+        }
+    }
+
+    *entry = (NULL != node) ? HMAP_CHAINED_ENTRY(node) : NULL;
+    return (NULL != node);
+}
+
+void hmap_chained_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    (void) start;
+
+    // no entries are migrated, since this would change the order of iteration
+    struct hmap_chained_node ** old_buckets = table->old_buckets;
+    struct hmap_chained_node ** buckets = table->buckets;
+    struct hmap_chained_node ** link = (*bucket_id < table->old_bucket_count) ?
+        &(old_buckets[*bucket_id]) : &(buckets[*bucket_id - table->old_bucket_count]);
+    struct hmap_chained_node * node = HMAP_CHAINED_NODE(*entry);
+    struct hmap_chained_node * previous = NULL;
+    while (node != *link)
+    {
+        previous = *link;
+        link = &(previous->next);
+    }
+
+    if (NULL != table->release)
+    {
+        table->release(*entry, table->context);
+    }
+    *link = node->next;
+    hmap_slab_free(&(table->nodes), node);
+    table->entry_count--;
+
+    // continue at the predecessor or at the head of the bucket
+    *entry = (NULL != previous) ? HMAP_CHAINED_ENTRY(previous) : NULL;
+}
+
+static void hmap_chained_addprobes(
+    struct hmap_chained_node * const * buckets,
+    size_t bucket_count,
+    struct hmap_stats * stats)
+{
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        size_t probe_length = 0;
+        for (struct hmap_chained_node const * node = buckets[i]; NULL != node; node = node->next)
+        {
+            probe_length++;
+            hmap_table_addprobe(stats, probe_length);
+        }
+    }
+}
+
+void hmap_chained_getstats(struct hmap_table * table, struct hmap_stats * stats)
+{
+    stats->bytes_allocated = (table->bucket_count + table->old_bucket_count) * sizeof(struct hmap_chained_node *);
+    stats->bytes_allocated += table->nodes.size;
+
+    hmap_chained_addprobes(table->buckets, table->bucket_count, stats);
+    if (NULL != table->old_buckets)
+    {
+        hmap_chained_addprobes(table->old_buckets, table->old_bucket_count, stats);
+    }
+}
@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table.h"
+#include "hmap/detail/probe.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+// Dense entry array with a separate index.
+//
+// Entries are appended to a contiguous array of items in insertion
+// order. The buckets form an index of linear probing slots, each
+// storing the id of an item. Indices are as small as the number of
+// items permits (1, 2, 4 or 8 bytes), so the index is much smaller
+// than a slot array of the open addressing engine. The index is
+// probed like the slots of the open addressing engine: using control
+// bytes a group at a time, so items are only read when their hash
+// fragment matches.
+//
+// Removed items leave a hole, which is marked by HMAP_CTRL_EMPTY in
+// the control bytes of the items, so iteration skips holes a group
+// at a time. Holes are reclaimed when the item array is full or the
+// table is resized; both rebuild the index and keep the order of the
+// remaining items. Removals use backward-shift deletion in the index.
+//
+// The item array has room for threshold / 2 + 1 items beyond the
+// threshold. Since the table grows before the entry count exceeds the
+// threshold, a full item array always holds more than threshold / 2
+// holes (at least 1 / 3 of its items), so it is compacted in place.
+// A rebuild is amortized over as many removals as it moves items.
+//
+// Each item stores the hash of its entry followed by the entry.
+
+#define HMAP_DENSE_ITEMSIZE(table) (sizeof(size_t) + (table)->entry_size)
+#define HMAP_DENSE_ITEM(table, id) ((size_t *) ((table)->items + ((id) * HMAP_DENSE_ITEMSIZE(table))))
+#define HMAP_DENSE_ENTRY(item) ((void *) ((item) + 1))
+
+static size_t hmap_dense_getindexwidth(
+    size_t item_capacity)
+{
+    if (item_capacity <= ((size_t) UINT8_MAX) + 1)
+    {
+        return sizeof(uint8_t);
+    }
+    else if (item_capacity <= ((size_t) UINT16_MAX) + 1)
+    {
+        return sizeof(uint16_t);
+    }
+    else if (item_capacity <= ((size_t) UINT32_MAX))
+    {
+        return sizeof(uint32_t);
+    }
+
+    return sizeof(size_t);
+}
+
+static inline size_t hmap_dense_getindex(
+    struct hmap_table const * table,
+    size_t id)
+{
+    switch (table->index_width)
+    {
+        case sizeof(uint8_t):
+            return ((uint8_t const *) table->buckets)[id];
+        case sizeof(uint16_t):
+            return ((uint16_t const *) table->buckets)[id];
+        case sizeof(uint32_t):
+            return ((uint32_t const *) table->buckets)[id];
+        default:
+            return ((size_t const *) table->buckets)[id];
+    }
+}
+
+static inline void hmap_dense_setindex(
+    struct hmap_table * table,
+    size_t id,
+    size_t value)
+{
+    switch (table->index_width)
+    {
+        case sizeof(uint8_t):
+            ((uint8_t *) table->buckets)[id] = (uint8_t) value;
+            break;
+        case sizeof(uint16_t):
+            ((uint16_t *) table->buckets)[id] = (uint16_t) value;
+            break;
+        case sizeof(uint32_t):
+            ((uint32_t *) table->buckets)[id] = (uint32_t) value;
+            break;
+        default:
+            ((size_t *) table->buckets)[id] = value;
+            break;
+    }
+}
+
+/// Probes for \arg key starting at its home slot.
+///
+/// \return Id of the index slot referencing \arg key or the id of the
+///         first empty index slot, if \arg key is not found.
+static size_t hmap_dense_probe(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key,
+    bool * found)
+{
+    struct hmap_probe probe;
+    hmap_probe_start(&probe, table->ctrl, table->bucket_count, hash);
+
+    size_t id = 0;
+    while (hmap_probe_next(&probe, table->ctrl, &id))
+    {
+        size_t * item = HMAP_DENSE_ITEM(table, hmap_dense_getindex(table, id));
+        if (hash == *item)
+        {
+            HMAP_STATS_INC(table->comparisons);
+            if (table->match(key, HMAP_DENSE_ENTRY(item), table->context))
+            {
+                *found = true;
+                return id;
+            }
+        }
+    }
+
+    *found = false;
+    return id;
+}
+
+static void hmap_dense_freeitems(
+    struct hmap_table * table)
+{
+    hmap_allocator_free(&(table->allocator), table->buckets, table->bucket_count * table->index_width);
+    hmap_allocator_free(&(table->allocator), table->ctrl, table->bucket_count + HMAP_GROUP_WIDTH);
+    hmap_allocator_free(&(table->allocator), table->items, table->item_capacity * HMAP_DENSE_ITEMSIZE(table));
+    hmap_allocator_free(&(table->allocator), table->item_ctrl, table->item_capacity + HMAP_GROUP_WIDTH);
+}
+
+/// Creates item storage and index for \arg bucket_count buckets.
+static void hmap_dense_allocate(
+    struct hmap_table * table,
+    size_t bucket_count)
+{
+    table->bucket_count = bucket_count;
+    table->threshold = hmap_table_getthreshold(table, bucket_count);
+    table->item_capacity = table->threshold + (table->threshold / 2) + 1;
+    table->item_count = 0;
+    table->index_width = hmap_dense_getindexwidth(table->item_capacity);
+
+    table->buckets = hmap_allocator_alloc(&(table->allocator), bucket_count * table->index_width);
+    table->ctrl = hmap_allocator_alloc(&(table->allocator), bucket_count + HMAP_GROUP_WIDTH);
+    memset(table->ctrl, HMAP_CTRL_EMPTY, bucket_count + HMAP_GROUP_WIDTH);
+    table->items = hmap_allocator_alloc(&(table->allocator), table->item_capacity * HMAP_DENSE_ITEMSIZE(table));
+    table->item_ctrl = hmap_allocator_alloc(&(table->allocator), table->item_capacity + HMAP_GROUP_WIDTH);
+    memset(table->item_ctrl, HMAP_CTRL_EMPTY, table->item_capacity + HMAP_GROUP_WIDTH);
+}
+
+/// Rebuilds the table with \arg bucket_count buckets, removing all holes.
+static void hmap_dense_rebuild(
+    struct hmap_table * table,
+    size_t bucket_count)
+{
+    if (bucket_count != table->bucket_count)
+    {
+        table->rehash_count++;
+    }
+
+    struct hmap_table old = *table;
+    hmap_dense_allocate(table, bucket_count);
+
+    size_t item_size = HMAP_DENSE_ITEMSIZE(table);
+    for (size_t i = 0; i < old.item_count; i++)
+    {
+        if (HMAP_CTRL_EMPTY != old.item_ctrl[i])
+        {
+            size_t * item = HMAP_DENSE_ITEM(&old, i);
+            size_t id = hmap_probe_findempty(table->ctrl, bucket_count, hmap_table_gethome(*item, bucket_count));
+
+            // fragments depend on the bucket count
+            unsigned char fragment = hmap_table_getfragment(*item, bucket_count);
+            memcpy(HMAP_DENSE_ITEM(table, table->item_count), item, item_size);
+            table->item_ctrl[table->item_count] = fragment;
+            hmap_probe_setctrl(table->ctrl, bucket_count, id, fragment);
+            hmap_dense_setindex(table, id, table->item_count);
+            table->item_count++;
+        }
+    }
+
+    hmap_dense_freeitems(&old);
+}
+
+void hmap_dense_resize(struct hmap_table * table, size_t bucket_count)
+{
+    hmap_dense_rebuild(table, bucket_count);
+}
+
+void hmap_dense_init(struct hmap_table * table)
+{
+    hmap_dense_allocate(table, table->bucket_count);
+}
+
+void hmap_dense_cleanup(struct hmap_table * table)
+{
+    if (NULL != table->release)
+    {
+        for (size_t i = 0; i < table->item_count; i++)
+        {
+            if (HMAP_CTRL_EMPTY != table->item_ctrl[i])
+            {
+                table->release(HMAP_DENSE_ENTRY(HMAP_DENSE_ITEM(table, i)), table->context);
+            }
+        }
+    }
+
+    hmap_dense_freeitems(table);
+}
+
+void * hmap_dense_find(struct hmap_table * table, size_t hash, void const * key)
+{
+    bool found = false;
+    size_t id = hmap_dense_probe(table, hash, key, &found);
+
+    return found ? HMAP_DENSE_ENTRY(HMAP_DENSE_ITEM(table, hmap_dense_getindex(table, id))) : NULL;
+}
+
+void hmap_dense_prefetch(struct hmap_table const * table, size_t hash)
+{
+    size_t id = hmap_table_gethome(hash, table->bucket_count);
+    HMAP_PREFETCH(&(table->ctrl[id]));
+    HMAP_PREFETCH(&(((unsigned char const *) table->buckets)[id * table->index_width]));
+}
+
+void * hmap_dense_insert(struct hmap_table * table, size_t hash, void const * key, bool * created)
+{
+    if (table->entry_count > table->threshold)
+    {
+        hmap_dense_rebuild(table, 2 * table->bucket_count);
+    }
+    else if (table->item_count == table->item_capacity)
+    {
+        // entry_count <= threshold, so more than threshold / 2 items are holes
+        hmap_dense_rebuild(table, table->bucket_count);
+    }
+
+    bool found = false;
+    size_t id = hmap_dense_probe(table, hash, key, &found);
+    *created = !found;
+
+    if (found)
+    {
+        return HMAP_DENSE_ENTRY(HMAP_DENSE_ITEM(table, hmap_dense_getindex(table, id)));
+    }
+
+    size_t item_id = table->item_count;
+    size_t * item = HMAP_DENSE_ITEM(table, item_id);
+    *item = hash;
+    unsigned char fragment = hmap_table_getfragment(hash, table->bucket_count);
+    table->item_ctrl[item_id] = fragment;
+    hmap_probe_setctrl(table->ctrl, table->bucket_count, id, fragment);
+    hmap_dense_setindex(table, id, item_id);
+    table->item_count++;
+    table->entry_count++;
+
+    return HMAP_DENSE_ENTRY(item);
+}
+
+enum hmap_table_place hmap_dense_place(struct hmap_table * table, struct hmap_table_bulk const * bulk,
+    size_t index, size_t hash, size_t end, void * node, void ** entry)
+{
+    (void) node;
+    size_t mask = table->bucket_count - 1;
+    unsigned char fragment = hmap_table_getfragment(hash, table->bucket_count);
+
+    size_t id = hmap_table_gethome(hash, table->bucket_count);
+    while (HMAP_CTRL_EMPTY != table->ctrl[id])
+    {
+        size_t * item = HMAP_DENSE_ITEM(table, hmap_dense_getindex(table, id));
+        if ((fragment == table->ctrl[id]) && (hash == *item) &&
+            (bulk->match(index, HMAP_DENSE_ENTRY(item), bulk->context)))
+        {
+            *entry = HMAP_DENSE_ENTRY(item);
+            return HMAP_TABLE_PLACE_FOUND;
+        }
+
+        id++;
+        if (id == end)
+        {
+            return HMAP_TABLE_PLACE_DEFERRED;
+        }
+        id &= mask;
+    }
+
+    // items keep the order of the bulk build; items of found keys leave a hole
+    size_t * item = HMAP_DENSE_ITEM(table, index);
+    *item = hash;
+    table->item_ctrl[index] = fragment;
+    hmap_probe_setctrl(table->ctrl, table->bucket_count, id, fragment);
+    hmap_dense_setindex(table, id, index);
+
+    *entry = HMAP_DENSE_ENTRY(item);
+    return HMAP_TABLE_PLACE_CREATED;
+}
+
+/// Releases the item referenced by index slot \arg hole and removes the slot.
+static void hmap_dense_erase(struct hmap_table * table, size_t hole)
+{
+    size_t mask = table->bucket_count - 1;
+    size_t item_id = hmap_dense_getindex(table, hole);
+
+    if (NULL != table->release)
+    {
+        table->release(HMAP_DENSE_ENTRY(HMAP_DENSE_ITEM(table, item_id)), table->context);
+    }
+    table->item_ctrl[item_id] = HMAP_CTRL_EMPTY;
+    table->entry_count--;
+
+    // holes at the end are reused directly
+    while ((0 < table->item_count) && (HMAP_CTRL_EMPTY == table->item_ctrl[table->item_count - 1]))
+    {
+        table->item_count--;
+    }
+
+    // shift following index slots back
+    hmap_probe_setctrl(table->ctrl, table->bucket_count, hole, HMAP_CTRL_EMPTY);
+    size_t id = (hole + 1) & mask;
+    while (HMAP_CTRL_EMPTY != table->ctrl[id])
+    {
+        size_t next_item_id = hmap_dense_getindex(table, id);
+        size_t home = hmap_table_gethome(*HMAP_DENSE_ITEM(table, next_item_id), table->bucket_count);
+        if (hmap_probe_canshift(id, home, hole, mask))
+        {
+            hmap_dense_setindex(table, hole, next_item_id);
+            hmap_probe_setctrl(table->ctrl, table->bucket_count, hole, table->ctrl[id]);
+            hmap_probe_setctrl(table->ctrl, table->bucket_count, id, HMAP_CTRL_EMPTY);
+            hole = id;
+        }
+        id = (id + 1) & mask;
+    }
+}
+
+bool hmap_dense_remove(struct hmap_table * table, size_t hash, void const * key)
+{
+    bool removed = false;
+    size_t hole = hmap_dense_probe(table, hash, key, &removed);
+
+    if (removed)
+    {
+        hmap_dense_erase(table, hole);
+    }
+
+    return removed;
+}
+
+bool hmap_dense_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    (void) start;
+    size_t id = (NULL != *entry) ? (*bucket_id + 1) : *bucket_id;
+
+    // skip holes a group at a time; control bytes behind the last item are empty
+    while (id < table->item_count)
+    {
+        uint32_t used = hmap_group_used(&(table->item_ctrl[id]));
+        if (0 != used)
+        {
+            id += hmap_group_lowest(used);
+            break;
+        }
+
+        id += HMAP_GROUP_WIDTH;
+    }
+
+    *bucket_id = (id < table->item_count) ? id : table->item_count;
+    *entry = (id < table->item_count) ? HMAP_DENSE_ENTRY(HMAP_DENSE_ITEM(table, id)) : NULL;
+    return (NULL != *entry);
+}
+
+void hmap_dense_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    (void) start;
+    (void) entry;
+
+    // find the index slot referencing the current item
+    size_t mask = table->bucket_count - 1;
+    size_t item_id = *bucket_id;
+    size_t id = hmap_table_gethome(*HMAP_DENSE_ITEM(table, item_id), table->bucket_count);
+    while ((HMAP_CTRL_EMPTY == table->ctrl[id]) || (item_id != hmap_dense_getindex(table, id)))
+    {
+        id = (id + 1) & mask;
+    }
+
+    // items are never moved on removal, so the iteration continues behind the hole
+    hmap_dense_erase(table, id);
+}
+
+void hmap_dense_getstats(struct hmap_table * table, struct hmap_stats * stats)
+{
+    size_t mask = table->bucket_count - 1;
+    stats->bytes_allocated = (table->bucket_count * (table->index_width + 1)) + HMAP_GROUP_WIDTH +
+        (table->item_capacity * (HMAP_DENSE_ITEMSIZE(table) + 1)) + HMAP_GROUP_WIDTH;
+
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        if (HMAP_CTRL_EMPTY != table->ctrl[i])
+        {
+            size_t home = hmap_table_gethome(*HMAP_DENSE_ITEM(table, hmap_dense_getindex(table, i)), table->bucket_count);
+            hmap_table_addprobe(stats, ((i - home) & mask) + 1);
+        }
+    }
+}
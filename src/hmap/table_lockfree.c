@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table_lockfree.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+// Readers load links with acquire semantics; writers publish nodes
+// and bucket arrays with sequentially consistent stores, so that the
+// epoch read afterwards to tag retired memory is ordered behind the
+// store that unlinked it (see epoch.c).
+//
+// Retired memory is kept in lists ordered from newest to oldest and
+// reclaimed by writers once HMAP_LOCKFREE_RECLAIM_THRESHOLD items
+// are retired.
+
+#define HMAP_LOCKFREE_INITIAL_BUCKETS 16
+#define HMAP_LOCKFREE_DEFAULT_LOAD_FACTOR 0.7
+#define HMAP_LOCKFREE_RECLAIM_THRESHOLD 64
+
+#define HMAP_LOCKFREE_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define HMAP_LOCKFREE_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+
+/// Node of a bucket chain.
+///
+/// The entry is stored directly behind the node.
+struct hmap_lockfree_node
+{
+    struct hmap_lockfree_node * next;
+    size_t hash;
+    struct hmap_lockfree_node * retired_next;
+    size_t retired_epoch;
+    bool release;
+};
+
+struct hmap_lockfree_buckets
+{
+    size_t count;
+    struct hmap_lockfree_buckets * retired_next;
+    size_t retired_epoch;
+    struct hmap_lockfree_node * nodes[];
+};
+
+#define HMAP_LOCKFREE_ENTRY(node) ((void *) ((node) + 1))
+#define HMAP_LOCKFREE_BUCKETS_SIZE(count) (sizeof(struct hmap_lockfree_buckets) + ((count) * sizeof(struct hmap_lockfree_node *)))
+
+static size_t hmap_lockfree_getthreshold(
+    struct hmap_lockfree_table const * table,
+    size_t bucket_count)
+{
+    return (size_t) (table->max_load_factor * (double) bucket_count);
+}
+
+static struct hmap_lockfree_buckets * hmap_lockfree_createbuckets(
+    struct hmap_lockfree_table * table,
+    size_t count)
+{
+    struct hmap_lockfree_buckets * buckets = hmap_allocator_calloc(&(table->allocator), HMAP_LOCKFREE_BUCKETS_SIZE(count));
+    buckets->count = count;
+
+    return buckets;
+}
+
+static struct hmap_lockfree_node * hmap_lockfree_createnode(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * entry)
+{
+    struct hmap_lockfree_node * node = hmap_slab_alloc(&(table->nodes), &(table->allocator));
+    node->next = NULL;
+    node->hash = hash;
+    node->retired_next = NULL;
+    node->retired_epoch = 0;
+    node->release = false;
+    memcpy(HMAP_LOCKFREE_ENTRY(node), entry, table->entry_size);
+
+    return node;
+}
+
+static void hmap_lockfree_freenode(
+    struct hmap_lockfree_table * table,
+    struct hmap_lockfree_node * node)
+{
+    if ((node->release) && (NULL != table->release))
+    {
+        table->release(HMAP_LOCKFREE_ENTRY(node), table->context);
+    }
+    hmap_slab_free(&(table->nodes), node);
+}
+
+static void hmap_lockfree_reclaim(
+    struct hmap_lockfree_table * table,
+    bool all)
+{
+    size_t current = (all) ? ((size_t) -1) : hmap_epoch_advance(table->epoch);
+
+    // lists are ordered from newest to oldest, so everything behind
+    // the first reclaimable item is reclaimable too
+    struct hmap_lockfree_node ** node_link = &(table->retired_nodes);
+    while ((NULL != *node_link) && (!all) && (!hmap_epoch_isreclaimable(current, (*node_link)->retired_epoch)))
+    {
+        node_link = &((*node_link)->retired_next);
+    }
+
+    struct hmap_lockfree_node * node = *node_link;
+    *node_link = NULL;
+    while (NULL != node)
+    {
+        struct hmap_lockfree_node * next = node->retired_next;
+        hmap_lockfree_freenode(table, node);
+        table->retired_count--;
+        node = next;
+    }
+
+    struct hmap_lockfree_buckets ** buckets_link = &(table->retired_buckets);
+    while ((NULL != *buckets_link) && (!all) && (!hmap_epoch_isreclaimable(current, (*buckets_link)->retired_epoch)))
+    {
+        buckets_link = &((*buckets_link)->retired_next);
+    }
+
+    struct hmap_lockfree_buckets * buckets = *buckets_link;
+    *buckets_link = NULL;
+    while (NULL != buckets)
+    {
+        struct hmap_lockfree_buckets * next = buckets->retired_next;
+        hmap_allocator_free(&(table->allocator), buckets, HMAP_LOCKFREE_BUCKETS_SIZE(buckets->count));
+        table->retired_count--;
+        buckets = next;
+    }
+}
+
+static void hmap_lockfree_retirenode(
+    struct hmap_lockfree_table * table,
+    struct hmap_lockfree_node * node,
+    bool release)
+{
+    node->release = release;
+    node->retired_epoch = hmap_epoch_current(table->epoch);
+    node->retired_next = table->retired_nodes;
+    table->retired_nodes = node;
+    table->retired_count++;
+}
+
+static void hmap_lockfree_retirebuckets(
+    struct hmap_lockfree_table * table,
+    struct hmap_lockfree_buckets * buckets)
+{
+    buckets->retired_epoch = hmap_epoch_current(table->epoch);
+    buckets->retired_next = table->retired_buckets;
+    table->retired_buckets = buckets;
+    table->retired_count++;
+}
+
+static void hmap_lockfree_trytoreclaim(
+    struct hmap_lockfree_table * table)
+{
+    if (HMAP_LOCKFREE_RECLAIM_THRESHOLD <= table->retired_count)
+    {
+        hmap_lockfree_reclaim(table, false);
+    }
+}
+
+static void hmap_lockfree_grow(
+    struct hmap_lockfree_table * table)
+{
+    struct hmap_lockfree_buckets * old_buckets = table->buckets;
+    struct hmap_lockfree_buckets * buckets = hmap_lockfree_createbuckets(table, 2 * old_buckets->count);
+
+    // readers may still walk the old chains, so nodes are copied
+    // instead of being relinked
+    for (size_t i = 0; i < old_buckets->count; i++)
+    {
+        struct hmap_lockfree_node * old_node = old_buckets->nodes[i];
+        while (NULL != old_node)
+        {
+            struct hmap_lockfree_node * node = hmap_lockfree_createnode(table, old_node->hash, HMAP_LOCKFREE_ENTRY(old_node));
+            size_t bucket_id = hmap_table_gethome(node->hash, buckets->count);
+            node->next = buckets->nodes[bucket_id];
+            buckets->nodes[bucket_id] = node;
+
+            old_node = old_node->next;
+        }
+    }
+
+    HMAP_LOCKFREE_STORE(&(table->buckets), buckets);
+    table->threshold = hmap_lockfree_getthreshold(table, buckets->count);
+
+    for (size_t i = 0; i < old_buckets->count; i++)
+    {
+        struct hmap_lockfree_node * old_node = old_buckets->nodes[i];
+        while (NULL != old_node)
+        {
+            struct hmap_lockfree_node * next = old_node->next;
+            hmap_lockfree_retirenode(table, old_node, false);
+            old_node = next;
+        }
+    }
+    hmap_lockfree_retirebuckets(table, old_buckets);
+}
+
+/// Returns the link pointing to the node of \arg key or NULL, if \arg key is not stored.
+static struct hmap_lockfree_node ** hmap_lockfree_findlink(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key)
+{
+    struct hmap_lockfree_buckets * buckets = table->buckets;
+    struct hmap_lockfree_node ** link = &(buckets->nodes[hmap_table_gethome(hash, buckets->count)]);
+
+    while (NULL != *link)
+    {
+        struct hmap_lockfree_node * node = *link;
+        if ((hash == node->hash) && (table->match(key, HMAP_LOCKFREE_ENTRY(node), table->context)))
+        {
+            return link;
+        }
+        link = &(node->next);
+    }
+
+    return NULL;
+}
+
+void hmap_lockfree_init(
+    struct hmap_lockfree_table * table,
+    struct hmap_options const * options,
+    size_t entry_size,
+    hmap_table_match_fn * match,
+    hmap_table_release_fn * release,
+    void * context,
+    struct hmap_epoch * epoch)
+{
+    table->entry_size = ((entry_size + sizeof(size_t) - 1) / sizeof(size_t)) * sizeof(size_t);
+    table->max_load_factor = (0.0 < options->max_load_factor) ? options->max_load_factor : HMAP_LOCKFREE_DEFAULT_LOAD_FACTOR;
+    table->match = match;
+    table->release = release;
+    table->context = context;
+    hmap_allocator_init(&(table->allocator), &(options->allocator));
+    hmap_slab_init(&(table->nodes), sizeof(struct hmap_lockfree_node) + table->entry_size);
+    table->epoch = epoch;
+
+    size_t bucket_count = HMAP_LOCKFREE_INITIAL_BUCKETS;
+    while ((hmap_lockfree_getthreshold(table, bucket_count) < options->capacity) && (bucket_count <= (((size_t) -1) / 4)))
+    {
+        bucket_count *= 2;
+    }
+
+    table->buckets = hmap_lockfree_createbuckets(table, bucket_count);
+    table->entry_count = 0;
+    table->threshold = hmap_lockfree_getthreshold(table, bucket_count);
+
+    table->retired_nodes = NULL;
+    table->retired_buckets = NULL;
+    table->retired_count = 0;
+}
+
+void hmap_lockfree_cleanup(
+    struct hmap_lockfree_table * table)
+{
+    hmap_lockfree_reclaim(table, true);
+
+    struct hmap_lockfree_buckets * buckets = table->buckets;
+    if (NULL != table->release)
+    {
+        for (size_t i = 0; i < buckets->count; i++)
+        {
+            struct hmap_lockfree_node * node = buckets->nodes[i];
+            while (NULL != node)
+            {
+                table->release(HMAP_LOCKFREE_ENTRY(node), table->context);
+                node = node->next;
+            }
+        }
+    }
+
+    // nodes are freed with their slabs
+    hmap_allocator_free(&(table->allocator), buckets, HMAP_LOCKFREE_BUCKETS_SIZE(buckets->count));
+    hmap_slab_cleanup(&(table->nodes), &(table->allocator));
+    table->buckets = NULL;
+}
+
+void const * hmap_lockfree_find(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key)
+{
+    struct hmap_lockfree_buckets * buckets = HMAP_LOCKFREE_LOAD(&(table->buckets));
+    struct hmap_lockfree_node * node = HMAP_LOCKFREE_LOAD(&(buckets->nodes[hmap_table_gethome(hash, buckets->count)]));
+
+    while (NULL != node)
+    {
+        if ((hash == node->hash) && (table->match(key, HMAP_LOCKFREE_ENTRY(node), table->context)))
+        {
+            return HMAP_LOCKFREE_ENTRY(node);
+        }
+        node = HMAP_LOCKFREE_LOAD(&(node->next));
+    }
+
+    return NULL;
+}
+
+void hmap_lockfree_put(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key,
+    void const * entry)
+{
+    if (table->entry_count >= table->threshold)
+    {
+        hmap_lockfree_grow(table);
+    }
+
+    struct hmap_lockfree_node * node = hmap_lockfree_createnode(table, hash, entry);
+    struct hmap_lockfree_node ** link = hmap_lockfree_findlink(table, hash, key);
+    if (NULL != link)
+    {
+        struct hmap_lockfree_node * old_node = *link;
+        node->next = old_node->next;
+        HMAP_LOCKFREE_STORE(link, node);
+        hmap_lockfree_retirenode(table, old_node, true);
+    }
+    else
+    {
+        struct hmap_lockfree_node ** bucket = &(table->buckets->nodes[hmap_table_gethome(hash, table->buckets->count)]);
+        node->next = *bucket;
+        HMAP_LOCKFREE_STORE(bucket, node);
+        table->entry_count++;
+    }
+
+    hmap_lockfree_trytoreclaim(table);
+}
+
+bool hmap_lockfree_remove(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key)
+{
+    struct hmap_lockfree_node ** link = hmap_lockfree_findlink(table, hash, key);
+    if (NULL != link)
+    {
+        struct hmap_lockfree_node * node = *link;
+        HMAP_LOCKFREE_STORE(link, node->next);
+        hmap_lockfree_retirenode(table, node, true);
+        table->entry_count--;
+
+        hmap_lockfree_trytoreclaim(table);
+    }
+
+    return (NULL != link);
+}
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_TABLE_LOCKFREE_H
+#define HMAP_TABLE_LOCKFREE_H
+
+#include "hmap/table.h"
+#include "hmap/epoch.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct hmap_lockfree_node;
+struct hmap_lockfree_buckets;
+
+/// Chained table, which can be read while it is modified.
+///
+/// Published nodes and bucket arrays are never modified, apart
+/// from the links of the chains. Updates replace the node of an
+/// entry and growing the table copies all nodes into a new bucket
+/// array. Unlinked nodes and bucket arrays are retired and freed
+/// once no reader can access them anymore.
+///
+/// \note Writers must be serialized by the owner of the table.
+struct hmap_lockfree_table
+{
+    size_t entry_size;
+    double max_load_factor;
+    hmap_table_match_fn * match;
+    hmap_table_release_fn * release;
+    void * context;
+    struct hmap_allocator allocator;
+    struct hmap_slab_pool nodes;
+    struct hmap_epoch * epoch;
+
+    struct hmap_lockfree_buckets * buckets;
+    size_t entry_count;
+    size_t threshold;
+
+    struct hmap_lockfree_node * retired_nodes;
+    struct hmap_lockfree_buckets * retired_buckets;
+    size_t retired_count;
+};
+
+/// Initializes an empty table.
+///
+/// \note The storage engine and incremental rehashing options are ignored.
+///
+/// \param table Pointer to the table.
+/// \param options Options of the map owning the table.
+/// \param entry_size Size of an entry in bytes.
+/// \param match Used to find an entry by key.
+/// \param release Used to release removed entries; NULL if nothing is to release.
+/// \param context Passed to the callbacks.
+/// \param epoch Epoch used to reclaim memory; shared by all readers.
+extern void hmap_lockfree_init(
+    struct hmap_lockfree_table * table,
+    struct hmap_options const * options,
+    size_t entry_size,
+    hmap_table_match_fn * match,
+    hmap_table_release_fn * release,
+    void * context,
+    struct hmap_epoch * epoch);
+
+/// Releases all entries and the memory used by the table.
+///
+/// \note The table must not be accessed by other threads anymore.
+///
+/// \param table Pointer to the table.
+extern void hmap_lockfree_cleanup(
+    struct hmap_lockfree_table * table);
+
+/// Returns the entry stored for \arg key.
+///
+/// \note Readers must enter the epoch of the table before and must
+///       not access the returned entry after leaving it.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key to find.
+/// \return Entry of \arg key or NULL, if \arg key is not stored.
+extern void const * hmap_lockfree_find(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key);
+
+/// Stores an entry, replacing the entry of \arg key if there is one.
+///
+/// \note The replaced entry is released once it is reclaimed.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key of the entry.
+/// \param entry Entry to copy into the table.
+extern void hmap_lockfree_put(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key,
+    void const * entry);
+
+/// Removes the entry stored for \arg key.
+///
+/// \note The removed entry is released once it is reclaimed.
+///
+/// \param table Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key of the entry to remove.
+/// \return true, if an entry was removed.
+extern bool hmap_lockfree_remove(
+    struct hmap_lockfree_table * table,
+    size_t hash,
+    void const * key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
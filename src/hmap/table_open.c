@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table.h"
+#include "hmap/detail/probe.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+// Open addressing with linear probing.
+//
+// Entries are stored in a contiguous array of slots; the bucket
+// count is always a power of two and at least HMAP_GROUP_WIDTH.
+// Control bytes, probing and backward-shift deletion are shared
+// with imap and hmap.hpp, see hmap/detail/probe.h.
+//
+// Each slot stores the hash of its entry followed by the entry.
+
+#define HMAP_OPEN_SLOTSIZE(table) (sizeof(size_t) + (table)->entry_size)
+#define HMAP_OPEN_SLOT(table, id) ((size_t *) (((unsigned char *) (table)->buckets) + ((id) * HMAP_OPEN_SLOTSIZE(table))))
+#define HMAP_OPEN_ENTRY(slot) ((void *) ((slot) + 1))
+
+static unsigned char * hmap_open_createctrl(
+    struct hmap_table * table,
+    size_t bucket_count)
+{
+    unsigned char * ctrl = hmap_allocator_alloc(&(table->allocator), bucket_count + HMAP_GROUP_WIDTH);
+    memset(ctrl, HMAP_CTRL_EMPTY, bucket_count + HMAP_GROUP_WIDTH);
+    return ctrl;
+}
+
+/// Probes for \arg key starting at its home slot.
+///
+/// \return Id of the slot storing \arg key or the id of the first
+///         empty slot of the probe sequence, if \arg key is not found.
+static size_t hmap_open_probe(
+    struct hmap_table * table,
+    size_t hash,
+    void const * key,
+    bool * found)
+{
+    struct hmap_probe probe;
+    hmap_probe_start(&probe, table->ctrl, table->bucket_count, hash);
+
+    size_t id = 0;
+    while (hmap_probe_next(&probe, table->ctrl, &id))
+    {
+        size_t * slot = HMAP_OPEN_SLOT(table, id);
+        if (hash == *slot)
+        {
+            HMAP_STATS_INC(table->comparisons);
+            if (table->match(key, HMAP_OPEN_ENTRY(slot), table->context))
+            {
+                *found = true;
+                return id;
+            }
+        }
+    }
+
+    *found = false;
+    return id;
+}
+
+static void hmap_open_freeslots(
+    struct hmap_table * table)
+{
+    hmap_allocator_free(&(table->allocator), table->buckets, table->bucket_count * HMAP_OPEN_SLOTSIZE(table));
+    hmap_allocator_free(&(table->allocator), table->ctrl, table->bucket_count + HMAP_GROUP_WIDTH);
+}
+
+static void hmap_open_rehash(
+    struct hmap_table * table,
+    size_t new_bucket_count)
+{
+    // create new slots
+    table->rehash_count++;
+    size_t slot_size = HMAP_OPEN_SLOTSIZE(table);
+    unsigned char * new_slots = hmap_allocator_alloc(&(table->allocator), new_bucket_count * slot_size);
+    unsigned char * new_ctrl = hmap_open_createctrl(table, new_bucket_count);
+
+    // put entries into new slots
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        if (HMAP_CTRL_EMPTY != table->ctrl[i])
+        {
+            size_t * slot = HMAP_OPEN_SLOT(table, i);
+            size_t hash = *slot;
+            size_t id = hmap_probe_findempty(new_ctrl, new_bucket_count, hmap_table_gethome(hash, new_bucket_count));
+
+            memcpy(&(new_slots[id * slot_size]), slot, slot_size);
+            hmap_probe_setctrl(new_ctrl, new_bucket_count, id, hmap_table_getfragment(hash, new_bucket_count));
+        }
+    }
+
+    // update table to use new slots
+    hmap_open_freeslots(table);
+    table->bucket_count = new_bucket_count;
+    table->threshold = hmap_table_getthreshold(table, new_bucket_count);
+    table->buckets = new_slots;
+    table->ctrl = new_ctrl;
+}
+
+void hmap_open_resize(struct hmap_table * table, size_t bucket_count)
+{
+    hmap_open_rehash(table, bucket_count);
+}
+
+void hmap_open_init(struct hmap_table * table)
+{
+    table->buckets = hmap_allocator_alloc(&(table->allocator), table->bucket_count * HMAP_OPEN_SLOTSIZE(table));
+    table->ctrl = hmap_open_createctrl(table, table->bucket_count);
+}
+
+void hmap_open_cleanup(struct hmap_table * table)
+{
+    if (NULL != table->release)
+    {
+        for (size_t i = 0; i < table->bucket_count; i++)
+        {
+            if (HMAP_CTRL_EMPTY != table->ctrl[i])
+            {
+                table->release(HMAP_OPEN_ENTRY(HMAP_OPEN_SLOT(table, i)), table->context);
+            }
+        }
+    }
+
+    hmap_open_freeslots(table);
+}
+
+void * hmap_open_find(struct hmap_table * table, size_t hash, void const * key)
+{
+    bool found = false;
+    size_t id = hmap_open_probe(table, hash, key, &found);
+
+    return found ? HMAP_OPEN_ENTRY(HMAP_OPEN_SLOT(table, id)) : NULL;
+}
+
+void hmap_open_prefetch(struct hmap_table const * table, size_t hash)
+{
+    size_t id = hmap_table_gethome(hash, table->bucket_count);
+    HMAP_PREFETCH(&(table->ctrl[id]));
+    HMAP_PREFETCH(HMAP_OPEN_SLOT(table, id));
+}
+
+void * hmap_open_insert(struct hmap_table * table, size_t hash, void const * key, bool * created)
+{
+    if (table->entry_count > table->threshold)
+    {
+        hmap_open_rehash(table, 2 * table->bucket_count);
+    }
+
+    bool found = false;
+    size_t id = hmap_open_probe(table, hash, key, &found);
+    *created = !found;
+
+    size_t * slot = HMAP_OPEN_SLOT(table, id);
+    if (*created)
+    {
+        *slot = hash;
+        hmap_probe_setctrl(table->ctrl, table->bucket_count, id, hmap_table_getfragment(hash, table->bucket_count));
+        table->entry_count++;
+    }
+
+    return HMAP_OPEN_ENTRY(slot);
+}
+
+enum hmap_table_place hmap_open_place(struct hmap_table * table, struct hmap_table_bulk const * bulk,
+    size_t index, size_t hash, size_t end, void * node, void ** entry)
+{
+    (void) node;
+    size_t mask = table->bucket_count - 1;
+    unsigned char fragment = hmap_table_getfragment(hash, table->bucket_count);
+
+    size_t id = hmap_table_gethome(hash, table->bucket_count);
+    while (HMAP_CTRL_EMPTY != table->ctrl[id])
+    {
+        size_t * slot = HMAP_OPEN_SLOT(table, id);
+        if ((fragment == table->ctrl[id]) && (hash == *slot) &&
+            (bulk->match(index, HMAP_OPEN_ENTRY(slot), bulk->context)))
+        {
+            *entry = HMAP_OPEN_ENTRY(slot);
+            return HMAP_TABLE_PLACE_FOUND;
+        }
+
+        id++;
+        if (id == end)
+        {
+            return HMAP_TABLE_PLACE_DEFERRED;
+        }
+        id &= mask;
+    }
+
+    size_t * slot = HMAP_OPEN_SLOT(table, id);
+    *slot = hash;
+    hmap_probe_setctrl(table->ctrl, table->bucket_count, id, fragment);
+
+    *entry = HMAP_OPEN_ENTRY(slot);
+    return HMAP_TABLE_PLACE_CREATED;
+}
+
+/// Releases and removes the entry of slot \arg hole.
+static void hmap_open_erase(struct hmap_table * table, size_t hole)
+{
+    size_t mask = table->bucket_count - 1;
+
+    if (NULL != table->release)
+    {
+        table->release(HMAP_OPEN_ENTRY(HMAP_OPEN_SLOT(table, hole)), table->context);
+    }
+    hmap_probe_setctrl(table->ctrl, table->bucket_count, hole, HMAP_CTRL_EMPTY);
+    table->entry_count--;
+
+    // shift following entries back
+    size_t id = (hole + 1) & mask;
+    while (HMAP_CTRL_EMPTY != table->ctrl[id])
+    {
+        size_t home = hmap_table_gethome(*HMAP_OPEN_SLOT(table, id), table->bucket_count);
+        if (hmap_probe_canshift(id, home, hole, mask))
+        {
+            memcpy(HMAP_OPEN_SLOT(table, hole), HMAP_OPEN_SLOT(table, id), HMAP_OPEN_SLOTSIZE(table));
+            hmap_probe_setctrl(table->ctrl, table->bucket_count, hole, table->ctrl[id]);
+            hmap_probe_setctrl(table->ctrl, table->bucket_count, id, HMAP_CTRL_EMPTY);
+            hole = id;
+        }
+        id = (id + 1) & mask;
+    }
+}
+
+bool hmap_open_remove(struct hmap_table * table, size_t hash, void const * key)
+{
+    bool removed = false;
+    size_t hole = hmap_open_probe(table, hash, key, &removed);
+
+    if (removed)
+    {
+        hmap_open_erase(table, hole);
+    }
+
+    return removed;
+}
+
+// Iteration starts at an empty slot and visits the slots in order,
+// wrapping around at the end. Since no run of used slots crosses the
+// start, removing the current entry shifts back only entries that are
+// not yet visited, so each entry is visited exactly once.
+// bucket_id is the offset of the current slot relative to start.
+
+bool hmap_open_next(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    size_t mask = table->bucket_count - 1;
+
+    if ((0 == *bucket_id) && (NULL == *entry))
+    {
+        // there is always an empty slot, since the threshold is below bucket_count
+        size_t id = 0;
+        uint32_t empty = hmap_group_empty(&(table->ctrl[id]));
+        while (0 == empty)
+        {
+            id += HMAP_GROUP_WIDTH;
+            empty = hmap_group_empty(&(table->ctrl[id]));
+        }
+        *start = (id + hmap_group_lowest(empty)) & mask;
+    }
+
+    size_t offset = (NULL != *entry) ? (*bucket_id + 1) : *bucket_id;
+    offset = hmap_probe_nextused(table->ctrl, table->bucket_count, *start, offset);
+
+    *bucket_id = offset;
+    *entry = (offset < table->bucket_count) ? HMAP_OPEN_ENTRY(HMAP_OPEN_SLOT(table, (*start + offset) & mask)) : NULL;
+    return (NULL != *entry);
+}
+
+void hmap_open_removeat(struct hmap_table * table, size_t * bucket_id, size_t * start, void ** entry)
+{
+    size_t mask = table->bucket_count - 1;
+    hmap_open_erase(table, (*start + *bucket_id) & mask);
+
+    // the slot is visited again, since the next entry may have been shifted into it
+    *entry = NULL;
+}
+
+void hmap_open_getstats(struct hmap_table * table, struct hmap_stats * stats)
+{
+    size_t mask = table->bucket_count - 1;
+    stats->bytes_allocated = (table->bucket_count * HMAP_OPEN_SLOTSIZE(table)) + table->bucket_count + HMAP_GROUP_WIDTH;
+
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        if (HMAP_CTRL_EMPTY != table->ctrl[i])
+        {
+            size_t home = hmap_table_gethome(*HMAP_OPEN_SLOT(table, i), table->bucket_count);
+            hmap_table_addprobe(stats, ((i - home) & mask) + 1);
+        }
+    }
+}
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/table_perfect.h"
+#include "hmap/allocator.h"
+#include <string.h>
+
+// Minimal perfect hashing by hash and displace (CHD).
+//
+// Entries are distributed into buckets of HMAP_PERFECT_BUCKET_SIZE
+// entries on average. Buckets are placed in order of decreasing size:
+// for each bucket, the smallest displacement is searched that maps
+// all of its entries to distinct free slots. A lookup mixes the hash
+// value with the displacement of its bucket to find the only slot
+// that may store the key.
+//
+// Displacement 0 is a valid displacement, so the slot of a key is
+// always defined. Since mixing is a bijection, entries with distinct
+// hash values are separated by some displacement, while entries
+// with equal hash values can never be separated. Owners may retry
+// with a re-seeded hash of the keys in this case.
+
+#define HMAP_PERFECT_BUCKET_SIZE 4
+
+struct hmap_perfect_item
+{
+    size_t hash;
+    void const * entry;
+};
+
+static inline size_t hmap_perfect_bucket(
+    struct hmap_perfect_table const * perfect,
+    size_t hash)
+{
+    return (size_t) (hmap_table_mix((uint64_t) hash) % perfect->bucket_count);
+}
+
+static inline size_t hmap_perfect_slot(
+    struct hmap_perfect_table const * perfect,
+    size_t hash,
+    uint32_t displacement)
+{
+    uint64_t value = ((uint64_t) hash) + ((((uint64_t) displacement) + 1) * HMAP_TABLE_FIBONACCI);
+    return (size_t) (hmap_table_mix(value) % perfect->entry_count);
+}
+
+/// Searches a displacement mapping all items of a bucket to distinct free slots.
+static bool hmap_perfect_place(
+    struct hmap_perfect_table * perfect,
+    struct hmap_perfect_item const * items,
+    size_t count,
+    unsigned char * used,
+    size_t * slots,
+    uint32_t * displacement)
+{
+    // entries with equal hash values share a bucket and cannot be separated
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < i; j++)
+        {
+            if (items[i].hash == items[j].hash)
+            {
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t d = 0; d < UINT32_MAX; d++)
+    {
+        bool fits = true;
+        for (size_t i = 0; (fits) && (i < count); i++)
+        {
+            slots[i] = hmap_perfect_slot(perfect, items[i].hash, d);
+            fits = (0 == used[slots[i]]);
+            for (size_t j = 0; (fits) && (j < i); j++)
+            {
+                fits = (slots[i] != slots[j]);
+            }
+        }
+
+        if (fits)
+        {
+            *displacement = d;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline size_t hmap_perfect_hashof(
+    struct hmap_perfect_table const * perfect,
+    hmap_perfect_hash_fn * hash,
+    void const * entry)
+{
+    return (NULL != hash) ? hash(entry, perfect->context) : hmap_table_gethash(entry);
+}
+
+static bool hmap_perfect_build(
+    struct hmap_perfect_table * perfect,
+    struct hmap_table * table,
+    hmap_perfect_hash_fn * hash)
+{
+    struct hmap_allocator const * allocator = &(perfect->allocator);
+    size_t count = perfect->entry_count;
+    size_t bucket_count = perfect->bucket_count;
+
+    // sort entries by bucket (counting sort)
+    size_t * offsets = hmap_allocator_calloc(allocator, (bucket_count + 1) * sizeof(size_t));
+    struct hmap_perfect_item * items = hmap_allocator_alloc(allocator, count * sizeof(struct hmap_perfect_item));
+
+    size_t bucket_id = 0;
+    size_t start = 0;
+    void * entry = NULL;
+    while (hmap_table_next(table, &bucket_id, &start, &entry))
+    {
+        offsets[hmap_perfect_bucket(perfect, hmap_perfect_hashof(perfect, hash, entry)) + 1]++;
+    }
+
+    size_t max_size = 0;
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        max_size = (offsets[i + 1] > max_size) ? offsets[i + 1] : max_size;
+        offsets[i + 1] += offsets[i];
+    }
+
+    bucket_id = 0;
+    entry = NULL;
+    while (hmap_table_next(table, &bucket_id, &start, &entry))
+    {
+        size_t entry_hash = hmap_perfect_hashof(perfect, hash, entry);
+        size_t * offset = &(offsets[hmap_perfect_bucket(perfect, entry_hash)]);
+        items[*offset].hash = entry_hash;
+        items[*offset].entry = entry;
+        (*offset)++;
+    }
+
+    // offsets[i] now is the end of bucket i; sort buckets by decreasing size (counting sort)
+    size_t * size_offsets = hmap_allocator_calloc(allocator, (max_size + 2) * sizeof(size_t));
+    size_t * order = hmap_allocator_alloc(allocator, bucket_count * sizeof(size_t));
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        size_t size = offsets[i] - ((0 < i) ? offsets[i - 1] : 0);
+        size_offsets[max_size - size + 1]++;
+    }
+    for (size_t i = 0; i <= max_size; i++)
+    {
+        size_offsets[i + 1] += size_offsets[i];
+    }
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        size_t size = offsets[i] - ((0 < i) ? offsets[i - 1] : 0);
+        order[size_offsets[max_size - size]++] = i;
+    }
+
+    // place buckets
+    unsigned char * used = hmap_allocator_calloc(allocator, count);
+    size_t * slots = hmap_allocator_alloc(allocator, max_size * sizeof(size_t));
+    bool success = true;
+    for (size_t i = 0; (success) && (i < bucket_count); i++)
+    {
+        size_t id = order[i];
+        size_t begin = (0 < id) ? offsets[id - 1] : 0;
+        size_t size = offsets[id] - begin;
+        if (0 == size)
+        {
+            // remaining buckets are empty
+            break;
+        }
+
+        success = hmap_perfect_place(perfect, &(items[begin]), size, used, slots, &(perfect->displacements[id]));
+        for (size_t j = 0; (success) && (j < size); j++)
+        {
+            used[slots[j]] = 1;
+            memcpy(&(perfect->entries[slots[j] * perfect->entry_size]), items[begin + j].entry, perfect->entry_size);
+        }
+    }
+
+    hmap_allocator_free(allocator, slots, max_size * sizeof(size_t));
+    hmap_allocator_free(allocator, used, count);
+    hmap_allocator_free(allocator, order, bucket_count * sizeof(size_t));
+    hmap_allocator_free(allocator, size_offsets, (max_size + 2) * sizeof(size_t));
+    hmap_allocator_free(allocator, items, count * sizeof(struct hmap_perfect_item));
+    hmap_allocator_free(allocator, offsets, (bucket_count + 1) * sizeof(size_t));
+
+    return success;
+}
+
+bool hmap_perfect_init(
+    struct hmap_perfect_table * perfect,
+    struct hmap_table * table,
+    hmap_perfect_hash_fn * hash,
+    void * context)
+{
+    perfect->entry_size = table->entry_size;
+    perfect->match = table->match;
+    perfect->release = table->release;
+    perfect->context = context;
+    perfect->allocator = table->allocator;
+
+    perfect->entry_count = table->entry_count;
+    perfect->bucket_count = (table->entry_count / HMAP_PERFECT_BUCKET_SIZE) + 1;
+    perfect->displacements = NULL;
+    perfect->entries = NULL;
+
+    if (0 == perfect->entry_count)
+    {
+        return true;
+    }
+
+    perfect->displacements = hmap_allocator_calloc(&(perfect->allocator), perfect->bucket_count * sizeof(uint32_t));
+    perfect->entries = hmap_allocator_alloc(&(perfect->allocator), perfect->entry_count * perfect->entry_size);
+
+    bool success = hmap_perfect_build(perfect, table, hash);
+    if (!success)
+    {
+        // entries are copies owned by table, so they are not released here
+        perfect->release = NULL;
+        hmap_perfect_cleanup(perfect);
+    }
+
+    return success;
+}
+
+void hmap_perfect_cleanup(
+    struct hmap_perfect_table * perfect)
+{
+    if ((NULL != perfect->release) && (NULL != perfect->entries))
+    {
+        for (size_t i = 0; i < perfect->entry_count; i++)
+        {
+            perfect->release(&(perfect->entries[i * perfect->entry_size]), perfect->context);
+        }
+    }
+
+    hmap_allocator_free(&(perfect->allocator), perfect->entries, perfect->entry_count * perfect->entry_size);
+    hmap_allocator_free(&(perfect->allocator), perfect->displacements, perfect->bucket_count * sizeof(uint32_t));
+    perfect->entries = NULL;
+    perfect->displacements = NULL;
+}
+
+void * hmap_perfect_find(
+    struct hmap_perfect_table const * perfect,
+    size_t hash,
+    void const * key)
+{
+    if (0 == perfect->entry_count)
+    {
+        return NULL;
+    }
+
+    uint32_t displacement = perfect->displacements[hmap_perfect_bucket(perfect, hash)];
+    void * entry = &(perfect->entries[hmap_perfect_slot(perfect, hash, displacement) * perfect->entry_size]);
+
+    return perfect->match(key, entry, perfect->context) ? entry : NULL;
+}
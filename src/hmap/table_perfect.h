@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef HMAP_TABLE_PERFECT_H
+#define HMAP_TABLE_PERFECT_H
+
+#include "hmap/table.h"
+
+#ifndef __cplusplus
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Immutable table using a minimal perfect hash.
+///
+/// The table is built once from the entries of a \see hmap_table.
+/// Each entry is stored in exactly one slot and there are as many
+/// slots as entries, so each lookup reads one slot and compares
+/// one key.
+struct hmap_perfect_table
+{
+    size_t entry_size;
+    hmap_table_match_fn * match;
+    hmap_table_release_fn * release;
+    void * context;
+    struct hmap_allocator allocator;
+
+    size_t entry_count;
+    size_t bucket_count;
+    uint32_t * displacements;
+    unsigned char * entries;
+};
+
+/// Number of seeds tried by the owners of a perfect table after their
+/// own seed failed, see \see hmap_perfect_reseed.
+#define HMAP_PERFECT_RESEEDS 4
+
+/// Re-hashes an entry with the seed currently stored in \arg context.
+///
+/// \param entry Entry to hash.
+/// \param context Passed to \see hmap_perfect_init.
+/// \return Hash value of the key of \arg entry.
+typedef size_t hmap_perfect_hash_fn(
+    void const * entry,
+    void * context);
+
+/// Returns the seed to try after \arg attempt failed attempts.
+///
+/// Entries whose keys share a full hash value cannot be separated,
+/// so owners retry with derived seeds and re-hash all keys.
+///
+/// \param seed Seed of the map.
+/// \param attempt Number of the attempt, starting at 1.
+/// \return Seed to use.
+static inline size_t hmap_perfect_reseed(
+    size_t seed,
+    size_t attempt)
+{
+    return (size_t) hmap_table_mix(((uint64_t) seed) + (((uint64_t) attempt) * HMAP_TABLE_FIBONACCI));
+}
+
+/// Builds a perfect table from the entries of \arg table.
+///
+/// \note The entries are copied; the caller must make sure that
+///       they are not released by \arg table afterwards.
+///
+/// \param perfect Pointer to the table to build.
+/// \param table Table to copy entries, callbacks and allocator from.
+/// \param hash Function to re-hash entries or NULL to use the hash
+///        values stored in \arg table.
+/// \param context Passed to the callbacks.
+/// \return true on success; false, if two entries share the same hash value.
+extern bool hmap_perfect_init(
+    struct hmap_perfect_table * perfect,
+    struct hmap_table * table,
+    hmap_perfect_hash_fn * hash,
+    void * context);
+
+/// Releases all entries and the memory used by the table.
+///
+/// \param perfect Pointer to the table.
+extern void hmap_perfect_cleanup(
+    struct hmap_perfect_table * perfect);
+
+/// Returns the entry stored for \arg key.
+///
+/// \param perfect Pointer to the table.
+/// \param hash Hash value of \arg key.
+/// \param key Key to find.
+/// \return Entry of \arg key or NULL, if \arg key is not stored.
+extern void * hmap_perfect_find(
+    struct hmap_perfect_table const * perfect,
+    size_t hash,
+    void const * key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
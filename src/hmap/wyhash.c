@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/wyhash.h"
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t const smap_wyhash_secret[4] =
+{
+    UINT64_C(0x2d358dccaa6c78a5),
+    UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3),
+    UINT64_C(0x4d5a2da51de1aa47)
+};
+
+static void smap_wyhash_mum(uint64_t * a, uint64_t * b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32;
+    uint64_t hb = *b >> 32;
+    uint64_t la = (uint32_t) *a;
+    uint64_t lb = (uint32_t) *b;
+    uint64_t rh = ha * hb;
+    uint64_t rm0 = ha * lb;
+    uint64_t rm1 = hb * la;
+    uint64_t rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = (t < rl) ? 1 : 0;
+    uint64_t lo = t + (rm1 << 32);
+    c += (lo < t) ? 1 : 0;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static uint64_t smap_wyhash_mix(uint64_t a, uint64_t b)
+{
+    smap_wyhash_mum(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t smap_wyhash_read8(unsigned char const * p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t smap_wyhash_read4(unsigned char const * p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t smap_wyhash_read3(unsigned char const * p, size_t length)
+{
+    return (((uint64_t) p[0]) << 16) | (((uint64_t) p[length >> 1]) << 8) | p[length - 1];
+}
+
+size_t smap_wyhash(char const * key, size_t length, size_t seed)
+{
+    uint64_t const * secret = smap_wyhash_secret;
+    unsigned char const * p = (unsigned char const *) key;
+    uint64_t state = ((uint64_t) seed) ^ smap_wyhash_mix(((uint64_t) seed) ^ secret[0], secret[1]);
+    uint64_t a;
+    uint64_t b;
+
+    if (length <= 16)
+    {
+        if (length >= 4)
+        {
+            size_t offset = (length >> 3) << 2;
+            a = (smap_wyhash_read4(p) << 32) | smap_wyhash_read4(p + offset);
+            b = (smap_wyhash_read4(p + length - 4) << 32) | smap_wyhash_read4(p + length - 4 - offset);
+        }
+        else if (length > 0)
+        {
+            a = smap_wyhash_read3(p, length);
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        size_t remaining = length;
+        if (remaining > 48)
+        {
+            uint64_t state1 = state;
+            uint64_t state2 = state;
+            do
+            {
+                state = smap_wyhash_mix(smap_wyhash_read8(p) ^ secret[1], smap_wyhash_read8(p + 8) ^ state);
+                state1 = smap_wyhash_mix(smap_wyhash_read8(p + 16) ^ secret[2], smap_wyhash_read8(p + 24) ^ state1);
+                state2 = smap_wyhash_mix(smap_wyhash_read8(p + 32) ^ secret[3], smap_wyhash_read8(p + 40) ^ state2);
+                p += 48;
+                remaining -= 48;
+            }
+            while (remaining > 48);
+            state ^= state1 ^ state2;
+        }
+
+        while (remaining > 16)
+        {
+            state = smap_wyhash_mix(smap_wyhash_read8(p) ^ secret[1], smap_wyhash_read8(p + 8) ^ state);
+            remaining -= 16;
+            p += 16;
+        }
+
+        a = smap_wyhash_read8(p + remaining - 16);
+        b = smap_wyhash_read8(p + remaining - 8);
+    }
+
+    a ^= secret[1];
+    b ^= state;
+    smap_wyhash_mum(&a, &b);
+
+    return (size_t) smap_wyhash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#ifndef SMAP_WYHASH_H
+#define SMAP_WYHASH_H
+
+#ifndef __cplusplus
+#include <stddef.h>
+#else
+#include <cstddef>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Returns a hash for string values.
+///
+/// Provides an implementation of wyhash (final version 4) by Wang Yi
+/// (see https://github.com/wangyi-fudan/wyhash), which is released
+/// into the public domain. The key is processed 8 or 16 bytes at a
+/// time using 64x64 to 128 bit multiplications.
+///
+/// \param key Key to hash.
+/// \param length Length of \arg key in bytes.
+/// \param seed Seed for hash randomization.
+/// \return Hash value of \arg key.
+extern size_t smap_wyhash(char const * key, size_t length, size_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/chmap.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+size_t size_hash(void const * item, size_t seed)
+{
+    size_t value = reinterpret_cast<size_t>(item) ^ seed;
+    return value * static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+}
+
+int size_equals(void const * value, void const * other)
+{
+    return (value == other) ? 0 : 1;
+}
+
+int string_equals(void const * value, void const * other)
+{
+    return strcmp(reinterpret_cast<char const *>(value), reinterpret_cast<char const *>(other));
+}
+
+size_t string_hash(void const * item, size_t seed)
+{
+    return std::hash<std::string>()(reinterpret_cast<char const *>(item)) ^ seed;
+}
+
+void * as_ptr(size_t value)
+{
+    return reinterpret_cast<void*>(value);
+}
+
+size_t identity_hash(void const * item, size_t seed)
+{
+    (void) seed;
+    return reinterpret_cast<size_t>(item);
+}
+
+void * max_alloc(size_t size, void * context)
+{
+    size_t * max_size = reinterpret_cast<size_t *>(context);
+    *max_size = (size > *max_size) ? size : *max_size;
+    return malloc(size);
+}
+
+void max_free(void * ptr, size_t size, void * context)
+{
+    (void) size;
+    (void) context;
+    free(ptr);
+}
+
+}
+
+TEST(chmap, add_get_remove)
+{
+    struct chmap * map = chmap_create(0, &string_hash, &string_equals, &free, &free);
+
+    chmap_add(map, strdup("key"), strdup("value"));
+    ASSERT_STREQ("value", reinterpret_cast<char const*>(chmap_get(map, "key")));
+    ASSERT_TRUE(chmap_contains(map, "key"));
+    ASSERT_FALSE(chmap_contains(map, "other"));
+
+    chmap_add(map, strdup("key"), strdup("updated"));
+    ASSERT_STREQ("updated", reinterpret_cast<char const*>(chmap_get(map, "key")));
+
+    chmap_remove(map, "key");
+    ASSERT_FALSE(chmap_contains(map, "key"));
+
+    chmap_release(map);
+}
+
+TEST(chmap, shard_count)
+{
+    struct chmap_options options;
+    chmap_options_init(&options);
+    options.map.hash = &size_hash;
+    options.map.equals = &size_equals;
+    options.map.engine = HMAP_ENGINE_OPEN;
+    options.map.capacity = 1000;
+    options.shard_count = 3;
+    struct chmap * map = chmap_create_ex(&options);
+
+    for (size_t i = 1; i <= 1000; i++)
+    {
+        chmap_add(map, as_ptr(i), as_ptr(i * 2));
+    }
+
+    for (size_t i = 1; i <= 1000; i++)
+    {
+        ASSERT_EQ(as_ptr(i * 2), chmap_get(map, as_ptr(i)));
+    }
+
+    chmap_release(map);
+}
+
+TEST(chmap, weak_hash_spreads_across_shards)
+{
+    size_t max_size = 0;
+
+    struct chmap_options options;
+    chmap_options_init(&options);
+    options.map.hash = &identity_hash;
+    options.map.equals = &size_equals;
+    options.map.allocator.alloc = &max_alloc;
+    options.map.allocator.free = &max_free;
+    options.map.allocator.context = &max_size;
+    options.shard_count = 64;
+    struct chmap * map = chmap_create_ex(&options);
+
+    // all hashes are small, so a single shard would grow large buckets and slabs
+    size_t const count = 64 * 100;
+    for (size_t i = 1; i <= count; i++)
+    {
+        chmap_add(map, as_ptr(i), as_ptr(i + 1));
+    }
+    ASSERT_GT(static_cast<size_t>(64 * 1024), max_size);
+
+    for (size_t i = 1; i <= count; i++)
+    {
+        ASSERT_EQ(as_ptr(i + 1), chmap_get(map, as_ptr(i)));
+    }
+
+    chmap_release(map);
+}
+
+TEST(chmap, concurrent_access)
+{
+    struct chmap * map = chmap_create(0, &size_hash, &size_equals, nullptr, nullptr);
+
+    size_t const thread_count = 8;
+    size_t const items_per_thread = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([map, t]() {
+            size_t first = (t * items_per_thread) + 1;
+            for (size_t i = first; i < first + items_per_thread; i++)
+            {
+                chmap_add(map, as_ptr(i), as_ptr(i + 1));
+                if (as_ptr(i + 1) != chmap_get(map, as_ptr(i)))
+                {
+                    ADD_FAILURE() << "missing key " << i;
+                }
+                if (0 == (i % 2))
+                {
+                    chmap_remove(map, as_ptr(i));
+                }
+            }
+        });
+    }
+
+    for (auto & thread: threads)
+    {
+        thread.join();
+    }
+
+    for (size_t i = 1; i <= thread_count * items_per_thread; i++)
+    {
+        ASSERT_EQ((0 == (i % 2)) ? nullptr : as_ptr(i + 1), chmap_get(map, as_ptr(i)));
+    }
+
+    chmap_release(map);
+}
+
+TEST(chmap, lock_free_reads)
+{
+    struct chmap_options options;
+    chmap_options_init(&options);
+    options.map.hash = &string_hash;
+    options.map.equals = &string_equals;
+    options.map.release_key = &free;
+    options.map.release_value = &free;
+    options.lock_free_reads = true;
+    struct chmap * map = chmap_create_ex(&options);
+
+    for (size_t i = 0; i < 500; i++)
+    {
+        std::string key = std::to_string(i);
+        chmap_add(map, strdup(key.c_str()), strdup(key.c_str()));
+    }
+
+    chmap_add(map, strdup("42"), strdup("updated"));
+    chmap_remove(map, "7");
+
+    for (size_t i = 0; i < 500; i++)
+    {
+        std::string key = std::to_string(i);
+        char const * value = reinterpret_cast<char const*>(chmap_get(map, key.c_str()));
+        if (7 == i)
+        {
+            ASSERT_EQ(nullptr, value);
+        }
+        else
+        {
+            ASSERT_STREQ((42 == i) ? "updated" : key.c_str(), value);
+        }
+    }
+
+    chmap_release(map);
+}
+
+TEST(chmap, lock_free_concurrent_access)
+{
+    struct chmap_options options;
+    chmap_options_init(&options);
+    options.map.hash = &size_hash;
+    options.map.equals = &size_equals;
+    options.shard_count = 4;
+    options.lock_free_reads = true;
+    struct chmap * map = chmap_create_ex(&options);
+
+    size_t const key_count = 4000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 2; t++)
+    {
+        threads.emplace_back([map, t, key_count]() {
+            for (size_t round = 0; round < 3; round++)
+            {
+                for (size_t i = 1 + t; i <= key_count; i += 2)
+                {
+                    chmap_add(map, as_ptr(i), as_ptr(i + round));
+                }
+                for (size_t i = 1 + t; i <= key_count; i += 4)
+                {
+                    chmap_remove(map, as_ptr(i));
+                }
+            }
+        });
+    }
+    for (size_t t = 0; t < 4; t++)
+    {
+        threads.emplace_back([map, key_count]() {
+            for (size_t round = 0; round < 20; round++)
+            {
+                for (size_t i = 1; i <= key_count; i++)
+                {
+                    size_t value = reinterpret_cast<size_t>(chmap_get(map, as_ptr(i)));
+                    if ((0 != value) && ((value < i) || (value > (i + 2))))
+                    {
+                        ADD_FAILURE() << "unexpected value " << value << " of key " << i;
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto & thread: threads)
+    {
+        thread.join();
+    }
+
+    for (size_t i = 1; i <= key_count; i++)
+    {
+        bool removed = (1 == (i % 4)) || (2 == (i % 4));
+        ASSERT_EQ(removed ? nullptr : as_ptr(i + 2), chmap_get(map, as_ptr(i)));
+    }
+
+    chmap_release(map);
+}
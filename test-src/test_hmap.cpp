@@ -3,10 +3,15 @@
 
 #include "hmap/hmap.h"
 #include <gtest/gtest.h>
+#include <string>
+#include <vector>
 
 namespace
 {
 
+// decimal digits of SIZE_MAX and '\0'
+constexpr size_t number_size = 21;
+
 size_t string_hash(void const * item, size_t seed)
 {
     (void) seed;
@@ -26,6 +31,20 @@ int string_equals(void const * value, void const * other)
     return strcmp(reinterpret_cast<char const *>(value), reinterpret_cast<char const *>(other));
 }
 
+size_t shifted_hash(void const * item, size_t seed)
+{
+    (void) seed;
+    return static_cast<size_t>(atoi(reinterpret_cast<char const *>(item))) << 16;
+}
+
+size_t hash_calls = 0;
+
+size_t counting_hash(void const * item, size_t seed)
+{
+    hash_calls++;
+    return string_hash(item, seed);
+}
+
 
 }
 
@@ -115,10 +134,10 @@ TEST(hmap, rehash)
     size_t count = 128;
 
     // add some item to hashmap to trigger rehash
-    for(int i = 0; i < count; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        char buffer[10];
-        snprintf(buffer, 10, "%d", i);
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
 
         char * key = strdup(buffer);
         char * value = strdup(buffer);
@@ -126,10 +145,10 @@ TEST(hmap, rehash)
     }
 
     // test if values are contained
-    for(int i = 0; i < count; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        char key[10];
-        snprintf(key, 10, "%d", i);
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
 
         bool is_contained = hmap_contains(map, key);
         ASSERT_TRUE(is_contained);
@@ -195,3 +214,1064 @@ TEST(hmap, iter_some)
 
     hmap_release(map);
 }
+
+namespace
+{
+
+struct hmap * create_open_map()
+{
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &string_hash;
+    options.equals = &string_equals;
+    options.release_key = &free;
+    options.release_value = &free;
+    options.engine = HMAP_ENGINE_OPEN;
+
+    return hmap_create_ex(&options);
+}
+
+}
+
+TEST(hmap, open_add)
+{
+    struct hmap * map = create_open_map();
+
+    hmap_add(map, strdup("key"), strdup("value"));
+    hmap_add(map, strdup("key"), strdup("other"));
+    char const * value = reinterpret_cast<char const *>(hmap_get(map, "key"));
+
+    ASSERT_NE(nullptr, value);
+    ASSERT_STREQ("other", value);
+    ASSERT_FALSE(hmap_contains(map, "unknown"));
+
+    hmap_release(map);
+}
+
+TEST(hmap, open_remove_keeps_colliding_keys)
+{
+    struct hmap * map = create_open_map();
+
+    // all keys have the same length and therefore the same hash
+    hmap_add(map, strdup("a"), strdup("A"));
+    hmap_add(map, strdup("b"), strdup("B"));
+    hmap_add(map, strdup("c"), strdup("C"));
+
+    hmap_remove(map, "a");
+    ASSERT_FALSE(hmap_contains(map, "a"));
+    ASSERT_STREQ("B", reinterpret_cast<char const *>(hmap_get(map, "b")));
+    ASSERT_STREQ("C", reinterpret_cast<char const *>(hmap_get(map, "c")));
+
+    hmap_remove(map, "c");
+
+    // "a", "b" and "c" collide; "b" is chained in front of "a"
+    ASSERT_FALSE(hmap_contains(map, "c"));
+    ASSERT_STREQ("B", reinterpret_cast<char const *>(hmap_get(map, "b")));
+
+    hmap_release(map);
+}
+
+TEST(hmap, open_rehash)
+{
+    struct hmap * map = create_open_map();
+    size_t count = 1000;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        hmap_add(map, strdup(buffer), strdup(buffer));
+    }
+
+    for (size_t i = 0; i < count; i += 2)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        hmap_remove(map, key);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+
+        char const * value = reinterpret_cast<char const *>(hmap_get(map, key));
+        if (0 == (i % 2))
+        {
+            ASSERT_EQ(nullptr, value);
+        }
+        else
+        {
+            ASSERT_NE(nullptr, value);
+            ASSERT_STREQ(key, value);
+        }
+    }
+
+    hmap_release(map);
+}
+
+TEST(hmap, open_iter_some)
+{
+    struct hmap * map = create_open_map();
+
+    hmap_add(map, strdup("1"), strdup("1"));
+    hmap_add(map, strdup("2"), strdup("2"));
+    hmap_add(map, strdup("3"), strdup("3"));
+
+    struct hmap_iter iter;
+    hmap_iter_init(&iter, map);
+
+    size_t count = 0;
+    while (hmap_iter_next(&iter))
+    {
+        count++;
+        char const * key = reinterpret_cast<char const*>(hmap_iter_key(&iter));
+        char const * value = reinterpret_cast<char const*>(hmap_iter_value(&iter));
+        ASSERT_STREQ(key, value);
+    }
+
+    ASSERT_EQ(3, count);
+    ASSERT_FALSE(hmap_iter_next(&iter));
+    ASSERT_EQ(nullptr, hmap_iter_key(&iter));
+
+    hmap_release(map);
+}
+
+TEST(hmap, rehash_does_not_hash_keys)
+{
+    enum hmap_engine engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &counting_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.release_value = &free;
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        hash_calls = 0;
+        size_t count = 128;
+        for (size_t i = 0; i < count; i++)
+        {
+            char buffer[number_size];
+            snprintf(buffer, number_size, "%zu", i);
+            hmap_add(map, strdup(buffer), strdup(buffer));
+        }
+        hmap_remove(map, "0");
+
+        ASSERT_EQ(count + 1, hash_calls);
+        hmap_release(map);
+    }
+}
+
+TEST(hmap, incremental_rehash)
+{
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &string_hash;
+    options.equals = &string_equals;
+    options.release_key = &free;
+    options.release_value = &free;
+    options.incremental_rehash = true;
+    struct hmap * map = hmap_create_ex(&options);
+
+    size_t count = 1000;
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        hmap_add(map, strdup(buffer), strdup(buffer));
+
+        // previously added items stay reachable while entries are moved
+        snprintf(buffer, number_size, "%zu", i / 2);
+        ASSERT_STREQ(buffer, reinterpret_cast<char const *>(hmap_get(map, buffer)));
+    }
+
+    for (size_t i = 0; i < count; i += 2)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        hmap_remove(map, key);
+    }
+
+    struct hmap_iter iter;
+    hmap_iter_init(&iter, map);
+    size_t actual = 0;
+    while (hmap_iter_next(&iter))
+    {
+        actual++;
+        int value = atoi(reinterpret_cast<char const *>(hmap_iter_value(&iter)));
+        ASSERT_EQ(1, value % 2);
+    }
+    ASSERT_EQ(count / 2, actual);
+
+    hmap_release(map);
+}
+
+TEST(hmap, reserve_and_shrink_to_fit)
+{
+    enum hmap_engine engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &string_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.release_value = &free;
+        options.engine = engine;
+        options.capacity = 100;
+        options.max_load_factor = 0.9;
+        struct hmap * map = hmap_create_ex(&options);
+
+        size_t count = 1000;
+        hmap_reserve(map, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            char buffer[number_size];
+            snprintf(buffer, number_size, "%zu", i);
+            hmap_add(map, strdup(buffer), strdup(buffer));
+        }
+
+        for (size_t i = 10; i < count; i++)
+        {
+            char key[number_size];
+            snprintf(key, number_size, "%zu", i);
+            hmap_remove(map, key);
+        }
+        hmap_shrink_to_fit(map);
+
+        for (size_t i = 0; i < 10; i++)
+        {
+            char key[number_size];
+            snprintf(key, number_size, "%zu", i);
+            ASSERT_STREQ(key, reinterpret_cast<char const *>(hmap_get(map, key)));
+        }
+        ASSERT_FALSE(hmap_contains(map, "10"));
+
+        hmap_release(map);
+    }
+}
+
+namespace
+{
+
+struct counting_allocator
+{
+    size_t allocations;
+    size_t bytes;
+    size_t total_allocations;
+};
+
+void * counting_alloc(size_t size, void * context)
+{
+    auto * allocator = reinterpret_cast<counting_allocator*>(context);
+    allocator->allocations++;
+    allocator->total_allocations++;
+    allocator->bytes += size;
+    return malloc(size);
+}
+
+void counting_free(void * ptr, size_t size, void * context)
+{
+    auto * allocator = reinterpret_cast<counting_allocator*>(context);
+    allocator->allocations--;
+    allocator->bytes -= size;
+    free(ptr);
+}
+
+}
+
+TEST(hmap, allocator)
+{
+    enum hmap_engine engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        counting_allocator allocator = { 0, 0, 0 };
+
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &string_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.release_value = &free;
+        options.engine = engine;
+        options.allocator.alloc = &counting_alloc;
+        options.allocator.free = &counting_free;
+        options.allocator.context = &allocator;
+        struct hmap * map = hmap_create_ex(&options);
+
+        size_t count = 1000;
+        for (size_t i = 0; i < count; i++)
+        {
+            char buffer[number_size];
+            snprintf(buffer, number_size, "%zu", i);
+            hmap_add(map, strdup(buffer), strdup(buffer));
+        }
+
+        // slabs are used for nodes, so there are less allocations than items
+        ASSERT_LT(allocator.allocations, count);
+
+        for (size_t i = 0; i < count; i += 2)
+        {
+            char key[number_size];
+            snprintf(key, number_size, "%zu", i);
+            hmap_remove(map, key);
+        }
+        hmap_shrink_to_fit(map);
+        ASSERT_STREQ("1", reinterpret_cast<char const *>(hmap_get(map, "1")));
+
+        hmap_release(map);
+        ASSERT_EQ(0, allocator.allocations);
+        ASSERT_EQ(0, allocator.bytes);
+    }
+}
+
+TEST(hmap, get_or_insert)
+{
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &counting_hash;
+    options.equals = &string_equals;
+    struct hmap * map = hmap_create_ex(&options);
+
+    char const * words[] = { "a", "b", "a", "c", "a", "b" };
+    hash_calls = 0;
+    for (auto word: words)
+    {
+        void ** slot = hmap_get_or_insert(map, const_cast<char*>(word), nullptr);
+        *slot = reinterpret_cast<void*>(reinterpret_cast<size_t>(*slot) + 1);
+    }
+    ASSERT_EQ(6, hash_calls);
+
+    ASSERT_EQ(reinterpret_cast<void const*>(3), hmap_get(map, "a"));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), hmap_get(map, "b"));
+    ASSERT_EQ(reinterpret_cast<void const*>(1), hmap_get(map, "c"));
+
+    hmap_release(map);
+}
+
+TEST(hmap, emplace)
+{
+    struct hmap * map = hmap_create(0, &string_hash, &string_equals, &free, &free);
+
+    bool created = false;
+    void ** slot = hmap_emplace(map, strdup("key"), strdup("value"), &created);
+    ASSERT_TRUE(created);
+    ASSERT_STREQ("value", reinterpret_cast<char const*>(*slot));
+
+    char * key = strdup("key");
+    char * value = strdup("other");
+    slot = hmap_emplace(map, key, value, &created);
+    ASSERT_FALSE(created);
+    ASSERT_STREQ("value", reinterpret_cast<char const*>(*slot));
+    free(key);
+    free(value);
+
+    hmap_release(map);
+}
+
+TEST(hmap, get_batch)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &string_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < 50; i++)
+        {
+            keys.push_back("key" + std::to_string(i));
+            if (0 == (i % 3))
+            {
+                hmap_add(map, strdup(keys[i].c_str()), reinterpret_cast<void*>(i + 1));
+            }
+        }
+
+        std::vector<void const *> key_ptrs;
+        for (auto const & key: keys)
+        {
+            key_ptrs.push_back(key.c_str());
+        }
+
+        std::vector<void const *> values(keys.size());
+        hmap_get_batch(map, key_ptrs.data(), key_ptrs.size(), values.data());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            ASSERT_EQ(hmap_get(map, key_ptrs[i]), values[i]);
+            ASSERT_EQ((0 == (i % 3)) ? reinterpret_cast<void const*>(i + 1) : nullptr, values[i]);
+        }
+
+        hmap_release(map);
+    }
+}
+
+TEST(hmap, stats)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &string_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        struct hmap_stats stats;
+        hmap_get_stats(map, &stats);
+        ASSERT_EQ(0, stats.size);
+        ASSERT_EQ(0, stats.max_probe_length);
+        ASSERT_EQ(0, stats.rehash_count);
+        ASSERT_LT(0, stats.bytes_allocated);
+
+        for (size_t i = 0; i < 100; i++)
+        {
+            hmap_add(map, strdup(std::to_string(i).c_str()), nullptr);
+        }
+
+        hmap_get_stats(map, &stats);
+        ASSERT_EQ(100, stats.size);
+        ASSERT_LE(stats.size, stats.capacity);
+        ASSERT_LT(stats.capacity, stats.bucket_count);
+        ASSERT_DOUBLE_EQ(100.0 / static_cast<double>(stats.bucket_count), stats.load_factor);
+        ASSERT_LT(0, stats.rehash_count);
+
+        // string_hash only depends on the length of a key, so all
+        // keys of the same length collide
+        ASSERT_LE(90, stats.max_probe_length);
+        ASSERT_LT(1.0, stats.mean_probe_length);
+
+        size_t histogram_total = 0;
+        for (size_t i = 0; i < HMAP_STATS_HISTOGRAM_SIZE; i++)
+        {
+            histogram_total += stats.probe_histogram[i];
+        }
+        ASSERT_EQ(100, histogram_total);
+        ASSERT_LE(1, stats.probe_histogram[0]);
+        ASSERT_LE(90 - HMAP_STATS_HISTOGRAM_SIZE, stats.probe_histogram[HMAP_STATS_HISTOGRAM_SIZE - 1]);
+
+        hmap_release(map);
+    }
+}
+
+TEST(hmap, weak_hash_spreads_across_buckets)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &shifted_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        // the low 16 bits of all hashes are zero
+        for (size_t i = 0; i < 1000; i++)
+        {
+            hmap_add(map, strdup(std::to_string(i).c_str()), nullptr);
+        }
+
+        struct hmap_stats stats;
+        hmap_get_stats(map, &stats);
+        ASSERT_EQ(1000, stats.size);
+        ASSERT_GE(8, stats.max_probe_length);
+
+        hmap_release(map);
+    }
+}
+
+#ifdef HMAP_WITH_STATS
+TEST(hmap, stats_counters)
+{
+    struct hmap * map = hmap_create(0, &string_hash, &string_equals, nullptr, nullptr);
+
+    hmap_add(map, const_cast<char*>("a"), nullptr);
+    hmap_add(map, const_cast<char*>("b"), nullptr);
+    hmap_get(map, "a");
+    hmap_get(map, "bb");
+    hmap_remove(map, "c");
+
+    // "a", "b" and "c" collide; "b" is chained in front of "a"
+
+    struct hmap_stats stats;
+    hmap_get_stats(map, &stats);
+    ASSERT_EQ(5, stats.lookups);
+    ASSERT_EQ(4, stats.misses);
+    ASSERT_EQ(5, stats.comparisons);
+
+    hmap_release(map);
+}
+#endif
+
+namespace
+{
+
+struct point
+{
+    double x;
+    double y;
+};
+
+size_t inline_releases = 0;
+
+void count_inline_release(void * value)
+{
+    point const * p = reinterpret_cast<point const *>(value);
+    if (p->x == (p->y * 2))
+    {
+        inline_releases++;
+    }
+}
+
+}
+
+TEST(hmap, inline_values)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &string_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.release_value = &count_inline_release;
+        options.value_size = sizeof(point);
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        inline_releases = 0;
+        for (size_t i = 0; i < 100; i++)
+        {
+            point p = { static_cast<double>(i * 2), static_cast<double>(i) };
+            hmap_add(map, strdup(std::to_string(i).c_str()), &p);
+        }
+
+        point const * p = reinterpret_cast<point const *>(hmap_get(map, "42"));
+        ASSERT_NE(nullptr, p);
+        ASSERT_EQ(84.0, p->x);
+        ASSERT_EQ(42.0, p->y);
+        ASSERT_EQ(nullptr, hmap_get(map, "100"));
+
+        bool created = false;
+        point * q = reinterpret_cast<point *>(hmap_get_or_insert(map, strdup("new"), &created));
+        ASSERT_TRUE(created);
+        ASSERT_EQ(0.0, q->x);
+        ASSERT_EQ(0.0, q->y);
+
+        hmap_remove(map, "42");
+        ASSERT_EQ(1, inline_releases);
+
+        size_t count = 0;
+        struct hmap_iter iter;
+        hmap_iter_init(&iter, map);
+        while (hmap_iter_next(&iter))
+        {
+            point const * value = reinterpret_cast<point const *>(hmap_iter_value(&iter));
+            ASSERT_EQ(value->x, value->y * 2);
+            count++;
+        }
+        ASSERT_EQ(100, count);
+
+        hmap_release(map);
+        ASSERT_EQ(101, inline_releases);
+    }
+}
+
+namespace
+{
+
+size_t fnv1a_hash(void const * item, size_t seed)
+{
+    char const * value = reinterpret_cast<char const *>(item);
+    uint64_t result = UINT64_C(0xcbf29ce484222325) ^ seed;
+
+    for (size_t i = 0; '\0' != value[i]; i++)
+    {
+        result ^= static_cast<unsigned char>(value[i]);
+        result *= UINT64_C(0x100000001b3);
+    }
+
+    return static_cast<size_t>(result);
+}
+
+// collides for the default seed only
+size_t weak_default_seed_hash(void const * item, size_t seed)
+{
+    return (0 == seed) ? string_hash(item, seed) : fnv1a_hash(item, seed);
+}
+
+}
+
+TEST(hmap, freeze)
+{
+    struct hmap * map = hmap_create(0, &fnv1a_hash, &string_equals, &free, &free);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = "key_" + std::to_string(i);
+        hmap_add(map, strdup(key.c_str()), strdup(std::to_string(i).c_str()));
+    }
+
+    struct hmap_frozen * frozen = hmap_freeze(map);
+    ASSERT_NE(nullptr, frozen);
+    ASSERT_EQ(1000, hmap_frozen_size(frozen));
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = "key_" + std::to_string(i);
+        char const * value = reinterpret_cast<char const *>(hmap_frozen_get(frozen, key.c_str()));
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(std::to_string(i), value);
+    }
+
+    ASSERT_FALSE(hmap_frozen_contains(frozen, "key_1000"));
+    ASSERT_FALSE(hmap_frozen_contains(frozen, "unknown"));
+
+    hmap_frozen_release(frozen);
+}
+
+TEST(hmap, freeze_fails_on_equal_hashes)
+{
+    struct hmap * map = hmap_create(0, &string_hash, &string_equals, &free, &free);
+    hmap_add(map, strdup("ab"), strdup("1"));
+    hmap_add(map, strdup("cd"), strdup("2"));
+
+    ASSERT_EQ(nullptr, hmap_freeze(map));
+    ASSERT_STREQ("2", reinterpret_cast<char const *>(hmap_get(map, "cd")));
+
+    hmap_release(map);
+
+    struct hmap * empty = hmap_create(0, &string_hash, &string_equals, &free, &free);
+    struct hmap_frozen * frozen = hmap_freeze(empty);
+    ASSERT_NE(nullptr, frozen);
+    ASSERT_EQ(0, hmap_frozen_size(frozen));
+    ASSERT_EQ(nullptr, hmap_frozen_get(frozen, "ab"));
+    hmap_frozen_release(frozen);
+}
+
+TEST(hmap, freeze_rehashes_colliding_keys)
+{
+    struct hmap * map = hmap_create(0, &weak_default_seed_hash, &string_equals, &free, &free);
+    hmap_add(map, strdup("ab"), strdup("1"));
+    hmap_add(map, strdup("cd"), strdup("2"));
+    hmap_add(map, strdup("ef"), strdup("3"));
+
+    struct hmap_frozen * frozen = hmap_freeze(map);
+    ASSERT_NE(nullptr, frozen);
+    ASSERT_EQ(3, hmap_frozen_size(frozen));
+    ASSERT_STREQ("1", reinterpret_cast<char const *>(hmap_frozen_get(frozen, "ab")));
+    ASSERT_STREQ("2", reinterpret_cast<char const *>(hmap_frozen_get(frozen, "cd")));
+    ASSERT_STREQ("3", reinterpret_cast<char const *>(hmap_frozen_get(frozen, "ef")));
+    ASSERT_FALSE(hmap_frozen_contains(frozen, "gh"));
+
+    hmap_frozen_release(frozen);
+}
+
+TEST(hmap, dense_insertion_order)
+{
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &fnv1a_hash;
+    options.equals = &string_equals;
+    options.release_key = &free;
+    options.engine = HMAP_ENGINE_DENSE;
+    struct hmap * map = hmap_create_ex(&options);
+
+    // grows beyond 8 and 16 bit indices
+    size_t const count = 70000;
+    for (size_t i = 0; i < count; i++)
+    {
+        hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i + 1));
+    }
+    for (size_t i = 0; i < count; i += 2)
+    {
+        hmap_remove(map, std::to_string(i).c_str());
+    }
+    for (size_t i = 0; i < count; i += 4)
+    {
+        hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i + 1));
+    }
+
+    // odd keys remain in their order, re-added keys follow
+    std::vector<size_t> expected;
+    for (size_t i = 1; i < count; i += 2) { expected.push_back(i + 1); }
+    for (size_t i = 0; i < count; i += 4) { expected.push_back(i + 1); }
+
+    std::vector<size_t> actual;
+    struct hmap_iter iter;
+    hmap_iter_init(&iter, map);
+    while (hmap_iter_next(&iter))
+    {
+        actual.push_back(reinterpret_cast<size_t>(hmap_iter_value(&iter)));
+        ASSERT_EQ(std::to_string(actual.back() - 1), reinterpret_cast<char const *>(hmap_iter_key(&iter)));
+    }
+    ASSERT_EQ(expected, actual);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        bool const present = (1 == (i % 2)) || (0 == (i % 4));
+        ASSERT_EQ(present, hmap_contains(map, std::to_string(i).c_str()));
+    }
+
+    hmap_shrink_to_fit(map);
+    ASSERT_EQ(reinterpret_cast<void const *>(2), hmap_get(map, "1"));
+
+    hmap_release(map);
+}
+
+TEST(hmap, dense_churn_at_threshold)
+{
+    counting_allocator allocator = { 0, 0, 0 };
+
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &fnv1a_hash;
+    options.equals = &string_equals;
+    options.release_key = &free;
+    options.engine = HMAP_ENGINE_DENSE;
+    options.allocator.alloc = &counting_alloc;
+    options.allocator.free = &counting_free;
+    options.allocator.context = &allocator;
+    struct hmap * map = hmap_create_ex(&options);
+
+    struct hmap_stats stats;
+    hmap_get_stats(map, &stats);
+    size_t key = 0;
+    while (stats.size < 1000)
+    {
+        hmap_add(map, strdup(std::to_string(key).c_str()), reinterpret_cast<void *>(key + 1));
+        key++;
+        hmap_get_stats(map, &stats);
+    }
+    while (stats.size < stats.capacity)
+    {
+        hmap_add(map, strdup(std::to_string(key).c_str()), reinterpret_cast<void *>(key + 1));
+        key++;
+        hmap_get_stats(map, &stats);
+    }
+
+    // each removal leaves a hole; holes are reclaimed in batches
+    size_t const churn = 10000;
+    size_t const allocations = allocator.total_allocations;
+    for (size_t i = 0; i < churn; i++)
+    {
+        std::string const oldest = std::to_string(key - stats.size);
+        ASSERT_TRUE(hmap_contains(map, oldest.c_str()));
+        hmap_remove(map, oldest.c_str());
+        hmap_add(map, strdup(std::to_string(key).c_str()), reinterpret_cast<void *>(key + 1));
+        key++;
+    }
+    ASSERT_GT(allocations + (churn / 100), allocator.total_allocations);
+
+    hmap_get_stats(map, &stats);
+    ASSERT_EQ(stats.capacity, stats.size);
+    ASSERT_TRUE(hmap_contains(map, std::to_string(key - 1).c_str()));
+    ASSERT_FALSE(hmap_contains(map, std::to_string(key - stats.size - 1).c_str()));
+
+    hmap_release(map);
+    ASSERT_EQ(0, allocator.allocations);
+}
+
+TEST(hmap, shrink_to_fit_releases_memory)
+{
+    enum hmap_engine engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    for (auto engine: engines)
+    {
+        counting_allocator allocator = { 0, 0, 0 };
+
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &fnv1a_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.engine = engine;
+        options.allocator.alloc = &counting_alloc;
+        options.allocator.free = &counting_free;
+        options.allocator.context = &allocator;
+        struct hmap * map = hmap_create_ex(&options);
+        size_t const empty_bytes = allocator.bytes;
+
+        size_t const count = 10000;
+        for (size_t i = 0; i < count; i++)
+        {
+            hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i + 1));
+        }
+        size_t const full_bytes = allocator.bytes;
+
+        for (size_t i = 1; i < count; i++)
+        {
+            hmap_remove(map, std::to_string(i).c_str());
+        }
+        hmap_shrink_to_fit(map);
+
+        ASSERT_GT(full_bytes / 10, allocator.bytes);
+        ASSERT_GE(empty_bytes + 1024, allocator.bytes);
+        ASSERT_EQ(reinterpret_cast<void *>(1), hmap_get(map, "0"));
+
+        hmap_add(map, strdup("1"), reinterpret_cast<void *>(2));
+        ASSERT_EQ(reinterpret_cast<void *>(2), hmap_get(map, "1"));
+
+        hmap_release(map);
+        ASSERT_EQ(0, allocator.bytes);
+    }
+}
+
+namespace
+{
+
+// home slots are at the end of the table, so runs of colliding keys wrap around
+size_t wrapping_hash(void const * item, size_t seed)
+{
+    return SIZE_MAX - string_hash(item, seed);
+}
+
+bool keep_odd(void const * key, void const * value, void * context)
+{
+    (void) key;
+    (*reinterpret_cast<size_t *>(context))++;
+    return (1 == (reinterpret_cast<size_t>(value) % 2));
+}
+
+}
+
+TEST(hmap, iter_remove)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    hmap_hash_fn * const hashes[] = { &string_hash, &wrapping_hash, &fnv1a_hash };
+
+    for (auto engine: engines)
+    {
+        for (auto hash: hashes)
+        {
+            struct hmap_options options;
+            hmap_options_init(&options);
+            options.hash = hash;
+            options.equals = &string_equals;
+            options.release_key = &free;
+            options.engine = engine;
+            options.incremental_rehash = true;
+            struct hmap * map = hmap_create_ex(&options);
+
+            size_t const count = 1000;
+            for (size_t i = 0; i < count; i++)
+            {
+                hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i));
+            }
+
+            // each item is fetched exactly once, although even items are removed
+            std::vector<size_t> visits(count, 0);
+            struct hmap_iter iter;
+            hmap_iter_init(&iter, map);
+            while (hmap_iter_next(&iter))
+            {
+                size_t value = reinterpret_cast<size_t>(hmap_iter_value(&iter));
+                visits[value]++;
+                if (0 == (value % 2))
+                {
+                    hmap_iter_remove(&iter);
+                    ASSERT_EQ(nullptr, hmap_iter_key(&iter));
+                    hmap_iter_remove(&iter);
+                }
+            }
+            ASSERT_EQ(std::vector<size_t>(count, 1), visits);
+
+            struct hmap_stats stats;
+            hmap_get_stats(map, &stats);
+            ASSERT_EQ(count / 2, stats.size);
+            for (size_t i = 0; i < count; i++)
+            {
+                ASSERT_EQ(1 == (i % 2), hmap_contains(map, std::to_string(i).c_str()));
+            }
+
+            hmap_release(map);
+        }
+    }
+}
+
+TEST(hmap, retain)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+
+    for (auto engine: engines)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &wrapping_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.engine = engine;
+        struct hmap * map = hmap_create_ex(&options);
+
+        size_t const count = 500;
+        for (size_t i = 0; i < count; i++)
+        {
+            hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i));
+        }
+
+        size_t calls = 0;
+        hmap_retain(map, &keep_odd, &calls);
+        ASSERT_EQ(count, calls);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            ASSERT_EQ(1 == (i % 2), hmap_contains(map, std::to_string(i).c_str()));
+        }
+
+        hmap_release(map);
+    }
+}
+
+namespace
+{
+
+size_t bulk_releases = 0;
+
+void count_bulk_release(void * value)
+{
+    (void) value;
+    bulk_releases++;
+}
+
+}
+
+TEST(hmap, build_bulk)
+{
+    enum hmap_engine const engines[] = { HMAP_ENGINE_CHAINED, HMAP_ENGINE_OPEN, HMAP_ENGINE_DENSE };
+    hmap_hash_fn * const hashes[] = { &fnv1a_hash, &wrapping_hash };
+    size_t const thread_counts[] = { 1, 4, 0 };
+
+    for (auto engine: engines)
+    {
+        for (auto hash: hashes)
+        {
+            for (auto thread_count: thread_counts)
+            {
+                struct hmap_options options;
+                hmap_options_init(&options);
+                options.hash = hash;
+                options.equals = &string_equals;
+                options.release_key = &free;
+                options.release_value = &count_bulk_release;
+                options.engine = engine;
+
+                // each key is contained twice, the second time with a larger value
+                size_t const count = (&fnv1a_hash == hash) ? 100000 : 2000;
+                std::vector<void *> keys;
+                std::vector<void *> values;
+                for (size_t i = 0; i < (2 * count); i++)
+                {
+                    keys.push_back(strdup(std::to_string(i % count).c_str()));
+                    values.push_back(reinterpret_cast<void *>(i + 1));
+                }
+
+                bulk_releases = 0;
+                struct hmap * map = hmap_build_bulk(&options, keys.data(), values.data(), keys.size(), thread_count);
+                ASSERT_EQ(count, bulk_releases);
+
+                struct hmap_stats stats;
+                hmap_get_stats(map, &stats);
+                ASSERT_EQ(count, stats.size);
+                for (size_t i = 0; i < count; i++)
+                {
+                    ASSERT_EQ(reinterpret_cast<void const *>(count + i + 1), hmap_get(map, std::to_string(i).c_str()));
+                }
+
+                // the map can be changed as usual
+                hmap_remove(map, "0");
+                hmap_add(map, strdup("new"), nullptr);
+                ASSERT_FALSE(hmap_contains(map, "0"));
+                ASSERT_TRUE(hmap_contains(map, "1"));
+
+                hmap_release(map);
+            }
+        }
+    }
+}
+
+TEST(hmap, build_bulk_keeps_insertion_order)
+{
+    struct hmap_options options;
+    hmap_options_init(&options);
+    options.hash = &fnv1a_hash;
+    options.equals = &string_equals;
+    options.engine = HMAP_ENGINE_DENSE;
+
+    std::vector<std::string> names;
+    std::vector<void *> keys;
+    for (size_t i = 0; i < 5000; i++)
+    {
+        names.push_back(std::to_string((i * 7919) % 5000));
+    }
+    names.push_back(names[0]);
+    for (auto & name: names)
+    {
+        keys.push_back(const_cast<char *>(name.c_str()));
+    }
+
+    struct hmap * map = hmap_build_bulk(&options, keys.data(), nullptr, keys.size(), 4);
+
+    // the duplicate of the first key does not change its position
+    std::vector<std::string> actual;
+    struct hmap_iter iter;
+    hmap_iter_init(&iter, map);
+    while (hmap_iter_next(&iter))
+    {
+        actual.push_back(reinterpret_cast<char const *>(hmap_iter_key(&iter)));
+    }
+    names.pop_back();
+    ASSERT_EQ(names, actual);
+
+    hmap_release(map);
+}
+
+TEST(hmap, parallel_rehash)
+{
+    size_t const thread_counts[] = { 4, 0 };
+
+    for (auto thread_count: thread_counts)
+    {
+        struct hmap_options options;
+        hmap_options_init(&options);
+        options.hash = &fnv1a_hash;
+        options.equals = &string_equals;
+        options.release_key = &free;
+        options.rehash_threads = thread_count;
+        struct hmap * map = hmap_create_ex(&options);
+
+        // grows beyond the minimal bucket count of parallel rehashing
+        size_t const count = 200000;
+        for (size_t i = 0; i < count; i++)
+        {
+            hmap_add(map, strdup(std::to_string(i).c_str()), reinterpret_cast<void *>(i + 1));
+        }
+        hmap_reserve(map, 4 * count);
+        for (size_t i = 0; i < count; i += 2)
+        {
+            hmap_remove(map, std::to_string(i).c_str());
+        }
+        hmap_shrink_to_fit(map);
+
+        struct hmap_stats stats;
+        hmap_get_stats(map, &stats);
+        ASSERT_EQ(count / 2, stats.size);
+        for (size_t i = 0; i < count; i++)
+        {
+            void const * expected = (1 == (i % 2)) ? reinterpret_cast<void const *>(i + 1) : nullptr;
+            ASSERT_EQ(expected, hmap_get(map, std::to_string(i).c_str()));
+        }
+
+        hmap_release(map);
+    }
+}
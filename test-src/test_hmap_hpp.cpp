@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/hmap.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+
+struct identity_hash
+{
+    size_t operator()(int value) const
+    {
+        return static_cast<size_t>(value);
+    }
+};
+
+// copies throw once the budget is used up; moves may throw, so rehashing copies
+struct throwing_value
+{
+    static int copy_budget;
+
+    explicit throwing_value(int value_): value(value_) { }
+
+    throwing_value(throwing_value const & other)
+    : value(other.value)
+    {
+        if (0 == copy_budget)
+        {
+            throw std::runtime_error("copy failed");
+        }
+        copy_budget--;
+    }
+
+    throwing_value(throwing_value && other) noexcept(false)
+    : value(other.value)
+    {
+        other.value = -1;
+    }
+
+    throwing_value & operator=(throwing_value const &) = default;
+
+    int value;
+};
+
+int throwing_value::copy_budget = 0;
+
+}
+
+TEST(hmap_hpp, add_get_remove)
+{
+    hmap_cpp::map<std::string, std::string> map;
+    ASSERT_TRUE(map.empty());
+
+    ASSERT_TRUE(map.add(std::string("key"), std::string("value")));
+    ASSERT_FALSE(map.add(std::string("key"), std::string("other")));
+    ASSERT_EQ(1, map.size());
+    ASSERT_EQ("other", *map.get("key"));
+    ASSERT_EQ(nullptr, map.get("unknown"));
+    ASSERT_TRUE(map.contains("key"));
+
+    ASSERT_TRUE(map.remove("key"));
+    ASSERT_FALSE(map.remove("key"));
+    ASSERT_FALSE(map.contains("key"));
+    ASSERT_TRUE(map.empty());
+}
+
+TEST(hmap_hpp, grow_and_remove_many)
+{
+    hmap_cpp::map<int, int, identity_hash> map;
+    for (int i = 0; i < 10000; i++)
+    {
+        map.add(i, 2 * i);
+    }
+    ASSERT_EQ(10000, map.size());
+
+    for (int i = 0; i < 10000; i += 2)
+    {
+        ASSERT_TRUE(map.remove(i));
+    }
+    ASSERT_EQ(5000, map.size());
+
+    for (int i = 0; i < 10000; i++)
+    {
+        int const * value = map.get(i);
+        if (0 == (i % 2))
+        {
+            ASSERT_EQ(nullptr, value);
+        }
+        else
+        {
+            ASSERT_NE(nullptr, value);
+            ASSERT_EQ(2 * i, *value);
+        }
+    }
+
+    map.shrink_to_fit();
+    ASSERT_EQ(5000, map.size());
+    ASSERT_EQ(2, *map.get(1));
+}
+
+TEST(hmap_hpp, move_only_values)
+{
+    hmap_cpp::map<int, std::unique_ptr<std::string>> map;
+    map.add(1, std::unique_ptr<std::string>(new std::string("one")));
+
+    auto result = map.emplace(2, new std::string("two"));
+    ASSERT_TRUE(result.second);
+    ASSERT_EQ("two", **result.first);
+
+    result = map.emplace(2, std::unique_ptr<std::string>(new std::string("ignored")));
+    ASSERT_FALSE(result.second);
+    ASSERT_EQ("two", **result.first);
+
+    std::unique_ptr<std::string> & value = map.get_or_insert(3);
+    ASSERT_EQ(nullptr, value);
+    value.reset(new std::string("three"));
+
+    map.reserve(1000);
+    ASSERT_EQ("one", **map.get(1));
+    ASSERT_EQ("three", **map.get(3));
+
+    hmap_cpp::map<int, std::unique_ptr<std::string>> other(std::move(map));
+    ASSERT_EQ(3, other.size());
+    ASSERT_EQ(0, map.size());
+    ASSERT_EQ(nullptr, map.get(1));
+    ASSERT_EQ("two", **other.get(2));
+
+    map.add(4, std::unique_ptr<std::string>(new std::string("four")));
+    ASSERT_EQ("four", **map.get(4));
+}
+
+TEST(hmap_hpp, iterate)
+{
+    hmap_cpp::map<int, int> map;
+    for (int i = 0; i < 100; i++)
+    {
+        map.get_or_insert(i) = i + 1;
+    }
+
+    int key_sum = 0;
+    int value_sum = 0;
+    for (auto entry: map)
+    {
+        key_sum += entry.first;
+        value_sum += entry.second;
+    }
+
+    ASSERT_EQ(4950, key_sum);
+    ASSERT_EQ(5050, value_sum);
+
+    for (auto entry: map)
+    {
+        entry.second *= 2;
+    }
+
+    hmap_cpp::map<int, int> const & const_map = map;
+    static_assert(std::is_same<int const &, decltype((*const_map.begin()).second)>::value, "values of const maps are const");
+    static_assert(std::is_same<int &, decltype(map.begin()->second)>::value, "values of maps are mutable");
+    value_sum = 0;
+    for (auto it = const_map.begin(); it != const_map.end(); it++)
+    {
+        value_sum += it->second;
+        ASSERT_EQ(2 * (it->first + 1), it->second);
+    }
+    ASSERT_EQ(10100, value_sum);
+}
+
+TEST(hmap_hpp, reserve_moved_from_map)
+{
+    hmap_cpp::map<int, int> map;
+    map.add(1, 1);
+
+    hmap_cpp::map<int, int> other(std::move(map));
+    map.reserve(100);
+    map.shrink_to_fit();
+    ASSERT_EQ(0, map.size());
+    ASSERT_EQ(map.end(), map.begin());
+
+    map.add(2, 2);
+    ASSERT_EQ(2, *map.get(2));
+    ASSERT_EQ(1, *other.get(1));
+}
+
+TEST(hmap_hpp, failed_rehash_leaves_map_unchanged)
+{
+    hmap_cpp::map<int, throwing_value> map;
+    size_t const count = 12;
+    for (size_t i = 0; i < count; i++)
+    {
+        map.emplace(static_cast<int>(i), static_cast<int>(i));
+    }
+
+    throwing_value::copy_budget = 5;
+    ASSERT_THROW(map.reserve(1000), std::runtime_error);
+
+    ASSERT_EQ(count, map.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        throwing_value const * value = map.get(static_cast<int>(i));
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(static_cast<int>(i), value->value);
+    }
+
+    throwing_value::copy_budget = 1000;
+    map.reserve(1000);
+    ASSERT_EQ(count, map.size());
+    ASSERT_EQ(7, map.get(7)->value);
+}
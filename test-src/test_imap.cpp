@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Falk Werner
+
+#include "hmap/imap.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <map>
+
+TEST(imap, create)
+{
+    struct imap * map = imap_create(0, &free);
+    ASSERT_NE(nullptr, map);
+    imap_release(map);
+}
+
+TEST(imap, add)
+{
+    struct imap * map = imap_create(0, &free);
+
+    imap_add(map, 42, strdup("value"));
+    ASSERT_STREQ("value", reinterpret_cast<char const*>(imap_get(map, 42)));
+    ASSERT_TRUE(imap_contains(map, 42));
+    ASSERT_FALSE(imap_contains(map, 0));
+
+    imap_add(map, 42, strdup("updated"));
+    ASSERT_STREQ("updated", reinterpret_cast<char const*>(imap_get(map, 42)));
+
+    imap_add(map, 0, strdup("zero"));
+    ASSERT_STREQ("zero", reinterpret_cast<char const*>(imap_get(map, 0)));
+
+    imap_release(map);
+}
+
+TEST(imap, remove)
+{
+    struct imap * map = imap_create(0, &free);
+
+    imap_add(map, 1, strdup("one"));
+    imap_add(map, UINT64_MAX, strdup("max"));
+    imap_remove(map, 1);
+    imap_remove(map, 2);
+
+    ASSERT_FALSE(imap_contains(map, 1));
+    ASSERT_TRUE(imap_contains(map, UINT64_MAX));
+
+    imap_release(map);
+}
+
+TEST(imap, get_or_insert)
+{
+    struct imap * map = imap_create(0, nullptr);
+
+    uint64_t const keys[] = { 7, 3, 7, 7, 3, 1 };
+    for (auto key: keys)
+    {
+        void ** slot = imap_get_or_insert(map, key, nullptr);
+        *slot = reinterpret_cast<void*>(reinterpret_cast<size_t>(*slot) + 1);
+    }
+
+    ASSERT_EQ(reinterpret_cast<void const*>(3), imap_get(map, 7));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), imap_get(map, 3));
+    ASSERT_EQ(reinterpret_cast<void const*>(1), imap_get(map, 1));
+
+    imap_release(map);
+}
+
+TEST(imap, rehash_and_iterate)
+{
+    struct imap_options options;
+    imap_options_init(&options);
+    options.seed = 23;
+    struct imap * map = imap_create_ex(&options);
+
+    std::map<uint64_t, size_t> expected;
+    for (uint64_t i = 0; i < 10000; i++)
+    {
+        uint64_t key = i * UINT64_C(0x100000001);
+        imap_add(map, key, reinterpret_cast<void*>(i + 1));
+        expected[key] = i + 1;
+    }
+
+    for (uint64_t i = 0; i < 10000; i += 3)
+    {
+        uint64_t key = i * UINT64_C(0x100000001);
+        imap_remove(map, key);
+        expected.erase(key);
+    }
+
+    imap_shrink_to_fit(map);
+
+    std::map<uint64_t, size_t> actual;
+    struct imap_iter iter;
+    imap_iter_init(&iter, map);
+    while (imap_iter_next(&iter))
+    {
+        actual[imap_iter_key(&iter)] = reinterpret_cast<size_t>(imap_iter_value(&iter));
+    }
+    ASSERT_EQ(expected, actual);
+
+    for (auto const & item: expected)
+    {
+        ASSERT_EQ(reinterpret_cast<void const*>(item.second), imap_get(map, item.first));
+    }
+
+    imap_release(map);
+}
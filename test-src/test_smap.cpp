@@ -3,7 +3,16 @@
 
 #include "hmap/smap.h"
 #include <gtest/gtest.h>
+#include <string>
+#include <vector>
 
+namespace
+{
+
+// decimal digits of SIZE_MAX and '\0'
+constexpr size_t number_size = 21;
+
+}
 
 TEST(smap, create)
 {
@@ -90,10 +99,10 @@ TEST(smap, rehash)
     size_t count = 128;
 
     // add some item to hashmap to trigger rehash
-    for(int i = 0; i < count; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        char buffer[10];
-        snprintf(buffer, 10, "%d", i);
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
 
         char * key = buffer;
         char * value = strdup(buffer);
@@ -101,10 +110,10 @@ TEST(smap, rehash)
     }
 
     // test if values are contained
-    for(int i = 0; i < count; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        char key[10];
-        snprintf(key, 10, "%d", i);
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
 
         bool is_contained = smap_contains(map, key);
         ASSERT_TRUE(is_contained);
@@ -171,3 +180,941 @@ TEST(smap, iter_some)
 
     smap_release(map);
 }
+
+namespace
+{
+
+struct smap * create_open_map()
+{
+    struct smap_options options;
+    smap_options_init(&options);
+    options.release_value = &free;
+    options.engine = SMAP_ENGINE_OPEN;
+
+    return smap_create_ex(&options);
+}
+
+}
+
+TEST(smap, open_add_remove)
+{
+    struct smap * map = create_open_map();
+    size_t count = 1000;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        smap_add(map, buffer, strdup(buffer));
+    }
+
+    smap_add(map, "42", strdup("other"));
+    ASSERT_STREQ("other", reinterpret_cast<char const *>(smap_get(map, "42")));
+
+    for (size_t i = 0; i < count; i += 3)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        smap_remove(map, key);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        ASSERT_EQ((0 != (i % 3)), smap_contains(map, key));
+    }
+
+    smap_release(map);
+}
+
+TEST(smap, open_iter)
+{
+    struct smap * map = create_open_map();
+    size_t count = 100;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        smap_add(map, buffer, strdup(buffer));
+    }
+
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+
+    size_t actual = 0;
+    while (smap_iter_next(&iter))
+    {
+        actual++;
+        ASSERT_STREQ(smap_iter_key(&iter), reinterpret_cast<char const *>(smap_iter_value(&iter)));
+    }
+
+    ASSERT_EQ(count, actual);
+
+    smap_release(map);
+}
+
+TEST(smap, incremental_rehash)
+{
+    struct smap_options options;
+    smap_options_init(&options);
+    options.release_value = &free;
+    options.incremental_rehash = true;
+    struct smap * map = smap_create_ex(&options);
+
+    size_t count = 1000;
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        smap_add(map, buffer, strdup(buffer));
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        ASSERT_STREQ(key, reinterpret_cast<char const *>(smap_get(map, key)));
+        smap_remove(map, key);
+        ASSERT_FALSE(smap_contains(map, key));
+    }
+
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+    ASSERT_FALSE(smap_iter_next(&iter));
+
+    smap_release(map);
+}
+
+TEST(smap, reserve_and_shrink_to_fit)
+{
+    struct smap * map = smap_create(0, &free);
+
+    size_t count = 1000;
+    smap_reserve(map, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        smap_add(map, buffer, strdup(buffer));
+    }
+
+    for (size_t i = 1; i < count; i++)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        smap_remove(map, key);
+    }
+    smap_shrink_to_fit(map);
+
+    ASSERT_STREQ("0", reinterpret_cast<char const *>(smap_get(map, "0")));
+    ASSERT_FALSE(smap_contains(map, "1"));
+
+    smap_release(map);
+}
+
+namespace
+{
+
+struct arena
+{
+    char buffer[64 * 1024];
+    size_t used;
+};
+
+void * arena_alloc(size_t size, void * context)
+{
+    auto * instance = reinterpret_cast<arena*>(context);
+    size = (size + 15) & ~((size_t) 15);
+
+    void * result = nullptr;
+    if ((instance->used + size) <= sizeof(instance->buffer))
+    {
+        result = &(instance->buffer[instance->used]);
+        instance->used += size;
+    }
+
+    return result;
+}
+
+}
+
+TEST(smap, arena_allocator)
+{
+    auto * memory = new arena();
+    memory->used = 0;
+
+    struct smap_options options;
+    smap_options_init(&options);
+    options.allocator.alloc = &arena_alloc;
+    options.allocator.free = nullptr;
+    options.allocator.context = memory;
+    struct smap * map = smap_create_ex(&options);
+
+    size_t count = 100;
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[number_size];
+        snprintf(buffer, number_size, "%zu", i);
+        smap_add(map, buffer, reinterpret_cast<void*>(i + 1));
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[number_size];
+        snprintf(key, number_size, "%zu", i);
+        ASSERT_EQ(reinterpret_cast<void const*>(i + 1), smap_get(map, key));
+    }
+
+    ASSERT_LT(0, memory->used);
+    smap_release(map);
+    delete memory;
+}
+
+TEST(smap, long_keys)
+{
+    struct smap * map = smap_create(0, &free);
+    size_t count = 1000;
+
+    std::string prefix(40, 'x');
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string key = prefix + std::to_string(i);
+        smap_add(map, key.c_str(), strdup(key.c_str()));
+    }
+
+    // removing most keys compacts the key storage
+    for (size_t i = 0; i < count; i++)
+    {
+        if (0 != (i % 10))
+        {
+            std::string key = prefix + std::to_string(i);
+            smap_remove(map, key.c_str());
+        }
+    }
+    smap_add(map, "short", strdup("short"));
+
+    size_t actual = 0;
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+    while (smap_iter_next(&iter))
+    {
+        actual++;
+        ASSERT_STREQ(smap_iter_key(&iter), reinterpret_cast<char const*>(smap_iter_value(&iter)));
+    }
+    ASSERT_EQ((count / 10) + 1, actual);
+
+    smap_shrink_to_fit(map);
+    for (size_t i = 0; i < count; i += 10)
+    {
+        std::string key = prefix + std::to_string(i);
+        ASSERT_STREQ(key.c_str(), reinterpret_cast<char const*>(smap_get(map, key.c_str())));
+    }
+    ASSERT_FALSE(smap_contains(map, (prefix + "1").c_str()));
+
+    smap_release(map);
+}
+
+TEST(smap, add_slice_of_stored_key)
+{
+    struct smap * map = smap_create(0, &free);
+
+    std::string long_key;
+    for (size_t i = 0; long_key.size() < 200; i++)
+    {
+        long_key += std::to_string(i);
+    }
+    smap_add(map, long_key.c_str(), strdup(long_key.c_str()));
+
+    // slices point into the key storage, which grows while they are added
+    size_t const count = 100;
+    for (size_t i = 1; i <= count; i++)
+    {
+        struct smap_iter iter;
+        smap_iter_init(&iter, map);
+        char const * key = nullptr;
+        while ((nullptr == key) && (smap_iter_next(&iter)))
+        {
+            key = (long_key.size() == strlen(smap_iter_key(&iter))) ? smap_iter_key(&iter) : nullptr;
+        }
+        ASSERT_NE(nullptr, key);
+
+        std::string const slice = long_key.substr(0, long_key.size() - i);
+        smap_add_n(map, key, slice.size(), strdup(slice.c_str()));
+    }
+
+    for (size_t i = 0; i <= count; i++)
+    {
+        std::string const slice = long_key.substr(0, long_key.size() - i);
+        ASSERT_STREQ(slice.c_str(), reinterpret_cast<char const*>(smap_get(map, slice.c_str())));
+    }
+
+    smap_release(map);
+}
+
+TEST(smap, inline_key_boundary)
+{
+    struct smap * map = smap_create(0, nullptr);
+
+    smap_add(map, "123456789012345", reinterpret_cast<void*>(15));
+    smap_add(map, "1234567890123456", reinterpret_cast<void*>(16));
+    smap_add(map, "", reinterpret_cast<void*>(1));
+
+    ASSERT_EQ(reinterpret_cast<void*>(15), smap_get(map, "123456789012345"));
+    ASSERT_EQ(reinterpret_cast<void*>(16), smap_get(map, "1234567890123456"));
+    ASSERT_EQ(reinterpret_cast<void*>(1), smap_get(map, ""));
+    ASSERT_FALSE(smap_contains(map, "12345678901234"));
+
+    smap_release(map);
+}
+
+TEST(smap, add_n)
+{
+    struct smap * map = smap_create(0, nullptr);
+    char const request[] = "GET /index.html HTTP/1.1";
+
+    smap_add_n(map, &request[0], 3, reinterpret_cast<void*>(1));
+    smap_add_n(map, &request[4], 11, reinterpret_cast<void*>(2));
+
+    ASSERT_EQ(reinterpret_cast<void const*>(1), smap_get(map, "GET"));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), smap_get(map, "/index.html"));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), smap_get_n(map, "/index.html?", 11));
+    ASSERT_FALSE(smap_contains_n(map, "GE", 2));
+    ASSERT_TRUE(smap_contains_n(map, request, 3));
+
+    smap_remove_n(map, request, 3);
+    ASSERT_FALSE(smap_contains(map, "GET"));
+
+    smap_release(map);
+}
+
+TEST(smap, embedded_zero)
+{
+    struct smap * map = smap_create(0, nullptr);
+
+    smap_add_n(map, "a\0b", 3, reinterpret_cast<void*>(1));
+    smap_add_n(map, "a\0c", 3, reinterpret_cast<void*>(2));
+    smap_add(map, "a", reinterpret_cast<void*>(3));
+
+    ASSERT_EQ(reinterpret_cast<void const*>(1), smap_get_n(map, "a\0b", 3));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), smap_get_n(map, "a\0c", 3));
+    ASSERT_EQ(reinterpret_cast<void const*>(3), smap_get(map, "a"));
+
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+    size_t total_length = 0;
+    while (smap_iter_next(&iter))
+    {
+        size_t length = 0;
+        char const * key = smap_iter_key_n(&iter, &length);
+        ASSERT_EQ('a', key[0]);
+        total_length += length;
+    }
+    ASSERT_EQ(7, total_length);
+
+    smap_release(map);
+}
+
+TEST(smap, hash_functions)
+{
+    enum smap_hash const hashes[] = { SMAP_HASH_WYHASH, SMAP_HASH_SIPHASH, SMAP_HASH_DJB2 };
+    for (auto hash: hashes)
+    {
+        struct smap_options options;
+        smap_options_init(&options);
+        options.hash = hash;
+        options.seed = 42;
+        for (size_t i = 0; i < SMAP_HASH_KEY_SIZE; i++)
+        {
+            options.hash_key[i] = static_cast<unsigned char>(i);
+        }
+
+        struct smap * map = smap_create_ex(&options);
+        for (size_t i = 0; i < 200; i++)
+        {
+            std::string key(i % 70, 'x');
+            key += std::to_string(i);
+            smap_add(map, key.c_str(), reinterpret_cast<void*>(i + 1));
+        }
+
+        for (size_t i = 0; i < 200; i++)
+        {
+            std::string key(i % 70, 'x');
+            key += std::to_string(i);
+            ASSERT_EQ(reinterpret_cast<void const*>(i + 1), smap_get(map, key.c_str()));
+            if (0 == (i % 2))
+            {
+                smap_remove(map, key.c_str());
+            }
+        }
+
+        ASSERT_FALSE(smap_contains(map, "x0"));
+        ASSERT_FALSE(smap_contains(map, "0"));
+        ASSERT_TRUE(smap_contains(map, "x1"));
+
+        smap_release(map);
+    }
+}
+
+TEST(smap, get_or_insert)
+{
+    struct smap * map = smap_create(0, nullptr);
+
+    std::string const text = "the quick fox jumps over the lazy dog and the fox";
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find(' ', start);
+        if (std::string::npos == end) { end = text.size(); }
+
+        void ** slot = smap_get_or_insert_n(map, &text[start], end - start, nullptr);
+        *slot = reinterpret_cast<void*>(reinterpret_cast<size_t>(*slot) + 1);
+        start = end + 1;
+    }
+
+    ASSERT_EQ(reinterpret_cast<void const*>(3), smap_get(map, "the"));
+    ASSERT_EQ(reinterpret_cast<void const*>(2), smap_get(map, "fox"));
+    ASSERT_EQ(reinterpret_cast<void const*>(1), smap_get(map, "dog"));
+
+    bool created = true;
+    void ** slot = smap_emplace(map, "fox", reinterpret_cast<void*>(42), &created);
+    ASSERT_FALSE(created);
+    ASSERT_EQ(reinterpret_cast<void*>(2), *slot);
+
+    slot = smap_emplace(map, "cat", reinterpret_cast<void*>(42), &created);
+    ASSERT_TRUE(created);
+    ASSERT_EQ(reinterpret_cast<void const*>(42), smap_get(map, "cat"));
+
+    smap_release(map);
+}
+
+TEST(smap, get_batch)
+{
+    struct smap * map = smap_create(0, nullptr);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 40; i++)
+    {
+        keys.push_back(std::string(i, 'k') + std::to_string(i));
+        if (0 == (i % 2))
+        {
+            smap_add(map, keys[i].c_str(), reinterpret_cast<void*>(i + 1));
+        }
+    }
+
+    std::vector<char const *> key_ptrs;
+    std::vector<size_t> lengths;
+    for (auto const & key: keys)
+    {
+        key_ptrs.push_back(key.c_str());
+        lengths.push_back(key.size());
+    }
+
+    std::vector<void const *> values(keys.size());
+    smap_get_batch(map, key_ptrs.data(), key_ptrs.size(), values.data());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        ASSERT_EQ((0 == (i % 2)) ? reinterpret_cast<void const*>(i + 1) : nullptr, values[i]);
+    }
+
+    std::vector<void const *> values_n(keys.size());
+    smap_get_batch_n(map, key_ptrs.data(), lengths.data(), key_ptrs.size(), values_n.data());
+    ASSERT_EQ(values, values_n);
+
+    smap_release(map);
+}
+
+TEST(smap, stats)
+{
+    struct smap * map = smap_create(0, nullptr);
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::string key = "a rather long key, which is not stored inline: " + std::to_string(i);
+        smap_add(map, key.c_str(), nullptr);
+    }
+
+    struct smap_stats stats;
+    smap_get_stats(map, &stats);
+    ASSERT_EQ(100, stats.size);
+    ASSERT_LE(stats.size, stats.capacity);
+    ASSERT_LT(0, stats.rehash_count);
+    ASSERT_LE(1, stats.max_probe_length);
+    ASSERT_LE(1.0, stats.mean_probe_length);
+    ASSERT_LT(100 * 50, stats.bytes_allocated);
+
+    size_t histogram_total = 0;
+    for (size_t i = 0; i < SMAP_STATS_HISTOGRAM_SIZE; i++)
+    {
+        histogram_total += stats.probe_histogram[i];
+    }
+    ASSERT_EQ(100, histogram_total);
+
+    smap_release(map);
+}
+
+TEST(smap, inline_values)
+{
+    struct smap_options options;
+    smap_options_init(&options);
+    options.value_size = sizeof(uint64_t);
+    struct smap * map = smap_create_ex(&options);
+
+    std::string const text = "a b a c a b a rather long word a rather long word";
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find(' ', start);
+        if (std::string::npos == end) { end = text.size(); }
+
+        uint64_t * counter = reinterpret_cast<uint64_t *>(smap_get_or_insert_n(map, &text[start], end - start, nullptr));
+        (*counter)++;
+        start = end + 1;
+    }
+
+    ASSERT_EQ(5, *reinterpret_cast<uint64_t const *>(smap_get(map, "a")));
+    ASSERT_EQ(2, *reinterpret_cast<uint64_t const *>(smap_get(map, "b")));
+    ASSERT_EQ(1, *reinterpret_cast<uint64_t const *>(smap_get(map, "c")));
+    ASSERT_EQ(2, *reinterpret_cast<uint64_t const *>(smap_get(map, "rather")));
+
+    uint64_t value = 42;
+    smap_add(map, "b", &value);
+    ASSERT_EQ(42, *reinterpret_cast<uint64_t const *>(smap_get(map, "b")));
+
+    smap_release(map);
+}
+
+TEST(smap, freeze)
+{
+    struct smap_options options;
+    smap_options_init(&options);
+    options.engine = SMAP_ENGINE_OPEN;
+    options.release_value = &free;
+    struct smap * map = smap_create_ex(&options);
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = ((0 == (i % 2)) ? "a rather long key number " : "key ") + std::to_string(i);
+        smap_add(map, key.c_str(), strdup(std::to_string(i).c_str()));
+    }
+    for (size_t i = 0; i < 1000; i += 4)
+    {
+        smap_remove(map, ("a rather long key number " + std::to_string(i)).c_str());
+    }
+
+    struct smap_frozen * frozen = smap_freeze(map);
+    ASSERT_NE(nullptr, frozen);
+    ASSERT_EQ(750, smap_frozen_size(frozen));
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = ((0 == (i % 2)) ? "a rather long key number " : "key ") + std::to_string(i);
+        char const * value = reinterpret_cast<char const *>(smap_frozen_get_n(frozen, key.c_str(), key.size()));
+        if (0 == (i % 4))
+        {
+            ASSERT_EQ(nullptr, value);
+        }
+        else
+        {
+            ASSERT_NE(nullptr, value);
+            ASSERT_EQ(std::to_string(i), value);
+        }
+    }
+
+    ASSERT_TRUE(smap_frozen_contains(frozen, "key 1"));
+    ASSERT_FALSE(smap_frozen_contains(frozen, "key 2"));
+
+    smap_frozen_release(frozen);
+}
+
+namespace
+{
+
+size_t serialize_string(void const * value, void * buffer, void * context)
+{
+    (void) context;
+    char const * text = reinterpret_cast<char const *>(value);
+    size_t size = strlen(text) + 1;
+    if (nullptr != buffer)
+    {
+        memcpy(buffer, text, size);
+    }
+
+    return size;
+}
+
+}
+
+TEST(smap, save_and_load)
+{
+    std::string const path = ::testing::TempDir() + "test_smap_save_and_load.bin";
+
+    struct smap_options options;
+    smap_options_init(&options);
+    options.hash = SMAP_HASH_SIPHASH;
+    options.hash_key[0] = 42;
+    options.release_value = &free;
+    struct smap * map = smap_create_ex(&options);
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = ((0 == (i % 2)) ? "a rather long key number " : "key ") + std::to_string(i);
+        smap_add(map, key.c_str(), strdup(std::to_string(i).c_str()));
+    }
+    smap_add(map, "null", nullptr);
+
+    ASSERT_TRUE(smap_save(map, path.c_str(), &serialize_string, nullptr));
+    ASSERT_STREQ("7", reinterpret_cast<char const *>(smap_get(map, "key 7")));
+    smap_release(map);
+
+    struct smap_frozen * loaded = smap_load(path.c_str());
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(1001, smap_frozen_size(loaded));
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string const key = ((0 == (i % 2)) ? "a rather long key number " : "key ") + std::to_string(i);
+        char const * value = reinterpret_cast<char const *>(smap_frozen_get(loaded, key.c_str()));
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(std::to_string(i), value);
+    }
+    ASSERT_EQ(nullptr, smap_frozen_get(loaded, "null"));
+    ASSERT_FALSE(smap_frozen_contains(loaded, "key 1000"));
+
+    smap_frozen_release(loaded);
+    remove(path.c_str());
+}
+
+TEST(smap, save_leaves_map_unchanged)
+{
+    std::string const path = ::testing::TempDir() + "test_smap_save_leaves_map_unchanged.bin";
+    std::string const prefix = "a rather long key number ";
+
+    struct smap * map = smap_create(0, &free);
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::string const key = prefix + std::to_string(i);
+        smap_add(map, key.c_str(), strdup(std::to_string(i).c_str()));
+    }
+
+    // removed keys remain in the key storage as garbage
+    for (size_t i = 0; i < 100; i += 4)
+    {
+        smap_remove(map, (prefix + std::to_string(i)).c_str());
+    }
+
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+    ASSERT_TRUE(smap_iter_next(&iter));
+    char const * key = smap_iter_key(&iter);
+    std::string const expected = key;
+
+    ASSERT_TRUE(smap_save(map, path.c_str(), &serialize_string, nullptr));
+
+    // keys are not moved by saving
+    ASSERT_EQ(expected, key);
+    smap_release(map);
+
+    struct smap_frozen * loaded = smap_load(path.c_str());
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(75, smap_frozen_size(loaded));
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::string const loaded_key = prefix + std::to_string(i);
+        char const * value = reinterpret_cast<char const *>(smap_frozen_get(loaded, loaded_key.c_str()));
+        if (0 == (i % 4))
+        {
+            ASSERT_EQ(nullptr, value);
+        }
+        else
+        {
+            ASSERT_NE(nullptr, value);
+            ASSERT_EQ(std::to_string(i), value);
+        }
+    }
+
+    smap_frozen_release(loaded);
+    remove(path.c_str());
+}
+
+TEST(smap, save_and_load_inline_values)
+{
+    std::string const path = ::testing::TempDir() + "test_smap_save_and_load_inline_values.bin";
+
+    struct smap_options options;
+    smap_options_init(&options);
+    options.value_size = sizeof(uint64_t);
+    struct smap * map = smap_create_ex(&options);
+
+    uint64_t value = 23;
+    smap_add(map, "answer", &value);
+    ASSERT_TRUE(smap_save(map, path.c_str(), nullptr, nullptr));
+    smap_release(map);
+
+    struct smap_frozen * loaded = smap_load(path.c_str());
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(23, *reinterpret_cast<uint64_t const *>(smap_frozen_get(loaded, "answer")));
+    smap_frozen_release(loaded);
+
+    // damaged files are rejected
+    FILE * file = fopen(path.c_str(), "r+b");
+    fputs("garbage", file);
+    fclose(file);
+    ASSERT_EQ(nullptr, smap_load(path.c_str()));
+    ASSERT_EQ(nullptr, smap_load("non-existing.bin"));
+
+    remove(path.c_str());
+}
+
+namespace
+{
+
+// field offsets of the file header written by smap_save
+size_t const file_hash_offset = 20;
+size_t const file_entry_size_offset = 56;
+size_t const file_entry_count_offset = 64;
+size_t const file_entries_offset_offset = 104;
+
+std::vector<unsigned char> read_file(std::string const & path)
+{
+    std::vector<unsigned char> contents;
+    FILE * file = fopen(path.c_str(), "rb");
+    int c = fgetc(file);
+    while (EOF != c)
+    {
+        contents.push_back(static_cast<unsigned char>(c));
+        c = fgetc(file);
+    }
+    fclose(file);
+
+    return contents;
+}
+
+void write_file(std::string const & path, std::vector<unsigned char> const & contents)
+{
+    FILE * file = fopen(path.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+}
+
+uint64_t read_u64(std::vector<unsigned char> const & contents, size_t offset)
+{
+    uint64_t value = 0;
+    memcpy(&value, &(contents[offset]), sizeof(value));
+    return value;
+}
+
+}
+
+TEST(smap, load_rejects_corrupted_files)
+{
+    std::string const path = ::testing::TempDir() + "test_smap_load_rejects_corrupted_files.bin";
+
+    struct smap_options options;
+    smap_options_init(&options);
+    options.release_value = &free;
+    struct smap * map = smap_create_ex(&options);
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::string const key = "a rather long key number " + std::to_string(i);
+        smap_add(map, key.c_str(), strdup(std::to_string(i).c_str()));
+    }
+    ASSERT_TRUE(smap_save(map, path.c_str(), &serialize_string, nullptr));
+    smap_release(map);
+
+    std::vector<unsigned char> const original = read_file(path);
+    struct smap_frozen * loaded = smap_load(path.c_str());
+    ASSERT_NE(nullptr, loaded);
+    smap_frozen_release(loaded);
+
+    // unknown hash function
+    std::vector<unsigned char> contents = original;
+    contents[file_hash_offset] = 0x7f;
+    write_file(path, contents);
+    ASSERT_EQ(nullptr, smap_load(path.c_str()));
+
+    // key offsets, key lengths and value offsets behind their sections
+    size_t const entry_size = static_cast<size_t>(read_u64(original, file_entry_size_offset));
+    size_t const entries_offset = static_cast<size_t>(read_u64(original, file_entries_offset_offset));
+    ASSERT_EQ(100u, read_u64(original, file_entry_count_offset));
+    // entries start with the key length and the key offset and end with the value offset
+    size_t const fields[] = { 0, sizeof(size_t), entry_size - sizeof(size_t) };
+    for (size_t field: fields)
+    {
+        contents = original;
+        memset(&(contents[entries_offset + (42 * entry_size) + field]), 0x7f, sizeof(size_t));
+        write_file(path, contents);
+        ASSERT_EQ(nullptr, smap_load(path.c_str())) << "field " << field;
+    }
+
+    remove(path.c_str());
+}
+
+TEST(smap, dense_insertion_order)
+{
+    struct smap_options options;
+    smap_options_init(&options);
+    options.engine = SMAP_ENGINE_DENSE;
+    struct smap * map = smap_create_ex(&options);
+
+    char const * keys[] = { "zeta", "alpha", "a rather long key", "mu", "beta" };
+    for (auto key: keys)
+    {
+        smap_add(map, key, nullptr);
+    }
+    smap_remove(map, "alpha");
+    smap_add(map, "alpha", nullptr);
+    smap_add(map, "mu", nullptr);
+
+    std::vector<std::string> expected = { "zeta", "a rather long key", "mu", "beta", "alpha" };
+    std::vector<std::string> actual;
+    struct smap_iter iter;
+    smap_iter_init(&iter, map);
+    while (smap_iter_next(&iter))
+    {
+        actual.push_back(smap_iter_key(&iter));
+    }
+    ASSERT_EQ(expected, actual);
+
+    smap_release(map);
+}
+
+TEST(smap, iter_remove)
+{
+    enum smap_engine const engines[] = { SMAP_ENGINE_CHAINED, SMAP_ENGINE_OPEN, SMAP_ENGINE_DENSE };
+
+    for (auto engine: engines)
+    {
+        struct smap_options options;
+        smap_options_init(&options);
+        options.engine = engine;
+        struct smap * map = smap_create_ex(&options);
+
+        size_t const count = 1000;
+        for (size_t i = 0; i < count; i++)
+        {
+            smap_add(map, ("a rather long key " + std::to_string(i)).c_str(), reinterpret_cast<void *>(i + 1));
+        }
+
+        // keys fetched before stay valid while items are removed
+        std::vector<std::pair<char const *, size_t>> fetched;
+        struct smap_iter iter;
+        smap_iter_init(&iter, map);
+        while (smap_iter_next(&iter))
+        {
+            size_t value = reinterpret_cast<size_t>(smap_iter_value(&iter)) - 1;
+            fetched.push_back({smap_iter_key(&iter), value});
+            if (0 != (value % 10))
+            {
+                smap_iter_remove(&iter);
+                ASSERT_EQ(nullptr, smap_iter_key(&iter));
+            }
+        }
+        ASSERT_EQ(count, fetched.size());
+        for (auto const & item: fetched)
+        {
+            ASSERT_EQ("a rather long key " + std::to_string(item.second), item.first);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            bool const present = (0 == (i % 10));
+            ASSERT_EQ(present, smap_contains(map, ("a rather long key " + std::to_string(i)).c_str()));
+        }
+
+        smap_release(map);
+    }
+}
+
+namespace
+{
+
+bool keep_short(char const * key, size_t length, void const * value, void * context)
+{
+    (void) value;
+    (void) context;
+    return (strlen(key) == length) && (length < 4);
+}
+
+}
+
+TEST(smap, retain)
+{
+    enum smap_engine const engines[] = { SMAP_ENGINE_CHAINED, SMAP_ENGINE_OPEN, SMAP_ENGINE_DENSE };
+
+    for (auto engine: engines)
+    {
+        struct smap_options options;
+        smap_options_init(&options);
+        options.engine = engine;
+        struct smap * map = smap_create_ex(&options);
+
+        // removed long keys exceed the garbage threshold of the arena
+        size_t const count = 1000;
+        for (size_t i = 0; i < count; i++)
+        {
+            std::string const key = std::to_string(i);
+            smap_add(map, key.c_str(), reinterpret_cast<void *>(i));
+            smap_add(map, (key + " is a key stored in the arena").c_str(), reinterpret_cast<void *>(i));
+        }
+
+        smap_retain(map, &keep_short, nullptr);
+
+        struct smap_stats stats;
+        smap_get_stats(map, &stats);
+        ASSERT_EQ(count, stats.size);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::string const key = std::to_string(i);
+            ASSERT_EQ(reinterpret_cast<void const *>(i), smap_get(map, key.c_str()));
+            ASSERT_FALSE(smap_contains(map, (key + " is a key stored in the arena").c_str()));
+        }
+
+        smap_release(map);
+    }
+}
+
+TEST(smap, build_bulk)
+{
+    enum smap_engine const engines[] = { SMAP_ENGINE_CHAINED, SMAP_ENGINE_OPEN, SMAP_ENGINE_DENSE };
+
+    for (auto engine: engines)
+    {
+        struct smap_options options;
+        smap_options_init(&options);
+        options.engine = engine;
+
+        // short and long keys; each key is contained twice
+        size_t const count = 50000;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < (2 * count); i++)
+        {
+            size_t id = i % count;
+            names.push_back(((id % 2) ? "a rather long key " : "") + std::to_string(id));
+        }
+        std::vector<char const *> keys;
+        std::vector<void *> values;
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            keys.push_back(names[i].c_str());
+            values.push_back(reinterpret_cast<void *>(i + 1));
+        }
+
+        struct smap * map = smap_build_bulk(&options, keys.data(), values.data(), keys.size(), 4);
+
+        struct smap_stats stats;
+        smap_get_stats(map, &stats);
+        ASSERT_EQ(count, stats.size);
+        for (size_t i = 0; i < count; i++)
+        {
+            ASSERT_EQ(reinterpret_cast<void const *>(count + i + 1), smap_get(map, names[i].c_str()));
+        }
+
+        smap_remove(map, names[1].c_str());
+        ASSERT_FALSE(smap_contains(map, names[1].c_str()));
+        ASSERT_TRUE(smap_contains(map, names[3].c_str()));
+
+        smap_release(map);
+    }
+}